@@ -0,0 +1,90 @@
+#ifndef AI_PEER_H
+#define AI_PEER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "ai_player.h"
+#include "dispatcher.h"
+#include "profile.h"
+#include "udp_communication.h"
+
+// Single-board mode: the built-in AI takes the place of the remote board.
+// Everything the game sends goes to the AI instead of the network, and the
+// AI's READY/RESULT/SHOT messages come back through the registered
+// handlers like datagrams from a real peer, so the game runs unchanged.
+
+// Pauses that keep the turn flow readable on the matrix: the shooter sees
+// its result, then the AI's shot lands a little after the turn passes.
+static const unsigned long AI_REPLY_DELAY_MS = 100;
+static const unsigned long AI_SHOT_DELAY_MS = 2500;
+
+static AiPlayer aiPeer;
+
+// Messages from the AI, delivered once due. MSG_SHOT is only chosen when it
+// is delivered, so its search runs in that tick.
+struct AiOutgoing {
+  bool pending;
+  unsigned long dueAt;
+  Message msg;
+};
+
+static const uint8_t AI_OUTBOX_SLOTS = 2;
+static AiOutgoing aiOutbox[AI_OUTBOX_SLOTS];
+
+inline void aiPeerQueue(const Message &msg, unsigned long delayMs) {
+  for (uint8_t i = 0; i < AI_OUTBOX_SLOTS; i++) {
+    if (aiOutbox[i].pending) continue;
+    aiOutbox[i].pending = true;
+    aiOutbox[i].dueAt = millis() + delayMs;
+    aiOutbox[i].msg = msg;
+    return;
+  }
+}
+
+// The game's side of the conversation (installed as the local peer).
+inline void aiPeerReceive(const Message &msg) {
+  if (msg.type == MSG_READY) {
+    // The player has placed their fleet; place ours. Their timing seeds
+    // the AI unless SOLO_AI_SEED fixes it.
+    aiBegin(aiPeer, SOLO_AI_SEED ? SOLO_AI_SEED : micros(), SOLO_AI_DEPTH);
+    // Finishing after them lets the player shoot first
+    Message ready = makeMessage(MSG_READY);
+    ready.value = msg.value + 1;
+    aiPeerQueue(ready, AI_REPLY_DELAY_MS);
+  } else if (msg.type == MSG_SHOT) {
+    Message reply = makeMessage(MSG_RESULT);
+    reply.result = aiAnswerShot(aiPeer, msg.x, msg.y);
+    aiPeerQueue(reply, AI_REPLY_DELAY_MS);
+    if (!aiFleetSunk(aiPeer)) aiPeerQueue(makeMessage(MSG_SHOT), AI_SHOT_DELAY_MS);
+  } else if (msg.type == MSG_RESULT) {
+    PROFILE_SCOPE(AI);
+    aiOnResult(aiPeer, msg.result);
+  }
+}
+
+inline void aiPeerBegin() {
+  memset(aiOutbox, 0, sizeof(aiOutbox));
+  setLocalPeer(aiPeerReceive);
+}
+
+// Deliver the AI's due messages; call from the network task.
+inline void aiPeerPoll() {
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < AI_OUTBOX_SLOTS; i++) {
+    AiOutgoing &out = aiOutbox[i];
+    if (!out.pending || (long)(now - out.dueAt) < 0) continue;
+    // Free the slot first: handlers reply through sendMessage
+    out.pending = false;
+    Message msg = out.msg;
+    if (msg.type == MSG_SHOT) {
+      PROFILE_SCOPE(AI);
+      int x, y;
+      if (!aiChooseShot(aiPeer, x, y)) continue;
+      msg.x = (uint8_t)x;
+      msg.y = (uint8_t)y;
+    }
+    deliverMessage(msg);
+  }
+}
+
+#endif
@@ -0,0 +1,340 @@
+#ifndef AI_PLAYER_H
+#define AI_PLAYER_H
+
+#include <stdint.h>
+#include <string.h>
+#include "bitboard.h"
+#include "placement.h"
+#include "protocol.h"
+
+// Probability-density opponent. For every boat still afloat the AI counts
+// the placements that fit the cells it has not ruled out, and fires at the
+// unknown cell most placements cover. While it has hits that are not yet
+// part of a sunk boat it only counts placements through those hits (target
+// mode). Everything is bitboards: per-cell counts are bit-sliced across
+// planes, so adding a row of placements is a few word operations and a miss
+// only subtracts the placements through that cell. Only a sink rebuilds the
+// counts. AI_DEPTH_MAX is set so that moves should fit one frame on the
+// ATmega4809, by an estimate not yet measured on the board (see there).
+//
+// The AI also owns a random fleet and answers shots at it, so it can stand
+// in for the remote board. All state lives in AiPlayer, so several AIs can
+// run side by side.
+
+// Enough bits per cell for the largest possible count: each boat covers a
+// cell from at most size origins per orientation.
+constexpr uint8_t bitsFor(uint16_t n) { return n ? 1 + bitsFor(n >> 1) : 0; }
+static const uint8_t DENSITY_BITS = bitsFor(2 * GameFleet::cells);
+
+// Bit p of cell (x, y)'s count is bit x of planes[p].rows[y].
+struct DensityMap {
+  BitBoard planes[DENSITY_BITS];
+};
+
+inline void dmClear(DensityMap &d) {
+  for (uint8_t p = 0; p < DENSITY_BITS; p++) bbClear(d.planes[p]);
+}
+
+// Add 1 to every cell of row y set in mask.
+inline void dmAddRow(DensityMap &d, int y, RowMask mask) {
+  for (uint8_t p = 0; p < DENSITY_BITS && mask; p++) {
+    RowMask carry = d.planes[p].rows[y] & mask;
+    d.planes[p].rows[y] ^= mask;
+    mask = carry;
+  }
+}
+
+// Subtract 1 from every cell of row y set in mask.
+inline void dmSubRow(DensityMap &d, int y, RowMask mask) {
+  for (uint8_t p = 0; p < DENSITY_BITS && mask; p++) {
+    RowMask borrow = ~d.planes[p].rows[y] & mask;
+    d.planes[p].rows[y] ^= mask;
+    mask = borrow;
+  }
+}
+
+// Add the cells covered by every origin in origins for a boat of length size.
+inline void dmAddPlacements(DensityMap &d, const BitBoard &origins, uint8_t size, bool vertical) {
+  for (int y = 0; y < HEIGHT; y++) {
+    RowMask row = origins.rows[y];
+    if (!row) continue;
+    for (uint8_t k = 0; k < MAX_SPAN && k < size; k++) {
+      if (vertical) dmAddRow(d, y + k, row);
+      else dmAddRow(d, y, (RowMask)(row << k));
+    }
+  }
+}
+
+// Narrow cand to its cells with the largest count. Returns false (and
+// leaves cand alone) if the count is zero on all of them.
+inline bool dmKeepMax(const DensityMap &d, BitBoard &cand) {
+  bool found = false;
+  for (int p = DENSITY_BITS - 1; p >= 0; p--) {
+    BitBoard t;
+    RowMask any = 0;
+    for (int y = 0; y < HEIGHT; y++) {
+      t.rows[y] = cand.rows[y] & d.planes[p].rows[y];
+      any |= t.rows[y];
+    }
+    if (any) {
+      cand = t;
+      found = true;
+    }
+  }
+  return found;
+}
+
+// Difficulty: how many of the largest boats still afloat the AI counts
+// placements for. 0 fires at random; BOAT_COUNT is the full search.
+static const uint8_t AI_DEPTH_RANDOM = 0;
+static const uint8_t AI_DEPTH_FULL = GameFleet::count;
+
+// Deepest search whose moves should fit one 5 ms frame (80000 cycles at
+// 16 MHz). An estimate, not a measurement on the ATmega4809: loop trip
+// counts of 3000 AI-vs-AI games per preset, costed per loop body for
+// avr-gcc (16-bit rows, libgcc popcount and 32-bit modulo); the worst
+// aiChooseShot is when a misread sink forces a full rebuild. By that
+// estimate 16x16 at full depth takes a median 4.6k and at worst 101k
+// cycles, over a frame once in ~4000 moves; at depth 4 the worst is 73k.
+// Classic and quick peak at 63k and 37k. Depth 4 plays as well: over
+// 20000 tournament games the winner needs 103.3 shots on average at
+// depth 4 and at full depth alike. Measure on a board with PROFILE=1 (the
+// "ai" probe) before trusting the cycle counts.
+#if GAME_PRESET == PRESET_16X16
+static const uint8_t AI_DEPTH_MAX = 4;
+#else
+static const uint8_t AI_DEPTH_MAX = AI_DEPTH_FULL;
+#endif
+
+struct AiPlayer {
+  FleetRng rng;
+  uint8_t depth;
+
+  // Own fleet, as the opponent shoots at it
+  BitBoard fleet;
+  BoatPlacement boats[GameFleet::count];
+  uint8_t boatHits[GameFleet::count];
+  BitBoard hitsTaken;
+  uint8_t boatsLeft;
+
+  // What the AI knows about the opponent's board
+  BitBoard shot;      // every cell fired at
+  BitBoard blocked;   // misses and sunk boats: no boat can cover these
+  BitBoard hits;      // every hit
+  BitBoard openHits;  // hits not yet put down to a sunk boat
+  uint8_t afloat[GameFleet::count];  // sizes believed afloat, largest first
+  uint8_t afloatCount;
+  DensityMap hunt;    // placements of the counted boats, per cell
+  int8_t lastX, lastY;
+  uint16_t shots;
+};
+
+inline uint8_t aiCountedBoats(const AiPlayer &ai) {
+  return ai.depth < ai.afloatCount ? ai.depth : ai.afloatCount;
+}
+
+inline void aiRebuildDensity(AiPlayer &ai) {
+  dmClear(ai.hunt);
+  for (uint8_t i = 0; i < aiCountedBoats(ai); i++) {
+    for (uint8_t v = 0; v < 2; v++) {
+      BitBoard origins;
+      if (freeOrigins(ai.blocked, ai.afloat[i], v, origins))
+        dmAddPlacements(ai.hunt, origins, ai.afloat[i], v);
+    }
+  }
+}
+
+// Every boat of the fleet, largest first, so depth keeps the biggest ones.
+inline void aiResetAfloat(AiPlayer &ai) {
+  for (uint8_t i = 0; i < GameFleet::count; i++) {
+    uint8_t size = GameFleet::sizes[i], j = i;
+    for (; j > 0 && ai.afloat[j - 1] < size; j--) ai.afloat[j] = ai.afloat[j - 1];
+    ai.afloat[j] = size;
+  }
+  ai.afloatCount = GameFleet::count;
+}
+
+// Start a game: place a random fleet and forget the previous opponent. The
+// same seed gives the same fleet and the same shots.
+inline void aiBegin(AiPlayer &ai, uint32_t seed, uint8_t depth) {
+  memset(&ai, 0, sizeof(ai));
+  ai.rng.state = seed;
+  ai.depth = depth;
+  while (!randomFleet(ai.rng, ai.fleet, ai.boats)) bbClear(ai.fleet);
+  ai.boatsLeft = GameFleet::count;
+  aiResetAfloat(ai);
+  ai.lastX = ai.lastY = -1;
+  aiRebuildDensity(ai);
+}
+
+// No boat believed afloat fits the board, yet the game goes on, so a sink
+// was put down to the wrong boat. Start over from the misses alone.
+inline void aiForgetSinks(AiPlayer &ai) {
+  for (int y = 0; y < HEIGHT; y++) ai.blocked.rows[y] = ai.shot.rows[y] & ~ai.hits.rows[y];
+  aiResetAfloat(ai);
+  aiRebuildDensity(ai);
+}
+
+// Narrow cand to its cells next to a cell of of. False (cand unchanged) if
+// there are none.
+inline bool aiKeepNextTo(const BitBoard &of, BitBoard &cand) {
+  BitBoard next;
+  RowMask any = 0;
+  for (int y = 0; y < HEIGHT; y++) {
+    RowMask around = (RowMask)(of.rows[y] << 1) | (RowMask)(of.rows[y] >> 1);
+    if (y > 0) around |= of.rows[y - 1];
+    if (y + 1 < HEIGHT) around |= of.rows[y + 1];
+    next.rows[y] = cand.rows[y] & around;
+    any |= next.rows[y];
+  }
+  if (any) cand = next;
+  return any != 0;
+}
+
+// Narrow cand (the cells not shot yet) to the best ones by density. False
+// if the boats believed afloat fit nowhere among them.
+inline bool aiNarrow(const AiPlayer &ai, BitBoard &cand) {
+  bool aimed = false;
+  RowMask openAny = 0;
+  for (int y = 0; y < HEIGHT; y++) openAny |= ai.openHits.rows[y];
+  if (openAny) {
+    // Only placements through an open hit
+    DensityMap target;
+    dmClear(target);
+    for (uint8_t i = 0; i < aiCountedBoats(ai); i++) {
+      uint8_t size = ai.afloat[i];
+      for (uint8_t v = 0; v < 2; v++) {
+        BitBoard origins;
+        if (!freeOrigins(ai.blocked, size, v, origins)) continue;
+        for (int y = 0; y < HEIGHT; y++) {
+          RowMask through = 0;
+          for (uint8_t k = 0; k < MAX_SPAN && k < size; k++) {
+            if (!v) through |= ai.openHits.rows[y] >> k;
+            else if (y + k < HEIGHT) through |= ai.openHits.rows[y + k];
+          }
+          origins.rows[y] &= through;
+        }
+        dmAddPlacements(target, origins, size, v);
+      }
+    }
+    // Depth left out the boat that was hit: fire next to the hits
+    aimed = dmKeepMax(target, cand) || aiKeepNextTo(ai.openHits, cand);
+  }
+  // Hunt density picks the target, or breaks ties among target cells
+  bool hunted = dmKeepMax(ai.hunt, cand);
+  return aimed || hunted;
+}
+
+// Pick the next cell to fire at. False once every cell has been shot.
+inline bool aiChooseShot(AiPlayer &ai, int &x, int &y) {
+  BitBoard cand;
+  RowMask any = 0;
+  for (int row = 0; row < HEIGHT; row++) {
+    cand.rows[row] = ~ai.shot.rows[row] & rowSpan(0, WIDTH);
+    any |= cand.rows[row];
+  }
+  if (!any) return false;
+
+  if (ai.depth != AI_DEPTH_RANDOM) {
+    BitBoard unshot = cand;
+    if (!ai.afloatCount || !aiNarrow(ai, cand)) {
+      aiForgetSinks(ai);
+      cand = unshot;
+      aiNarrow(ai, cand);
+    }
+  }
+
+  uint16_t n = bbCount(cand);
+  bbNth(cand, (uint16_t)(fleetRandom(ai.rng) % n), x, y);
+  ai.lastX = (int8_t)x;
+  ai.lastY = (int8_t)y;
+  return true;
+}
+
+// Open hits in a straight line through (x, y), along the longer direction.
+inline uint8_t aiHitRun(const AiPlayer &ai, int x, int y, bool &vertical, int &start) {
+  int lx = x, rx = x, ty = y, by = y;
+  while (lx > 0 && bbGet(ai.openHits, lx - 1, y)) lx--;
+  while (rx + 1 < WIDTH && bbGet(ai.openHits, rx + 1, y)) rx++;
+  while (ty > 0 && bbGet(ai.openHits, x, ty - 1)) ty--;
+  while (by + 1 < HEIGHT && bbGet(ai.openHits, x, by + 1)) by++;
+  vertical = by - ty > rx - lx;
+  start = vertical ? ty : lx;
+  return (uint8_t)(vertical ? by - ty + 1 : rx - lx + 1);
+}
+
+// A boat went down at (x, y). The result does not say which one, so take
+// the run of hits through the cell as its length: a boat of exactly that
+// size is sunk along the whole run. Otherwise (boats side by side) drop the
+// largest boat shorter than the run and only rule out the sinking cell.
+inline void aiMarkSunk(AiPlayer &ai, int x, int y) {
+  bool vertical;
+  int start;
+  uint8_t run = aiHitRun(ai, x, y, vertical, start);
+  int8_t match = -1;
+  bool exact = false;
+  for (uint8_t i = 0; i < ai.afloatCount && !exact; i++) {
+    if (ai.afloat[i] == run) match = i, exact = true;
+    else if (match < 0 && ai.afloat[i] < run) match = i;
+  }
+  if (match < 0) match = ai.afloatCount - 1;  // the run was misread; drop the smallest
+  if (match >= 0) {
+    for (uint8_t i = match; i + 1 < ai.afloatCount; i++) ai.afloat[i] = ai.afloat[i + 1];
+    ai.afloatCount--;
+  }
+  for (uint8_t k = 0; k < (exact ? run : 1); k++) {
+    int cx = exact ? (vertical ? x : start + k) : x;
+    int cy = exact ? (vertical ? start + k : y) : y;
+    bbSet(ai.blocked, cx, cy);
+    ai.openHits.rows[cy] &= ~((RowMask)1 << cx);
+  }
+  aiRebuildDensity(ai);
+}
+
+// Record the answer to the last shot from aiChooseShot.
+inline void aiOnResult(AiPlayer &ai, uint8_t result) {
+  int x = ai.lastX, y = ai.lastY;
+  if (x < 0 || y < 0 || bbGet(ai.shot, x, y)) return;
+  bbSet(ai.shot, x, y);
+  ai.shots++;
+  if (result == RESULT_MISS) {
+    // Take out the counted placements through this cell
+    for (uint8_t i = 0; i < aiCountedBoats(ai); i++) {
+      uint8_t size = ai.afloat[i];
+      for (int o = x - size + 1; o <= x; o++)
+        if (originLegal(size, false, o, y) && !bbAny(ai.blocked, o, y, size, false))
+          dmSubRow(ai.hunt, y, rowSpan(o, size));
+      for (int o = y - size + 1; o <= y; o++)
+        if (originLegal(size, true, x, o) && !bbAny(ai.blocked, x, o, size, true))
+          for (uint8_t k = 0; k < MAX_SPAN && k < size; k++) dmSubRow(ai.hunt, o + k, (RowMask)1 << x);
+    }
+    bbSet(ai.blocked, x, y);
+    return;
+  }
+  bbSet(ai.hits, x, y);
+  bbSet(ai.openHits, x, y);
+  if (result == RESULT_SINK) aiMarkSunk(ai, x, y);
+}
+
+// The opponent fired at (x, y); answer as the firmware does. A cell only
+// counts towards sinking its boat the first time it is hit.
+inline uint8_t aiAnswerShot(AiPlayer &ai, int x, int y) {
+  if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT || !bbGet(ai.fleet, x, y)) return RESULT_MISS;
+  for (uint8_t i = 0; i < GameFleet::count; i++) {
+    const BoatPlacement &b = ai.boats[i];
+    uint8_t size = GameFleet::sizes[i];
+    bool onBoat = b.vertical ? (x == b.x && y >= b.y && y < b.y + size)
+                             : (y == b.y && x >= b.x && x < b.x + size);
+    if (!onBoat) continue;
+    if (!bbGet(ai.hitsTaken, x, y)) {
+      bbSet(ai.hitsTaken, x, y);
+      if (++ai.boatHits[i] == size) ai.boatsLeft--;
+    }
+    return ai.boatHits[i] >= size ? RESULT_SINK : RESULT_HIT;
+  }
+  return RESULT_MISS;
+}
+
+inline bool aiFleetSunk(const AiPlayer &ai) { return ai.boatsLeft == 0; }
+
+#endif // AI_PLAYER_H
@@ -0,0 +1,155 @@
+#ifndef AIM_STREAM_H
+#define AIM_STREAM_H
+
+#include <Arduino.h>
+#include "clock_sync.h"
+#include "protocol.h"
+#include "udp_communication.h"
+
+// Opponent-aim streaming (SHOW_OPPONENT_AIM). The aiming board takes a
+// cursor sample in every game step in which the cursor moved and sends the
+// pending samples as one AIM batch every clockAimIntervalMs(): the newest
+// sample in full, then one byte per earlier sample holding the step to the
+// sample after it (dx and dy in -4..3) and how many game steps apart they
+// were (1..4, longer pauses count as 4). A sample that would overflow the
+// batch or whose step does not fit a byte sends what is pending first.
+//
+// The waiting board dates each sample from the batch's arrival and plays
+// them back clockAimDelayMs() later, moving the marker through the cells
+// between samples at the pace they were taken, so it walks smoothly
+// instead of jumping at every packet.
+
+static const unsigned long AIM_STEP_MS = 75;  // game step (GAME_PERIOD_US)
+static const uint8_t AIM_PLAYBACK_SIZE = 16;
+static const uint8_t AIM_AGE_MAX = 15;
+
+static_assert((AIM_TRAIL_MAX + 1) * AIM_STEP_MS >= AIM_SEND_MAX_MS, "a batch period must fit in one batch");
+
+// Samples waiting to be sent
+struct AimBatch {
+  uint8_t samples;        // 0 = nothing pending
+  uint8_t x, y;           // newest sample
+  uint8_t age;            // game steps since the newest sample
+  uint8_t trail[AIM_TRAIL_MAX];
+  unsigned long firstAt;  // when the oldest pending sample was taken
+};
+
+// A received sample and when to show it
+struct AimPoint {
+  int8_t x, y;
+  unsigned long at;
+};
+
+static AimBatch aimOut;
+static AimPoint aimPlayback[AIM_PLAYBACK_SIZE];
+static uint8_t aimPlayFirst = 0, aimPlayCount = 0;
+
+inline uint8_t aimPackStep(int dx, int dy, uint8_t steps) {
+  if (steps > 4) steps = 4;
+  return (uint8_t)((dx + 4) | (dy + 4) << 3 | (steps - 1) << 6);
+}
+
+inline int aimStepDx(uint8_t b) { return (b & 7) - 4; }
+inline int aimStepDy(uint8_t b) { return ((b >> 3) & 7) - 4; }
+inline uint8_t aimStepSteps(uint8_t b) { return (b >> 6) + 1; }
+
+// Forget pending samples and anything still to be played back.
+inline void aimStreamReset() {
+  aimOut.samples = 0;
+  aimPlayCount = 0;
+}
+
+inline void aimStreamSend() {
+  Message m = makeMessage(MSG_AIM);
+  m.x = aimOut.x;
+  m.y = aimOut.y;
+  m.aimAge = aimOut.age;
+  m.aimCount = aimOut.samples - 1;
+  m.aimTrail = aimOut.trail;
+  sendMessage(m);
+  aimOut.samples = 0;
+}
+
+// Call once per game step while aiming.
+inline void aimStreamStep(bool moved, int x, int y, unsigned long now) {
+  if (moved) {
+    if (aimOut.samples) {
+      int dx = x - aimOut.x, dy = y - aimOut.y;
+      if (aimOut.samples > AIM_TRAIL_MAX || dx < -4 || dx > 3 || dy < -4 || dy > 3) {
+        aimStreamSend();
+      } else {
+        aimOut.trail[aimOut.samples - 1] = aimPackStep(dx, dy, aimOut.age + 1);
+        aimOut.samples++;
+      }
+    }
+    if (!aimOut.samples) {
+      aimOut.samples = 1;
+      aimOut.firstAt = now;
+    }
+    aimOut.x = (uint8_t)x;
+    aimOut.y = (uint8_t)y;
+    aimOut.age = 0;
+  } else if (aimOut.samples && aimOut.age < AIM_AGE_MAX) {
+    aimOut.age++;
+  }
+  if (aimOut.samples && now - aimOut.firstAt >= clockAimIntervalMs()) aimStreamSend();
+}
+
+inline AimPoint &aimPlayPoint(uint8_t i) {
+  return aimPlayback[(aimPlayFirst + i) % AIM_PLAYBACK_SIZE];
+}
+
+// Queue a received batch for playback. Times never run backwards: a
+// sample dated before the last queued one is shown right after it.
+inline void aimStreamReceive(const Message &msg, unsigned long now) {
+  uint8_t n = msg.aimCount < AIM_TRAIL_MAX ? msg.aimCount : AIM_TRAIL_MAX;
+  AimPoint points[AIM_TRAIL_MAX + 1];
+  int x = msg.x, y = msg.y;
+  unsigned long at = now + clockAimDelayMs() - msg.aimAge * AIM_STEP_MS;
+  for (int i = n; i >= 0; i--) {
+    points[i].x = (int8_t)x;
+    points[i].y = (int8_t)y;
+    points[i].at = at;
+    if (i == 0) break;
+    uint8_t b = msg.aimTrail[i - 1];
+    x -= aimStepDx(b);
+    y -= aimStepDy(b);
+    at -= aimStepSteps(b) * AIM_STEP_MS;
+  }
+  for (uint8_t i = 0; i <= n; i++) {
+    if (aimPlayCount) {
+      unsigned long last = aimPlayPoint(aimPlayCount - 1).at;
+      if ((long)(points[i].at - last) < 0) points[i].at = last;
+    }
+    if (aimPlayCount == AIM_PLAYBACK_SIZE) {
+      aimPlayFirst = (aimPlayFirst + 1) % AIM_PLAYBACK_SIZE;
+      aimPlayCount--;
+    }
+    aimPlayPoint(aimPlayCount++) = points[i];
+  }
+}
+
+// Where the opponent's marker is now: between the due sample and the next
+// one, rounded to a cell. False before the first sample is due and once
+// the last one is timeoutMs old.
+inline bool aimStreamPosition(unsigned long now, unsigned long timeoutMs, int &x, int &y) {
+  while (aimPlayCount >= 2 && (long)(now - aimPlayPoint(1).at) >= 0) {
+    aimPlayFirst = (aimPlayFirst + 1) % AIM_PLAYBACK_SIZE;
+    aimPlayCount--;
+  }
+  if (!aimPlayCount) return false;
+  const AimPoint &p = aimPlayPoint(0);
+  long since = (long)(now - p.at);
+  if (since < 0) return false;
+  x = p.x;
+  y = p.y;
+  if (aimPlayCount == 1) return (unsigned long)since < timeoutMs;
+  const AimPoint &q = aimPlayPoint(1);
+  long span = (long)(q.at - p.at);
+  long nx = (long)(q.x - p.x) * since, ny = (long)(q.y - p.y) * since;
+  x += (int)((nx + (nx < 0 ? -span : span) / 2) / span);
+  y += (int)((ny + (ny < 0 ? -span : span) / 2) / span);
+  return true;
+}
+
+#endif // AIM_STREAM_H
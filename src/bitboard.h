@@ -0,0 +1,96 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+#include "board_config.h"
+
+// One 16-bit word per row: bit x of rows[y] is cell (x, y).
+typedef uint16_t RowMask;
+
+static_assert(WIDTH <= 16, "BitBoard rows are 16-bit words");
+
+struct BitBoard {
+  RowMask rows[HEIGHT];
+};
+
+// Mask of len consecutive bits starting at column x.
+inline RowMask rowSpan(int x, uint8_t len) {
+  return (RowMask)(((1UL << len) - 1) << x);
+}
+
+inline void bbClear(BitBoard &b) {
+  for (int y = 0; y < HEIGHT; y++) b.rows[y] = 0;
+}
+
+inline bool bbGet(const BitBoard &b, int x, int y) {
+  return (b.rows[y] >> x) & 1;
+}
+
+inline void bbSet(BitBoard &b, int x, int y) {
+  b.rows[y] |= (RowMask)1 << x;
+}
+
+// Spans are boat-sized. Vertical loops run to this constant bound and stop
+// at len, so the compiler can unroll them fully.
+static const uint8_t MAX_SPAN = GameFleet::maxSize;
+
+// True if any cell of the horizontal/vertical span is set.
+inline bool bbAny(const BitBoard &b, int x, int y, uint8_t len, bool vertical) {
+  if (!vertical) return (b.rows[y] & rowSpan(x, len)) != 0;
+  RowMask bit = (RowMask)1 << x;
+  for (uint8_t i = 0; i < MAX_SPAN && i < len; i++)
+    if (b.rows[y + i] & bit) return true;
+  return false;
+}
+
+// True if every cell of the span is set.
+inline bool bbAll(const BitBoard &b, int x, int y, uint8_t len, bool vertical) {
+  if (!vertical) {
+    RowMask m = rowSpan(x, len);
+    return (b.rows[y] & m) == m;
+  }
+  RowMask bit = (RowMask)1 << x;
+  for (uint8_t i = 0; i < MAX_SPAN && i < len; i++)
+    if (!(b.rows[y + i] & bit)) return false;
+  return true;
+}
+
+inline void bbFill(BitBoard &b, int x, int y, uint8_t len, bool vertical) {
+  if (!vertical) {
+    b.rows[y] |= rowSpan(x, len);
+    return;
+  }
+  RowMask bit = (RowMask)1 << x;
+  for (uint8_t i = 0; i < MAX_SPAN && i < len; i++) b.rows[y + i] |= bit;
+}
+
+// Opponent cell states, stored as two bit planes (lo = bit 0, hi = bit 1).
+enum CellState : uint8_t { CELL_UNKNOWN = 0, CELL_MISS = 1, CELL_HIT = 2, CELL_SUNK = 3 };
+
+struct CellPlanes {
+  BitBoard lo, hi;
+};
+
+inline void cpClear(CellPlanes &p) {
+  bbClear(p.lo);
+  bbClear(p.hi);
+}
+
+inline uint8_t cpGet(const CellPlanes &p, int x, int y) {
+  return (uint8_t)(bbGet(p.lo, x, y) | (bbGet(p.hi, x, y) << 1));
+}
+
+inline void cpSet(CellPlanes &p, int x, int y, uint8_t state) {
+  RowMask bit = (RowMask)1 << x;
+  if (state & 1) p.lo.rows[y] |= bit; else p.lo.rows[y] &= ~bit;
+  if (state & 2) p.hi.rows[y] |= bit; else p.hi.rows[y] &= ~bit;
+}
+
+// Row of cells that are exactly in the given state.
+inline RowMask cpRow(const CellPlanes &p, int y, uint8_t state) {
+  RowMask lo = (state & 1) ? p.lo.rows[y] : (RowMask)~p.lo.rows[y];
+  RowMask hi = (state & 2) ? p.hi.rows[y] : (RowMask)~p.hi.rows[y];
+  return lo & hi & rowSpan(0, WIDTH);
+}
+
+#endif // BITBOARD_H
@@ -0,0 +1,74 @@
+#ifndef BOARD_CONFIG_H
+#define BOARD_CONFIG_H
+
+#include <stdint.h>
+
+// Board size and fleet are fixed at compile time so every table is sized
+// exactly for them and a fleet that cannot work fails the build.
+
+template <uint8_t W, uint8_t H>
+struct BoardConfig {
+  static const uint8_t width = W;
+  static const uint8_t height = H;
+  static const uint16_t cells = (uint16_t)W * H;
+};
+
+constexpr uint16_t fleetCells() { return 0; }
+template <class... Rest>
+constexpr uint16_t fleetCells(uint8_t first, Rest... rest) { return first + fleetCells(rest...); }
+
+constexpr uint8_t fleetMaxSize() { return 0; }
+template <class... Rest>
+constexpr uint8_t fleetMaxSize(uint8_t first, Rest... rest) {
+  return first > fleetMaxSize(rest...) ? first : fleetMaxSize(rest...);
+}
+
+// One template argument per boat, in placement order.
+template <uint8_t... Sizes>
+struct FleetConfig {
+  static const uint8_t count = sizeof...(Sizes);
+  static const uint16_t cells = fleetCells(Sizes...);
+  static const uint8_t maxSize = fleetMaxSize(Sizes...);
+  static const uint8_t sizes[count];
+};
+
+template <uint8_t... Sizes>
+const uint8_t FleetConfig<Sizes...>::sizes[FleetConfig<Sizes...>::count] = {Sizes...};
+
+// 0, 1, ..., N-1 as a template pack, for tables generated at compile time
+// (C++11 has no std::index_sequence).
+template <uint16_t... I> struct IndexSeq {};
+template <uint16_t N, uint16_t... I> struct MakeIndexSeq : MakeIndexSeq<N - 1, N - 1, I...> {};
+template <uint16_t... I> struct MakeIndexSeq<0, I...> { typedef IndexSeq<I...> type; };
+
+// Presets, selected per build env with -D GAME_PRESET=...
+#define PRESET_16X16 0    // whole matrix, 4+3+3+2+2+2
+#define PRESET_CLASSIC 1  // 10x10, 5+4+3+3+2
+#define PRESET_QUICK 2    // 8x8, 4+3+2+2
+
+#ifndef GAME_PRESET
+#define GAME_PRESET PRESET_16X16
+#endif
+
+#if GAME_PRESET == PRESET_16X16
+typedef BoardConfig<16, 16> GameBoard;
+typedef FleetConfig<4, 3, 3, 2, 2, 2> GameFleet;
+#elif GAME_PRESET == PRESET_CLASSIC
+typedef BoardConfig<10, 10> GameBoard;
+typedef FleetConfig<5, 4, 3, 3, 2> GameFleet;
+#elif GAME_PRESET == PRESET_QUICK
+typedef BoardConfig<8, 8> GameBoard;
+typedef FleetConfig<4, 3, 2, 2> GameFleet;
+#else
+#error "unknown GAME_PRESET"
+#endif
+
+static const int WIDTH = GameBoard::width;
+static const int HEIGHT = GameBoard::height;
+
+static_assert(GameFleet::count > 0, "the fleet needs at least one boat");
+static_assert(GameFleet::count < 15, "boat ids must fit in a nibble");
+static_assert(GameFleet::maxSize <= WIDTH && GameFleet::maxSize <= HEIGHT, "a boat is longer than the board");
+static_assert(GameFleet::cells <= GameBoard::cells / 2, "fleet covers more than half the board");
+
+#endif // BOARD_CONFIG_H
@@ -0,0 +1,74 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "protocol.h"
+
+// Packet capture format: every datagram a board sent or received, with its
+// time, so a game can be replayed (src/host/standin --replay) or examined
+// later. A capture file is CAPTURE_MAGIC followed by records:
+//   u8     flags | (len - 1)   flags: CAPTURE_RX, CAPTURE_BOARD_B, CAPTURE_GAP
+//   varint ms since the previous record (the first: since boot)
+//   u8     data[len]           the datagram as on the wire, 1..WIRE_MAX_LEN
+// CAPTURE_GAP marks records written after some were lost (serial log
+// full), so times across it are still right but packets are missing.
+//
+// Written by the simulator (sim --capture, both boards in one file) and by
+// CAPTURE=1 firmware into its serial log (log.h), from which
+// tools/logdecode.py --capture extracts it. Kept free of Arduino types like
+// protocol.h.
+
+static const char CAPTURE_MAGIC[8] = "BSCAP1\n";
+static const uint8_t CAPTURE_SYNC = 0xF6;  // starts a record in a binary serial log
+static const uint8_t CAPTURE_RX = 0x80;
+static const uint8_t CAPTURE_BOARD_B = 0x40;
+static const uint8_t CAPTURE_GAP = 0x20;
+static const uint8_t CAPTURE_LEN_MASK = 0x1F;
+static const uint8_t CAPTURE_MAX_RECORD = 1 + 5 + WIRE_MAX_LEN;
+
+static_assert(WIRE_MAX_LEN - 1 <= CAPTURE_LEN_MASK, "datagram length must fit the flags byte");
+
+struct CaptureRecord {
+  uint8_t flags;  // CAPTURE_RX | CAPTURE_BOARD_B | CAPTURE_GAP
+  uint32_t dtMs;
+  uint8_t len;
+  uint8_t data[WIRE_MAX_LEN];
+};
+
+// Encode one record into out (CAPTURE_MAX_RECORD bytes). Returns its
+// length, 0 for a datagram that cannot be captured (empty or too long).
+inline uint8_t captureEncode(uint8_t flags, uint32_t dtMs, const uint8_t *data, uint8_t len, uint8_t *out) {
+  if (len == 0 || len > WIRE_MAX_LEN) return 0;
+  uint8_t n = 0;
+  out[n++] = (uint8_t)((flags & ~CAPTURE_LEN_MASK) | (len - 1));
+  while (dtMs >= 0x80) {
+    out[n++] = (uint8_t)(dtMs | 0x80);
+    dtMs >>= 7;
+  }
+  out[n++] = (uint8_t)dtMs;
+  memcpy(out + n, data, len);
+  return n + len;
+}
+
+// Decode the record at buf. Returns the bytes it took, 0 if buf ends
+// before it does, -1 if it is malformed.
+inline int captureDecode(const uint8_t *buf, int avail, CaptureRecord &r) {
+  if (avail < 1) return 0;
+  r.flags = buf[0] & ~CAPTURE_LEN_MASK;
+  r.len = (buf[0] & CAPTURE_LEN_MASK) + 1;
+  r.dtMs = 0;
+  int n = 1;
+  for (uint8_t shift = 0;; shift += 7) {
+    if (n >= avail) return 0;
+    if (shift > 28) return -1;
+    uint8_t b = buf[n++];
+    r.dtMs |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) break;
+  }
+  if (n + r.len > avail) return 0;
+  memcpy(r.data, buf + n, r.len);
+  return n + r.len;
+}
+
+#endif // CAPTURE_H
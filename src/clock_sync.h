@@ -0,0 +1,214 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <Arduino.h>
+#include <WiFiNINA.h>
+#include "config.h"
+#include "dispatcher.h"
+#include "log.h"
+#include "profile.h"
+#include "protocol.h"
+#include "relay_link.h"
+#include "reliable.h"
+#include "udp_communication.h"
+
+// Round-trip time and clock offset to the peer, NTP style. A PING carries
+// our millis() (t0); the peer answers at once with a PONG holding its own
+// millis() on receipt (t1) and echoing t0. When the PONG arrives at t3:
+//   rtt    = t3 - t0
+//   offset = t1 - (t0 + rtt / 2)   (peer clock minus ours)
+// A sample whose two legs took different times has a wrong offset, and
+// the fastest sample is the least lopsided one, so the estimate is the
+// offset of the fastest of the last CLOCK_FILTER samples. RTT samples also
+// go into the reliable link's smoothed RTT (reliable.h), which then sizes
+// the retransmit timeout, the READY wait and the AIM batch rate below.
+//
+// One PING is in flight at a time: every CLOCK_PING_FAST_MS until the
+// filter is full, then every CLOCK_PING_MS. An unanswered PING is given up
+// after CLOCK_PING_TIMEOUT_MS and counted as lost.
+
+static const uint8_t CLOCK_FILTER = 4;
+static const unsigned long CLOCK_PING_FAST_MS = 250;
+static const unsigned long CLOCK_PING_MS = 1000;
+static const unsigned long CLOCK_PING_TIMEOUT_MS = 2000;
+static const unsigned long CLOCK_REPORT_MS = 60000;
+
+// AIM batch period until the link is measured, and its bounds after. The
+// longest must fit a full batch (aim_stream.h).
+static const unsigned long AIM_SEND_INTERVAL_MS = 300;
+static const unsigned long AIM_SEND_MIN_MS = 250;
+static const unsigned long AIM_SEND_MAX_MS = 600;
+static const unsigned long PEER_SILENT_MIN_MS = 3 * CLOCK_PING_MS;
+
+struct ClockSample {
+  uint16_t rtt;
+  int32_t offset;
+};
+
+struct PeerClock {
+  ClockSample filter[CLOCK_FILTER];
+  uint8_t next;           // filter slot the next sample goes into
+  uint8_t count;          // samples in the filter
+  int32_t offset;         // current estimate, valid once count > 0
+  uint16_t rttMin, rttMax;
+  uint16_t samples, lost;
+  bool awaiting;          // a PING is in flight
+  uint32_t pingSentAt;
+  uint32_t lastHeardAt;   // last PING or PONG from the peer
+  uint32_t lastReportAt;
+};
+
+static PeerClock peerClock;
+
+inline void csInit(PeerClock &c) {
+  memset(&c, 0, sizeof(c));
+  c.rttMin = 0xFFFF;
+}
+
+inline bool csSynced(const PeerClock &c) {
+  return c.count > 0;
+}
+
+// Returns true when a PING should go out now.
+inline bool csPingDue(const PeerClock &c, uint32_t now) {
+  if (c.awaiting) return now - c.pingSentAt >= CLOCK_PING_TIMEOUT_MS;
+  if (!c.samples && !c.lost) return true;
+  return now - c.pingSentAt >= (c.count < CLOCK_FILTER ? CLOCK_PING_FAST_MS : CLOCK_PING_MS);
+}
+
+inline void csPingSent(PeerClock &c, uint32_t now) {
+  if (c.awaiting) c.lost++;
+  c.awaiting = true;
+  c.pingSentAt = now;
+}
+
+// Take the sample from a PONG. Returns false for a PONG that does not
+// answer the PING in flight (late or duplicated).
+inline bool csSample(PeerClock &c, uint32_t t0, uint32_t t1, uint32_t t3) {
+  if (!c.awaiting || t0 != c.pingSentAt) return false;
+  c.awaiting = false;
+  uint32_t rtt = t3 - t0;
+  if (rtt > 0xFFFF) rtt = 0xFFFF;
+  ClockSample &s = c.filter[c.next];
+  s.rtt = (uint16_t)rtt;
+  s.offset = (int32_t)(t1 - t0) - (int32_t)(rtt / 2);
+  c.next = (c.next + 1) % CLOCK_FILTER;
+  if (c.count < CLOCK_FILTER) c.count++;
+  const ClockSample *best = &c.filter[0];
+  for (uint8_t i = 1; i < c.count; i++)
+    if (c.filter[i].rtt < best->rtt) best = &c.filter[i];
+  c.offset = best->offset;
+  if (s.rtt < c.rttMin) c.rttMin = s.rtt;
+  if (s.rtt > c.rttMax) c.rttMax = s.rtt;
+  c.samples++;
+  return true;
+}
+
+// Our estimate of the peer's clock minus ours, as sent in READY.
+inline int32_t clockOffset() {
+  return csSynced(peerClock) ? peerClock.offset : OFFSET_UNKNOWN;
+}
+
+// The placement tie-break both boards agree on: the lower IP address
+// shoots first. Each board's peerIp() is the other one's address; through
+// the relay, the board that registered first does.
+inline bool clockWinsTie() {
+  if (USE_RELAY) return relayRole == 0;
+  IPAddress mine = WiFi.localIP();
+  const IPAddress& theirs = peerIp();
+  for (uint8_t i = 0; i < 4; i++)
+    if (mine[i] != theirs[i]) return mine[i] < theirs[i];
+  return false;
+}
+
+// How often an AIM batch goes out: three retransmit timeouts within the
+// bounds, so a slow or jittery link gets fewer, fuller packets.
+inline unsigned long clockAimIntervalMs() {
+  if (!csSynced(peerClock)) return AIM_SEND_INTERVAL_MS;
+  unsigned long sized = 3 * (unsigned long)peerLink.rto;
+  return sized < AIM_SEND_MIN_MS ? AIM_SEND_MIN_MS : sized > AIM_SEND_MAX_MS ? AIM_SEND_MAX_MS : sized;
+}
+
+// How far behind the peer's cursor AIM playback runs: a batch period plus
+// twice the RTT variation, so the next batch is normally in before the
+// current one has played out.
+inline unsigned long clockAimDelayMs() {
+  return clockAimIntervalMs() + (peerLink.rttvar4 >> 1);
+}
+
+// How long the opponent's aim marker outlives its last update: at least
+// baseMs, longer when the peer's updates come slowly.
+inline unsigned long clockOppAimTimeoutMs(unsigned long baseMs) {
+  unsigned long sized = 4 * clockAimIntervalMs() + 2 * (unsigned long)peerLink.rto;
+  return sized > baseMs ? sized : baseMs;
+}
+
+// True when the peer should be given up on, counting from sinceMs: after
+// unmeasuredMs if it has never answered a PING, otherwise once it has been
+// silent for several ping periods or RTOs. A peer that keeps answering is
+// never given up on, and neither is one we could not have heard: time
+// only counts while our socket is up.
+inline bool clockPeerGone(unsigned long sinceMs, unsigned long unmeasuredMs, unsigned long now) {
+  if (!udpStarted) return false;
+  if ((long)(udpStartedAt - sinceMs) > 0) sinceMs = udpStartedAt;
+  if (!csSynced(peerClock)) return now - sinceMs > unmeasuredMs;
+  unsigned long from = (long)(peerClock.lastHeardAt - sinceMs) > 0 ? peerClock.lastHeardAt : sinceMs;
+  unsigned long silent = 8 * (unsigned long)peerLink.rto;
+  return now - from > (silent > PEER_SILENT_MIN_MS ? silent : PEER_SILENT_MIN_MS);
+}
+
+inline void clockReport() {
+  const PeerClock &c = peerClock;
+  LOG(CLOCK_SYNC, rlSmoothedRtt(peerLink), c.rttMin, c.rttMax, peerLink.rttvar4 >> 2, c.offset, c.samples, c.lost);
+}
+
+inline void clockOnPing(const Message &msg) {
+  unsigned long now = millis();
+  peerClock.lastHeardAt = now;
+  Message pong = makeMessage(MSG_PONG);
+  pong.value = now;
+  pong.echo = msg.value;
+  // Straight out, outside the reliable link's numbering
+  sendMessageTo(peerIp(), peerPort(), pong);
+}
+
+inline void clockOnPong(const Message &msg) {
+  unsigned long now = millis();
+  peerClock.lastHeardAt = now;
+  bool filling = peerClock.count < CLOCK_FILTER;
+  if (!csSample(peerClock, msg.echo, msg.value, now)) return;
+  uint32_t rtt = now - msg.echo;
+  rlSampleRtt(peerLink, rtt);
+#if PROFILE
+  profileRecord(PROBE_RTT, rtt * 1000UL);
+#endif
+  // Report as soon as the filter is full, then every CLOCK_REPORT_MS
+  if (filling && peerClock.count == CLOCK_FILTER) {
+    peerClock.lastReportAt = now;
+    clockReport();
+  }
+}
+
+inline void clockSyncBegin() {
+  csInit(peerClock);
+  onMessage(MSG_PING, clockOnPing);
+  onMessage(MSG_PONG, clockOnPong);
+}
+
+// Send the next PING when due and report now and then; call from the
+// network task while connected.
+inline void clockSyncPoll() {
+  unsigned long now = millis();
+  if (peerKnown && csPingDue(peerClock, now)) {
+    csPingSent(peerClock, now);
+    Message ping = makeMessage(MSG_PING);
+    ping.value = now;
+    sendMessageTo(peerIp(), peerPort(), ping);
+  }
+  if (peerClock.count == CLOCK_FILTER && now - peerClock.lastReportAt >= CLOCK_REPORT_MS) {
+    peerClock.lastReportAt = now;
+    clockReport();
+  }
+}
+
+#endif // CLOCK_SYNC_H
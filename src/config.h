@@ -3,10 +3,7 @@
 
 #include <Arduino.h>
 #include <IPAddress.h>
-
-const uint8_t sizes[] = {4, 3, 2};
-const uint8_t counts[] = {1, 2, 3};
-const int types = 3;
+#include "board_config.h"  // board size and fleet (GAME_PRESET)
 
 // This board listens on port 8888
 const unsigned int LOCAL_PORT = 8888;
@@ -15,8 +12,80 @@ const unsigned int LOCAL_PORT = 8888;
 const unsigned int OTHER_PORT = 8888;
 const IPAddress OTHER_IP(172,20,10,4);
 
+// Opponent discovery (discovery.h): 1 = find the other board by subnet
+// broadcast beacons while the boats are placed, so OTHER_IP is not used
+// and need not match the network. Boards pair only with boards built with
+// the same GAME_PRESET. Not used with USE_RELAY.
+#ifndef USE_DISCOVERY
+#define USE_DISCOVERY 1
+#endif
+
+// Relay server (src/host/relay): 1 = reach the other board through the
+// relay at RELAY_IP/RELAY_PORT instead of at OTHER_IP. The relay pairs the
+// two boards that register the same RELAY_TABLE, so every table at a
+// venue runs the same firmware apart from this number.
+#ifndef USE_RELAY
+#define USE_RELAY 0
+#endif
+const IPAddress RELAY_IP(172,20,10,2);
+const unsigned int RELAY_PORT = 9999;
+#ifndef RELAY_TABLE
+#define RELAY_TABLE 1
+#endif
+
 // Toggle: when enabled (1) the waiting player will see where the opponent is
-// currently aiming (sent as AIM:x,y packets). Set to 0 to disable.
+// currently aiming (streamed as AIM batches, see aim_stream.h). Set to 0 to
+// disable.
 #define SHOW_OPPONENT_AIM 1
 
+// Wire format for outgoing messages: 1 = compact binary packets, 0 = legacy
+// text ("SHOT:x,y"). Both formats are always accepted on receive.
+#define WIRE_BINARY 1
+
+// Serial logging (log.h). Messages above LOG_LEVEL compile to nothing.
+// LOG_BINARY 1 sends compact records for tools/logdecode.py; 0 sends text
+// readable in any serial monitor.
+#define LOG_NONE 0
+#define LOG_ERROR 1
+#define LOG_WARN 2
+#define LOG_INFO 3
+#define LOG_DEBUG 4
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO
+#endif
+#ifndef LOG_BINARY
+#define LOG_BINARY 1
+#endif
+
+// Loop profiler (profile.h): 1 = time each task and stage into latency
+// histograms, dumped by sending 'p' on the serial port or a UDP STATS
+// query, and rendered with tools/profview.py. 0 compiles every probe out.
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+// Packet capture (capture.h): 1 = copy every datagram sent to or received
+// from the peer into the serial log, for tools/logdecode.py --capture.
+#ifndef CAPTURE
+#define CAPTURE 0
+#endif
+
+// Game snapshot (snapshot.h): 1 = keep the game in progress in EEPROM, so
+// a board that resets or browns out resumes it at boot and catches up with
+// the other board. Not used in SOLO_AI builds.
+#ifndef SNAPSHOT
+#define SNAPSHOT 1
+#endif
+
+// Single-board mode: 1 = play against the built-in AI instead of a second
+// board (no WiFi needed). SOLO_AI_DEPTH is its difficulty, the number of
+// boats it searches placements for: 0 fires at random, AI_DEPTH_MAX is the
+// deepest search that fits a frame (the full one except on 16x16). A
+// nonzero SOLO_AI_SEED fixes its fleet and shots.
+#ifndef SOLO_AI
+#define SOLO_AI 0
+#endif
+#define SOLO_AI_DEPTH AI_DEPTH_MAX
+#define SOLO_AI_SEED 0
+
 #endif
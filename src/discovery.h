@@ -0,0 +1,174 @@
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <Arduino.h>
+#include <WiFiNINA.h>
+#include "board_config.h"
+#include "config.h"
+#include "dispatcher.h"
+#include "log.h"
+#include "protocol.h"
+#include "udp_communication.h"
+
+// Opponent discovery (USE_DISCOVERY). Every DISCOVERY_BEACON_MS a board
+// broadcasts a BEACON on its subnet: its board id (from the MAC address),
+// the board it has picked (0 = none yet) and a hash of its game
+// configuration. Beacons with another hash are ignored, so only boards
+// built for the same board, fleet and protocol find each other.
+//
+// Boards heard go into a small table and drop out after
+// DISCOVERY_PEER_TTL_MS of silence. A board picks the live peer that has
+// picked it, else the lowest id among those that have picked nobody, and
+// sends its traffic there (setPeerAddress). Two boards alone on a network
+// pick each other at once; with more, the lowest ids pair off first. Once
+// the pick is mutual it is final for this boot: beacons slow to
+// DISCOVERY_KEEPALIVE_MS so that other boards see the pair as taken, and
+// if the peer turns up at another address (a new lease after a reconnect)
+// its traffic follows it there; if it restarts and no longer names us, we
+// beacon straight back so it picks us again. Until a peer is picked
+// nothing but beacons goes out, and only beacons are taken from anyone.
+
+static const unsigned long DISCOVERY_BEACON_MS = 500;
+static const unsigned long DISCOVERY_KEEPALIVE_MS = 5000;
+static const unsigned long DISCOVERY_PEER_TTL_MS = 2000;
+static const uint8_t DISCOVERY_MAX_PEERS = 4;
+
+struct DiscoveredPeer {
+  uint32_t id;       // 0 = free slot
+  uint32_t partner;  // the board it has picked
+  uint32_t ip;       // IPAddress raw value
+  uint16_t port;
+  unsigned long seenAt;
+};
+
+static DiscoveredPeer discoveryPeers[DISCOVERY_MAX_PEERS];
+static uint32_t discoveryId = 0;
+static uint16_t discoveryConfig = 0;
+static uint32_t discoveryPicked = 0;
+static bool discoveryLocked = false;
+static uint32_t discoveryMismatchId = 0;  // last one logged
+static unsigned long discoveryBeaconAt = 0;
+static bool discoveryBeaconSent = false;
+
+inline uint32_t discoveryHash(uint32_t h, uint8_t byte) {
+  return (h ^ byte) * 16777619UL;  // FNV-1a
+}
+
+// What two boards must agree on to play: board size, fleet, and the
+// message set.
+inline uint16_t discoveryConfigHash() {
+  uint32_t h = 2166136261UL;
+  h = discoveryHash(h, GameBoard::width);
+  h = discoveryHash(h, GameBoard::height);
+  for (uint8_t i = 0; i < GameFleet::count; i++) h = discoveryHash(h, GameFleet::sizes[i]);
+  h = discoveryHash(h, MSG_TYPE_COUNT);
+  return (uint16_t)(h ^ h >> 16);
+}
+
+inline bool discoveryLive(const DiscoveredPeer& p, unsigned long now) {
+  return p.id && now - p.seenAt < DISCOVERY_PEER_TTL_MS;
+}
+
+// Re-pick from the table: the peer that picked us, else the free one with
+// the lowest id.
+inline void discoverySelect(unsigned long now) {
+  if (discoveryLocked) return;
+  DiscoveredPeer* best = nullptr;
+  for (uint8_t i = 0; i < DISCOVERY_MAX_PEERS; i++) {
+    DiscoveredPeer& p = discoveryPeers[i];
+    if (!discoveryLive(p, now)) continue;
+    bool mutual = p.partner == discoveryId;
+    if (!mutual && p.partner) continue;  // taken
+    bool bestMutual = best && best->partner == discoveryId;
+    if (!best || mutual > bestMutual || (mutual == bestMutual && p.id < best->id)) best = &p;
+  }
+  uint32_t pick = best ? best->id : 0;
+  if (pick != discoveryPicked) {
+    discoveryPicked = pick;
+    // Tell the others at once
+    discoveryBeaconSent = false;
+    if (best) {
+      IPAddress ip(best->ip);
+      setPeerAddress(ip, best->port);
+      LOG(PEER_PICKED, best->id, ip[0], ip[1], ip[2], ip[3]);
+    } else {
+      clearPeerAddress();
+    }
+  }
+  if (best && best->partner == discoveryId) {
+    IPAddress ip(best->ip);
+    discoveryLocked = true;
+    LOG(PEER_PAIRED, best->id, ip[0], ip[1], ip[2], ip[3]);
+  }
+}
+
+inline void discoveryOnBeacon(const Message& msg) {
+  uint32_t id = msg.value;
+  if (!id || id == discoveryId) return;
+  IPAddress from = udp.remoteIP();
+  if (msg.configHash != discoveryConfig) {
+    if (id != discoveryMismatchId) LOG(PEER_MISMATCH, id, from[0], from[1], from[2], from[3], msg.configHash, discoveryConfig);
+    discoveryMismatchId = id;
+    return;
+  }
+  unsigned long now = millis();
+  DiscoveredPeer* slot = nullptr;
+  for (uint8_t i = 0; i < DISCOVERY_MAX_PEERS; i++) {
+    DiscoveredPeer& p = discoveryPeers[i];
+    if (p.id == id) {
+      slot = &p;
+      break;
+    }
+    // Otherwise the free slot, or the one silent longest
+    if (!slot || (slot->id && (!p.id || now - p.seenAt > now - slot->seenAt))) slot = &p;
+  }
+  bool known = slot->id == id;
+  // The partner is never evicted
+  if (!known && discoveryLocked && slot->id == discoveryPicked) return;
+  bool moved = known && (slot->ip != (uint32_t)from || slot->port != udp.remotePort());
+  slot->id = id;
+  slot->partner = msg.echo;
+  slot->ip = from;
+  slot->port = udp.remotePort();
+  slot->seenAt = now;
+  if (!known) LOG(PEER_FOUND, id, from[0], from[1], from[2], from[3]);
+  if (moved && id == discoveryPicked) {
+    setPeerAddress(from, slot->port);
+    LOG(PEER_MOVED, id, from[0], from[1], from[2], from[3]);
+  }
+  // The partner has forgotten us (it restarted): answer at once rather
+  // than at the next keepalive
+  if (discoveryLocked && id == discoveryPicked && msg.echo != discoveryId) discoveryBeaconSent = false;
+  discoverySelect(now);
+}
+
+inline void discoveryBegin() {
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  uint32_t h = 2166136261UL;
+  for (uint8_t i = 0; i < 6; i++) h = discoveryHash(h, mac[i]);
+  discoveryId = h ? h : 1;
+  discoveryConfig = discoveryConfigHash();
+  onMessage(MSG_BEACON, discoveryOnBeacon);
+}
+
+// Beacon when due; call from the network task while connected.
+inline void discoveryPoll() {
+  unsigned long now = millis();
+  unsigned long interval = discoveryLocked ? DISCOVERY_KEEPALIVE_MS : DISCOVERY_BEACON_MS;
+  if (discoveryBeaconSent && now - discoveryBeaconAt < interval) return;
+  // Let silent peers go before saying whom we picked
+  discoverySelect(now);
+  Message beacon = makeMessage(MSG_BEACON);
+  beacon.value = discoveryId;
+  beacon.echo = discoveryPicked;
+  beacon.configHash = discoveryConfig;
+  IPAddress broadcast = WiFi.localIP(), mask = WiFi.subnetMask();
+  for (uint8_t i = 0; i < 4; i++) broadcast[i] |= (uint8_t)~mask[i];
+  // Straight out: a beacon is repeated, not retransmitted
+  sendMessageTo(broadcast, LOCAL_PORT, beacon);
+  discoveryBeaconAt = now;
+  discoveryBeaconSent = true;
+}
+
+#endif // DISCOVERY_H
@@ -0,0 +1,40 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include "protocol.h"
+#include "udp_communication.h"
+
+// Central receive path: every tick drains all pending datagrams and routes
+// each message to the handler registered for its type, in arrival order.
+
+typedef void (*MessageHandler)(const Message& msg);
+
+// Bound on packets read per tick so a flood cannot stall the frame.
+static const uint8_t MAX_PACKETS_PER_TICK = 16;
+
+static MessageHandler messageHandlers[MSG_TYPE_COUNT];
+
+inline void onMessage(uint8_t type, MessageHandler handler) {
+  if (type < MSG_TYPE_COUNT) messageHandlers[type] = handler;
+}
+
+inline void deliverMessage(const Message& msg) {
+  MessageHandler handler = messageHandlers[msg.type];
+  if (handler) handler(msg);
+}
+
+// Read and dispatch everything queued on the socket. Returns the number of
+// messages delivered.
+inline uint8_t dispatchMessages() {
+  Message msg;
+  uint8_t delivered = 0;
+  for (uint8_t n = 0; n < MAX_PACKETS_PER_TICK && receiveMessage(msg); n++) {
+    if (msg.type == MSG_NONE || msg.type >= MSG_TYPE_COUNT) continue;
+    // AIM batches each carry their own samples: none supersedes another
+    deliverMessage(msg);
+    delivered++;
+  }
+  return delivered;
+}
+
+#endif
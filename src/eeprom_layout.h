@@ -0,0 +1,19 @@
+#ifndef EEPROM_LAYOUT_H
+#define EEPROM_LAYOUT_H
+
+#include <stdint.h>
+
+// Who owns which bytes of EEPROM. The ATmega4809 has 256, each good for
+// about 100k writes, so every user keeps to its own range and writes only
+// the bytes that change (EEPROM.put / update do).
+
+static const uint16_t EEPROM_NET_CACHE_ADDR = 0;  // wifi_setup.h, NetCache
+static const uint16_t EEPROM_NET_CACHE_SIZE = 32;
+static const uint16_t EEPROM_SNAPSHOT_ADDR = 32;  // snapshot.h, the rest
+static const uint16_t EEPROM_SNAPSHOT_SIZE = 224;
+static const uint16_t EEPROM_SIZE = 256;
+
+static_assert(EEPROM_NET_CACHE_ADDR + EEPROM_NET_CACHE_SIZE <= EEPROM_SNAPSHOT_ADDR, "EEPROM ranges overlap");
+static_assert(EEPROM_SNAPSHOT_ADDR + EEPROM_SNAPSHOT_SIZE <= EEPROM_SIZE, "EEPROM ranges overrun the part");
+
+#endif // EEPROM_LAYOUT_H
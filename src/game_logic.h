@@ -1,27 +1,55 @@
 ﻿#pragma once
 #include <FastLED.h>
 #include "led_matrix.h"
+#include "bitboard.h"
+#include "placement.h"
 #include "joystick.h"
 #include "udp_communication.h"
+#include "dispatcher.h"
+#include "clock_sync.h"
+#include "aim_stream.h"
 #include "config.h"
+#include "log.h"
+#include "profile.h"
+
+// Fleet and board size come from board_config.h
+static const uint8_t BOAT_COUNT = GameFleet::count;
+
+// Palette indices the game draws with; GAME_PALETTE holds their colours.
+enum GameColor : uint8_t {
+    COLOR_BLACK = 0,
+    COLOR_PLACING,
+    COLOR_PLACED,
+    COLOR_INVALID,
+    COLOR_MISS,
+    COLOR_HIT,
+    COLOR_SUNK,
+    COLOR_AIM,
+    COLOR_WAITING,
+    COLOR_COUNT
+};
 
-#define MAX_BOAT_TYPES 6
-#define MAX_BOATS 10
+static const uint32_t GAME_PALETTE[COLOR_COUNT] PROGMEM = {
+    CRGB::Black,   // COLOR_BLACK
+    CRGB::Blue,    // COLOR_PLACING
+    CRGB::Green,   // COLOR_PLACED
+    CRGB::Red,     // COLOR_INVALID
+    CRGB::Blue,    // COLOR_MISS
+    CRGB::Red,     // COLOR_HIT
+    CRGB::Purple,  // COLOR_SUNK
+    CRGB::Yellow,  // COLOR_AIM
+    CRGB::Blue,    // COLOR_WAITING
+};
 
-static const CRGB COLOR_PLACING = CRGB::Blue;
-static const CRGB COLOR_PLACED = CRGB::Green;
-static const CRGB COLOR_INVALID = CRGB::Red;
-static const CRGB COLOR_MISS = CRGB::Blue;
-static const CRGB COLOR_HIT = CRGB::Red;
-static const CRGB COLOR_SUNK = CRGB::Purple;
-static const CRGB COLOR_AIM = CRGB::Yellow;
-static const CRGB COLOR_WAITING = CRGB::Blue;
+static_assert(COLOR_COUNT <= PALETTE_SIZE, "game colours must fit the 4-bit palette");
 
 static const unsigned long LONG_PRESS_MS = 500;
-static const unsigned long AIM_SEND_INTERVAL_MS = 150;
-static const unsigned long OPP_AIM_TIMEOUT_MS = 1500;
+static const unsigned long AUTO_PLACE_PRESS_MS = 2000; // places the remaining boats at random
+static const unsigned long OPP_AIM_TIMEOUT_MS = 1500; // at least; longer on a slow link (clock_sync.h)
 
-static const unsigned long READY_HANDSHAKE_TIMEOUT_MS = 10000; // 10 second timeout for ready handshake
+// Give up on an opponent that never answered a PING after 10 s; one that
+// answers is still placing and is waited for (clockPeerGone)
+static const unsigned long READY_HANDSHAKE_TIMEOUT_MS = 10000;
 static const unsigned long PHASE_DISPLAY_TIME_MS = 1000; // 1 second to view opponent's shot
 
 struct Boat {
@@ -29,23 +57,28 @@ struct Boat {
     int x, y;
     bool vertical;
     bool placed;
+    uint8_t hits; // distinct cells hit so far
 };
 
-static Boat boats[MAX_BOATS];
-static uint8_t boatsCount = 0;
+// Cell -> boat index, two cells per byte; NO_BOAT marks open water
+// (board_config.h keeps the fleet below it).
+static const uint8_t NO_BOAT = 0x0F;
+
+static Boat boats[BOAT_COUNT];
 static int currentIndex = 0;
-static bool occupied[WIDTH][HEIGHT];
-static int prevButtonState = 0;
-static unsigned long buttonPressTime = 0;
+static BitBoard occupied;
+static uint8_t boatIdGrid[(GameBoard::cells + 1) / 2];
 
-static bool hitMap[WIDTH][HEIGHT];
-static uint8_t opponentMap[WIDTH][HEIGHT];
+static BitBoard hitMap;
+static BitBoard shotAtMap;  // every cell the opponent has fired at, hit or miss
+static CellPlanes opponentMap;
 static int aimX = WIDTH / 2;
 static int aimY = HEIGHT / 2;
 static bool myTurn = true;
-static unsigned long lastAimSendTime = 0;
-static int oppAimX = -1, oppAimY = -1;
-static unsigned long oppAimTime = 0;
+// Bumped whenever a shot is fired, answered or its result arrives, so
+// snapshot.h knows when to save; awaitingResult is set between the two.
+static uint8_t gameMoves = 0;
+static bool awaitingResult = false;
 
 // Turn flow state machine
 enum GamePhase { PHASE_MY_TURN, PHASE_OPPONENT_SHOT, PHASE_SHOW_RESULT, PHASE_WAIT_FOR_OPPONENT };
@@ -57,57 +90,56 @@ static const unsigned long RESULT_DISPLAY_TIME_MS = 1000; // 1 second to view op
 enum ReadyState { READY_PLACEMENT, READY_WAITING_FOR_OPPONENT, READY_SYNCED };
 static ReadyState readyState = READY_PLACEMENT;
 static unsigned long placementFinishedTime = 0;
+static int32_t placementOffset = OFFSET_UNKNOWN; // clock offset sent with our READY
 static bool opponentReady = false;
 static unsigned long readyStateStartTime = 0;
 static unsigned long opponentPlacementTime = 0;
+static int32_t opponentOffset = OFFSET_UNKNOWN;
 static bool opponentPlacementTimeReceived = false;
 
-inline bool beginPlacement(const uint8_t sizes[], const uint8_t counts[], int types) {
-    boatsCount = 0; currentIndex = 0;
-    for (int y = 0; y < HEIGHT; y++)
-        for (int x = 0; x < WIDTH; x++)
-            occupied[x][y] = false;
-    for (int y = 0; y < HEIGHT; y++)
-        for (int x = 0; x < WIDTH; x++)
-            hitMap[x][y] = false, opponentMap[x][y] = 0;
-    for (int t = 0; t < types; t++)
-        for (int c = 0; c < counts[t]; c++) {
-            if (boatsCount >= MAX_BOATS) return false;
-            boats[boatsCount].size = sizes[t];
-            boats[boatsCount].x = 0;
-            boats[boatsCount].y = 0;
-            boats[boatsCount].vertical = false;
-            boats[boatsCount].placed = false;
-            boatsCount++;
-        }
-    if (boatsCount > 0) {
-        boats[0].x = max(0, (WIDTH - boats[0].size) / 2);
-        boats[0].y = HEIGHT / 2;
+inline void beginPlacement() {
+    currentIndex = 0;
+    bbClear(occupied);
+    bbClear(hitMap);
+    bbClear(shotAtMap);
+    cpClear(opponentMap);
+    memset(boatIdGrid, 0xFF, sizeof(boatIdGrid));
+    for (uint8_t i = 0; i < BOAT_COUNT; i++) {
+        boats[i].size = GameFleet::sizes[i];
+        boats[i].x = 0;
+        boats[i].y = 0;
+        boats[i].vertical = false;
+        boats[i].placed = false;
+        boats[i].hits = 0;
     }
-    return true;
+    boats[0].x = max(0, (WIDTH - boats[0].size) / 2);
+    boats[0].y = HEIGHT / 2;
+}
+
+inline uint8_t cellBoatId(int x, int y) {
+    int cell = y * WIDTH + x;
+    uint8_t packed = boatIdGrid[cell >> 1];
+    return (cell & 1) ? (packed >> 4) : (packed & 0x0F);
+}
+
+inline void setCellBoatId(int x, int y, uint8_t id) {
+    int cell = y * WIDTH + x;
+    uint8_t &packed = boatIdGrid[cell >> 1];
+    if (cell & 1) packed = (packed & 0x0F) | (id << 4);
+    else packed = (packed & 0xF0) | id;
 }
 
 inline bool fitsInBounds(const Boat &b) {
-    if (!b.vertical)
-        return (b.x >= 0 && b.y >= 0 && b.x + b.size <= WIDTH && b.y < HEIGHT);
-    else
-        return (b.x >= 0 && b.y >= 0 && b.x < WIDTH && b.y + b.size <= HEIGHT);
+    return originLegal(b.size, b.vertical, b.x, b.y);
 }
 
 inline bool collidesWithPlaced(const Boat &b) {
     if (!fitsInBounds(b)) return true;
-    if (!b.vertical) {
-        for (int i = 0; i < b.size; i++)
-            if (occupied[b.x + i][b.y]) return true;
-    } else {
-        for (int i = 0; i < b.size; i++)
-            if (occupied[b.x][b.y + i]) return true;
-    }
-    return false;
+    return bbAny(occupied, b.x, b.y, b.size, b.vertical);
 }
 
 inline void moveCurrentBoat(int dx, int dy, int button) {
-    if (currentIndex >= boatsCount || button != 0) return;
+    if (currentIndex >= BOAT_COUNT || button != 0) return;
     Boat &b = boats[currentIndex];
     b.x += dx; b.y += dy;
     if (!b.vertical) {
@@ -124,7 +156,7 @@ inline void moveCurrentBoat(int dx, int dy, int button) {
 }
 
 inline void rotateCurrentBoat() {
-    if (currentIndex >= boatsCount) return;
+    if (currentIndex >= BOAT_COUNT) return;
     Boat &b = boats[currentIndex];
     b.vertical = !b.vertical;
     if (!b.vertical) {
@@ -137,141 +169,179 @@ inline void rotateCurrentBoat() {
 }
 
 inline void confirmPlacement(bool &finished) {
-    if (currentIndex >= boatsCount) return;
+    if (currentIndex >= BOAT_COUNT) return;
     Boat &b = boats[currentIndex];
     if (collidesWithPlaced(b)) return;
-    if (!b.vertical) {
-        for (int i = 0; i < b.size; i++) occupied[b.x + i][b.y] = true;
-    } else {
-        for (int i = 0; i < b.size; i++) occupied[b.x][b.y + i] = true;
+    bbFill(occupied, b.x, b.y, b.size, b.vertical);
+    for (int i = 0; i < MAX_SPAN && i < b.size; i++) {
+        if (!b.vertical) setCellBoatId(b.x + i, b.y, currentIndex);
+        else setCellBoatId(b.x, b.y + i, currentIndex);
     }
     b.placed = true;
     currentIndex++;
-    if (currentIndex < boatsCount) {
+    if (currentIndex < BOAT_COUNT) {
         Boat &next = boats[currentIndex];
         next.vertical = false;
         next.x = max(0, (WIDTH - next.size) / 2);
         next.y = HEIGHT / 2;
     } else {
         finished = true;
-        Serial.println("Placement complete!");
+        LOG(PLACEMENT_DONE);
     }
 }
 
-inline void drawPlacementFrame(CRGB frame[WIDTH][HEIGHT]) {
-    for (int y = 0; y < HEIGHT; y++)
-        for (int x = 0; x < WIDTH; x++)
-            frame[x][y] = CRGB::Black;
-    for (int i = 0; i < boatsCount; i++) {
-        if (!boats[i].placed) continue;
-        Boat &b = boats[i];
-        if (!b.vertical) {
-            for (int cell = 0; cell < b.size; cell++) frame[b.x + cell][b.y] = COLOR_PLACED;
-        } else {
-            for (int cell = 0; cell < b.size; cell++) frame[b.x][b.y + cell] = COLOR_PLACED;
-        }
+// Paint every cell set in mask on row y with color.
+inline void drawRowMask(IndexedFrame &frame, int y, RowMask mask, uint8_t color) {
+    for (int x = 0; mask; x++, mask >>= 1)
+        if (mask & 1) frameSet(frame, x, y, color);
+}
+
+static FleetRng placementRng;
+
+// Place every boat not placed yet at a random free position.
+inline void autoPlaceFleet(bool &finished) {
+    if (currentIndex >= BOAT_COUNT) return;
+    // How long the button was held is as good a seed as any
+    placementRng.state ^= micros();
+    BitBoard occ = occupied;
+    BoatPlacement placed[BOAT_COUNT];
+    if (!randomFleet(placementRng, occ, placed, currentIndex)) return;
+    while (currentIndex < BOAT_COUNT) {
+        int index = currentIndex;
+        Boat &b = boats[index];
+        b.x = placed[index].x;
+        b.y = placed[index].y;
+        b.vertical = placed[index].vertical;
+        confirmPlacement(finished);
+        if (currentIndex == index) return;  // cannot happen: the spot was free
     }
-    if (currentIndex < boatsCount) {
+}
+
+inline void drawPlacementFrame(IndexedFrame &frame) {
+    frameFill(frame, COLOR_BLACK);
+    // Placed boats are exactly the occupied cells
+    for (int y = 0; y < HEIGHT; y++) drawRowMask(frame, y, occupied.rows[y], COLOR_PLACED);
+    if (currentIndex < BOAT_COUNT) {
         Boat &cb = boats[currentIndex];
-        CRGB color = (collidesWithPlaced(cb) || !fitsInBounds(cb)) ? COLOR_INVALID : COLOR_PLACING;
+        uint8_t color = (collidesWithPlaced(cb) || !fitsInBounds(cb)) ? COLOR_INVALID : COLOR_PLACING;
         if (!cb.vertical) {
-            for (int cell = 0; cell < cb.size; cell++) {
+            for (int cell = 0; cell < MAX_SPAN && cell < cb.size; cell++) {
                 int px = cb.x + cell, py = cb.y;
-                if (px >= 0 && px < WIDTH && py >= 0 && py < HEIGHT) frame[px][py] = color;
+                if (px >= 0 && px < WIDTH && py >= 0 && py < HEIGHT) frameSet(frame, px, py, color);
             }
         } else {
-            for (int cell = 0; cell < cb.size; cell++) {
+            for (int cell = 0; cell < MAX_SPAN && cell < cb.size; cell++) {
                 int px = cb.x, py = cb.y + cell;
-                if (px >= 0 && px < WIDTH && py >= 0 && py < HEIGHT) frame[px][py] = color;
+                if (px >= 0 && px < WIDTH && py >= 0 && py < HEIGHT) frameSet(frame, px, py, color);
             }
         }
     }
 }
 
-inline void placementStep(int dx, int dy, int button, CRGB frame[WIDTH][HEIGHT], bool &finished) {
-    if (dx != 0 || dy != 0) moveCurrentBoat(dx, dy, button);
-    if (button && !prevButtonState) buttonPressTime = millis();
-    if (!button && prevButtonState) {
-        unsigned long pressDuration = millis() - buttonPressTime;
-        if (pressDuration >= LONG_PRESS_MS) confirmPlacement(finished);
-        else rotateCurrentBoat();
-    }
-    prevButtonState = button;
+// pressMs is the length of a press released since the last step, 0 if
+// there was none.
+inline void placementStep(int dx, int dy, bool held, unsigned long pressMs, IndexedFrame &frame, bool &finished) {
+    if (dx != 0 || dy != 0) moveCurrentBoat(dx, dy, held);
+    if (pressMs >= AUTO_PLACE_PRESS_MS) autoPlaceFleet(finished);
+    else if (pressMs >= LONG_PRESS_MS) confirmPlacement(finished);
+    else if (pressMs) rotateCurrentBoat();
     drawPlacementFrame(frame);
 }
 
 inline int boatIndexAt(int x, int y) {
-    for (int i = 0; i < boatsCount; i++) {
-        Boat &b = boats[i];
-        if (!b.placed) continue;
-        if (!b.vertical) {
-            if (y == b.y && x >= b.x && x < b.x + b.size) return i;
-        } else {
-            if (x == b.x && y >= b.y && y < b.y + b.size) return i;
-        }
-    }
-    return -1;
+    uint8_t id = cellBoatId(x, y);
+    return id == NO_BOAT ? -1 : id;
 }
 
 inline bool boatSunk(int index) {
-    if (index < 0 || index >= boatsCount) return false;
+    if (index < 0 || index >= BOAT_COUNT) return false;
     Boat &b = boats[index];
-    if (!b.placed) return false;
-    if (!b.vertical) {
-        for (int i = 0; i < b.size; i++)
-            if (!hitMap[b.x + i][b.y]) return false;
-    } else {
-        for (int i = 0; i < b.size; i++)
-            if (!hitMap[b.x][b.y + i]) return false;
-    }
-    return true;
+    return b.placed && b.hits >= b.size;
 }
 
 inline void markSunkOpponentBoat(int x, int y) {
     if (x < 0 || y < 0) return;
-    opponentMap[x][y] = 3;
+    cpSet(opponentMap, x, y, CELL_SUNK);
     int lx = x, rx = x;
-    while (lx - 1 >= 0 && opponentMap[lx - 1][y] == 2) lx--;
-    while (rx + 1 < WIDTH && opponentMap[rx + 1][y] == 2) rx++;
+    while (lx - 1 >= 0 && cpGet(opponentMap, lx - 1, y) == CELL_HIT) lx--;
+    while (rx + 1 < WIDTH && cpGet(opponentMap, rx + 1, y) == CELL_HIT) rx++;
     if (rx > lx) {
-        for (int xi = lx; xi <= rx; xi++) opponentMap[xi][y] = 3;
+        for (int xi = lx; xi <= rx; xi++) cpSet(opponentMap, xi, y, CELL_SUNK);
         return;
     }
     int ty = y, by = y;
-    while (ty - 1 >= 0 && opponentMap[x][ty - 1] == 2) ty--;
-    while (by + 1 < HEIGHT && opponentMap[x][by + 1] == 2) by++;
+    while (ty - 1 >= 0 && cpGet(opponentMap, x, ty - 1) == CELL_HIT) ty--;
+    while (by + 1 < HEIGHT && cpGet(opponentMap, x, by + 1) == CELL_HIT) by++;
     if (by > ty) {
-        for (int yi = ty; yi <= by; yi++) opponentMap[x][yi] = 3;
+        for (int yi = ty; yi <= by; yi++) cpSet(opponentMap, x, yi, CELL_SUNK);
+    }
+}
+
+inline void drawOpponentMap(IndexedFrame &frame) {
+    PROFILE_SCOPE(DRAW_OPPONENT);
+    for (int y = 0; y < HEIGHT; y++) {
+        if (!(opponentMap.lo.rows[y] | opponentMap.hi.rows[y])) continue;
+        drawRowMask(frame, y, cpRow(opponentMap, y, CELL_MISS), COLOR_MISS);
+        drawRowMask(frame, y, cpRow(opponentMap, y, CELL_HIT), COLOR_HIT);
+        drawRowMask(frame, y, cpRow(opponentMap, y, CELL_SUNK), COLOR_SUNK);
+    }
+}
+
+inline void drawHitMap(IndexedFrame &frame) {
+    PROFILE_SCOPE(DRAW_HITS);
+    for (int y = 0; y < HEIGHT; y++) {
+        RowMask row = hitMap.rows[y];
+        for (int x = 0; row; x++, row >>= 1)
+            if (row & 1) frameSet(frame, x, y, boatSunk(boatIndexAt(x, y)) ? COLOR_SUNK : COLOR_HIT);
     }
 }
 
 inline bool getMyTurn() { return myTurn; }
 inline void setMyTurn(bool v) { myTurn = v; }
 
+inline void onReadyMessage(const Message &msg) {
+    if (msg.value) {
+        LOG(READY_RX_TIME, msg.value);
+    } else {
+        // Backwards-compatible: plain READY carries timestamp 0
+        LOG(READY_RX_PLAIN);
+    }
+    opponentReady = true;
+    opponentPlacementTime = msg.value;
+    opponentOffset = msg.offset;
+    opponentPlacementTimeReceived = true;
+    readyStateStartTime = millis();
+}
+
+// First-mover rule: whoever finished placement earlier shoots first. Each
+// time is on its sender's clock, so they are compared through the clock
+// offsets the boards sent with them (peer minus own, see clock_sync.h),
+// averaging the two estimates. Both boards work from the same four
+// numbers and get exactly opposite results, so one of them shoots first
+// even when the estimates are off. A missing offset is taken as the
+// negation of the other one (0 if both are missing); a missing timestamp
+// (0) counts as finishing last.
+//
+// Returns twice how much later we finished in ms: negative when we were
+// first, 0 on a tie.
+inline int32_t placementOrder(unsigned long myTime, int32_t myOffset, unsigned long theirTime, int32_t theirOffset) {
+    if (!myTime || !theirTime) return (int32_t)(myTime == 0) - (int32_t)(theirTime == 0);
+    if (myOffset == OFFSET_UNKNOWN) myOffset = theirOffset == OFFSET_UNKNOWN ? 0 : -theirOffset;
+    if (theirOffset == OFFSET_UNKNOWN) theirOffset = -myOffset;
+    // Wrapping arithmetic: the clocks' epochs cancel out
+    return (int32_t)(2 * (uint32_t)(myTime - theirTime) + (uint32_t)myOffset - (uint32_t)theirOffset);
+}
+
+// An exact tie goes to the board for which winsTie is set; the boards must
+// disagree on it (clockWinsTie).
+inline bool shootsFirst(unsigned long myTime, int32_t myOffset, unsigned long theirTime, int32_t theirOffset, bool winsTie) {
+    int32_t order = placementOrder(myTime, myOffset, theirTime, theirOffset);
+    return order < 0 || (order == 0 && winsTie);
+}
+
 inline void handleReadyHandshake() {
     // Handle the ready state machine for synchronizing game start
-    String msg = receiveMessage();
     unsigned long now = millis();
-    if (msg.length() > 0) {
-        if (msg.startsWith("READY:")) {
-            // Expect format: READY:<placementMillis>
-            unsigned long otherTime = (unsigned long) msg.substring(6).toInt();
-            Serial.print("[READY] Received opponent READY timestamp: ");
-            Serial.println(otherTime);
-            opponentReady = true;
-            opponentPlacementTime = otherTime;
-            opponentPlacementTimeReceived = true;
-            readyStateStartTime = now;
-        } else if (msg.startsWith("READY")) {
-            // Backwards-compatible: treat plain READY as timestamp 0
-            Serial.println("[READY] Received opponent READY (no timestamp)");
-            opponentReady = true;
-            opponentPlacementTime = 0;
-            opponentPlacementTimeReceived = true;
-            readyStateStartTime = now;
-        }
-    }
-
     if (readyState == READY_PLACEMENT) {
         // Still placing boats locally; nothing to do until placement finishes
         return;
@@ -279,26 +349,27 @@ inline void handleReadyHandshake() {
         // We're done placing, waiting for opponent
         if (opponentPlacementTimeReceived) {
             // Both sides have placement timestamps; compare to determine who finished first
-            Serial.println("[READY] Both timestamps available - deciding who shoots first...");
-            const unsigned long MAX_UL = 0xFFFFFFFFUL;
-            unsigned long myTime = placementFinishedTime ? placementFinishedTime : MAX_UL;
-            unsigned long theirTime = opponentPlacementTime ? opponentPlacementTime : MAX_UL;
-            Serial.print("[READY] myTime="); Serial.print(myTime);
-            Serial.print(" theirTime="); Serial.println(theirTime);
-            if (myTime <= theirTime) {
-                // We finished earlier (or tie) -> we shoot first
+            LOG(READY_DECIDING);
+            LOG(READY_TIMES, placementFinishedTime, opponentPlacementTime, placementOffset, opponentOffset);
+            int32_t order = placementOrder(placementFinishedTime, placementOffset, opponentPlacementTime, opponentOffset);
+            if (order == 0) LOG(READY_TIE);
+            if (gameMoves) {
+                // It started without us (READY timeout) and its first shot
+                // is already answered: the turn follows from that
+            } else if (order < 0 || (order == 0 && clockWinsTie())) {
+                // We finished earlier -> we shoot first
                 gamePhase = PHASE_MY_TURN;
-                Serial.println("[READY] >>> YOU FINISHED FIRST - YOU SHOOT FIRST! <<<");
+                LOG(READY_FIRST);
             } else {
                 // Opponent finished earlier -> they shoot first
                 gamePhase = PHASE_WAIT_FOR_OPPONENT;
-                Serial.println("[READY] >>> OPPONENT FINISHED FIRST - YOU WAIT FIRST <<<");
+                LOG(READY_SECOND);
             }
             readyState = READY_SYNCED;
             readyStateStartTime = now;
-        } else if ((now - placementFinishedTime) > READY_HANDSHAKE_TIMEOUT_MS) {
+        } else if (clockPeerGone(placementFinishedTime, READY_HANDSHAKE_TIMEOUT_MS, now)) {
             // Timeout - assume opponent is down or very slow
-            Serial.println("[READY] Opponent timeout! Starting anyway... you shoot first");
+            LOG(READY_TIMEOUT);
             readyState = READY_SYNCED;
             readyStateStartTime = now;
             gamePhase = PHASE_MY_TURN;
@@ -307,109 +378,141 @@ inline void handleReadyHandshake() {
         // Game has started
         if (!opponentReady && (now - readyStateStartTime) > 5000) {
             // Extra safety: if opponent becomes unready, note it
-            Serial.println("[READY] WARNING: Opponent became unready during game");
+            LOG(READY_LOST);
         }
     }
 }
 
 inline void notifyReadyToOpponent() {
     // Called when this player finishes placement
-    Serial.println("[READY] Notifying opponent that placement is complete (with timestamp)...");
+    LOG(READY_NOTIFY);
     // Send placement finish timestamp so we can determine who finished first
     placementFinishedTime = millis();
-    char buf[32];
-    snprintf(buf, sizeof(buf), "READY:%lu", placementFinishedTime);
-    Serial.print("[READY] Sending: "); Serial.println(buf);
-    sendMessage(buf);
+    placementOffset = clockOffset();
+    readyState = READY_WAITING_FOR_OPPONENT;
+    Message ready = makeMessage(MSG_READY);
+    ready.value = placementFinishedTime;
+    ready.offset = placementOffset;
+    LOG(READY_SEND, placementFinishedTime);
+    sendMessage(ready);
+}
+
+// Log a received message in its legacy text form.
+inline void logReceived(const Message &msg) {
+    switch (msg.type) {
+        case MSG_AIM:    LOG(RX_AIM, msg.x, msg.y); break;
+        case MSG_SHOT:   LOG(RX_SHOT, msg.x, msg.y); break;
+        case MSG_RESULT: LOG(RX_RESULT, msg.result); break;
+        default:         LOG(RX_OTHER, msg.type); break;
+    }
+}
+
+inline void onAimMessage(const Message &msg) {
+    logReceived(msg);
+    int x = msg.x, y = msg.y;
+    if (x < WIDTH && y < HEIGHT) {
+        LOG(OPP_AIM, x, y);
+        aimStreamReceive(msg, millis());
+    }
 }
 
-inline void aim(int dx, int dy, int button, CRGB frame[WIDTH][HEIGHT]) {
+// Whether a SHOT at a cell not fired at before is the opponent's move
+// now: while we wait for one, and before anything has been shot at all.
+// Then a READY timeout may have both boards start; if both have fired, the
+// tie-break decides whose shot stands.
+inline bool shotExpected() {
+    if (!awaitingResult && (gamePhase == PHASE_WAIT_FOR_OPPONENT || gamePhase == PHASE_SHOW_RESULT)) return true;
     for (int y = 0; y < HEIGHT; y++)
-        for (int x = 0; x < WIDTH; x++)
-            frame[x][y] = CRGB::Black;
-
-    String msg = receiveMessage();
-    if (msg.length() > 0) {
-        Serial.print("[AIM] Received message: ");
-        Serial.println(msg);
-
-        if (msg.startsWith("AIM:")) {
-            int comma = msg.indexOf(',');
-            if (comma > 4) {
-                int x = msg.substring(4, comma).toInt();
-                int y = msg.substring(comma + 1).toInt();
-                if (x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT)
-                {
-                    Serial.print("[AIM] Opponent aiming at: ");
-                    Serial.print(x);
-                    Serial.print(",");
-                    Serial.println(y);
-                    oppAimX = x, oppAimY = y, oppAimTime = millis();
-                }
-            }
+        if (shotAtMap.rows[y] | opponentMap.lo.rows[y] | opponentMap.hi.rows[y]) return false;
+    return !awaitingResult || !clockWinsTie();
+}
+
+inline void onShotMessage(const Message &msg) {
+    logReceived(msg);
+    int sx = msg.x, sy = msg.y;
+    if (sx >= WIDTH || sy >= HEIGHT) return;
+    // A cell already fired at is a repeat (a resumed board, or a link that
+    // numbers from 0 again): it gets the same answer and leaves the turn alone
+    bool repeat = bbGet(shotAtMap, sx, sy);
+    if (!repeat && !shotExpected()) {
+        LOG(SHOT_UNEXPECTED, sx, sy, gamePhase);
+        return;
+    }
+    LOG(OPP_SHOT, sx, sy);
+
+    bool wasHit = bbGet(occupied, sx, sy);
+    LOG(SHOT_RESULT, wasHit ? RESULT_HIT : RESULT_MISS);
+    int boatIdx = boatIndexAt(sx, sy);
+    if (!repeat) {
+        aimStreamReset();
+        bbSet(shotAtMap, sx, sy);
+        if (wasHit) {
+            bbSet(hitMap, sx, sy);
+            boats[boatIdx].hits++;
         }
-        else if (msg.startsWith("SHOT:")) {
-            int comma = msg.indexOf(',');
-            if (comma > 5) {
-                int sx = msg.substring(5, comma).toInt();
-                int sy = msg.substring(comma + 1).toInt();
-                Serial.print("[AIM] Opponent shot at: ");
-                Serial.print(sx);
-                Serial.print(",");
-                Serial.println(sy);
-
-                if (sx >= 0 && sx < WIDTH && sy >= 0 && sy < HEIGHT) {
-                    bool wasHit = occupied[sx][sy];
-                    Serial.print("[AIM] Shot result: ");
-                    Serial.println(wasHit ? "HIT" : "MISS");
-
-                    if (wasHit) hitMap[sx][sy] = true;
-                    int boatIdx = boatIndexAt(sx, sy);
-                    bool sunk = (boatIdx >= 0) && boatSunk(boatIdx);
-                    char reply[32];
-                    if (wasHit) snprintf(reply, sizeof(reply), "RESULT:%s", sunk ? "SINK" : "HIT");
-                    else snprintf(reply, sizeof(reply), "RESULT:MISS");
-                    // Transition locally first so we display the opponent's shot before the shooter receives the result
-                    Serial.println("[AIM] >>> Transitioning to PHASE_OPPONENT_SHOT (local)");
-                    gamePhase = PHASE_OPPONENT_SHOT;
-                    phaseStartTime = millis();
-                    // Now send the reply
-                    Serial.print("[AIM] Sending reply: ");
-                    Serial.println(reply);
-                    sendMessage(reply);
-                }
-            }
+        if (awaitingResult) {
+            // Both fired first and its shot stands: ours is void
+            LOG(SHOT_VOID, aimX, aimY);
+            awaitingResult = false;
         }
-        else if (msg.startsWith("RESULT:")) {
-            String result = msg.substring(7);
-            Serial.print("[AIM] Received result: ");
-            Serial.println(result);
-
-            if (aimX >= 0 && aimY >= 0) {
-                if (result.startsWith("HIT")) opponentMap[aimX][aimY] = 2;
-                else if (result.startsWith("MISS")) opponentMap[aimX][aimY] = 1;
-                else if (result.startsWith("SINK")) {
-                    opponentMap[aimX][aimY] = 2;
-                    markSunkOpponentBoat(aimX, aimY);
-                }
-            }
-            // Transition to showing result
-            Serial.println("[AIM] >>> Transitioning to PHASE_SHOW_RESULT");
-            gamePhase = PHASE_SHOW_RESULT;
-            phaseStartTime = millis();
+        // Transition locally first so we display the opponent's shot before the shooter receives the result
+        LOG(TO_OPPONENT_SHOT);
+        gamePhase = PHASE_OPPONENT_SHOT;
+        phaseStartTime = millis();
+    }
+    Message reply = makeMessage(MSG_RESULT);
+    if (wasHit) reply.result = boatSunk(boatIdx) ? RESULT_SINK : RESULT_HIT;
+    else reply.result = RESULT_MISS;
+    // Now send the reply
+    LOG(SEND_RESULT, reply.result);
+    sendMessage(reply);
+    if (!repeat) gameMoves++;
+}
+
+inline void onResultMessage(const Message &msg) {
+    logReceived(msg);
+    // An answer repeated for a shot already settled
+    if (!awaitingResult) return;
+    LOG(RESULT, msg.result);
+
+    if (aimX >= 0 && aimY >= 0) {
+        if (msg.result == RESULT_HIT) cpSet(opponentMap, aimX, aimY, CELL_HIT);
+        else if (msg.result == RESULT_MISS) cpSet(opponentMap, aimX, aimY, CELL_MISS);
+        else if (msg.result == RESULT_SINK) {
+            cpSet(opponentMap, aimX, aimY, CELL_HIT);
+            markSunkOpponentBoat(aimX, aimY);
         }
     }
+    // Transition to showing result
+    LOG(TO_SHOW_RESULT);
+    gamePhase = PHASE_SHOW_RESULT;
+    phaseStartTime = millis();
+    awaitingResult = false;
+    gameMoves++;
+}
+
+// Route incoming messages to the game; call once from setup().
+inline void registerGameHandlers() {
+    onMessage(MSG_READY, onReadyMessage);
+    onMessage(MSG_AIM, onAimMessage);
+    onMessage(MSG_SHOT, onShotMessage);
+    onMessage(MSG_RESULT, onResultMessage);
+}
+
+inline void aim(int dx, int dy, int button, IndexedFrame &frame) {
+    PROFILE_SCOPE(AIM);
+    frameFill(frame, COLOR_BLACK);
 
     // Update phase timing
     unsigned long now = millis();
     if (gamePhase == PHASE_SHOW_RESULT && (now - phaseStartTime) >= RESULT_DISPLAY_TIME_MS) {
         // After the shooter has seen the result, it's the opponent's turn next.
-        Serial.println("[PHASE] PHASE_SHOW_RESULT -> PHASE_WAIT_FOR_OPPONENT");
+        LOG(PHASE_TO_WAIT);
         gamePhase = PHASE_WAIT_FOR_OPPONENT;
     }
     if (gamePhase == PHASE_OPPONENT_SHOT && (now - phaseStartTime) >= RESULT_DISPLAY_TIME_MS) {
         // After showing the incoming shot, the receiver gets to aim/fire next.
-        Serial.println("[PHASE] PHASE_OPPONENT_SHOT -> PHASE_MY_TURN");
+        LOG(PHASE_TO_MY_TURN);
         gamePhase = PHASE_MY_TURN;
     }
 
@@ -426,60 +529,42 @@ inline void aim(int dx, int dy, int button, CRGB frame[WIDTH][HEIGHT]) {
             if (aimY >= HEIGHT) aimY = HEIGHT - 1;
         }
 #if SHOW_OPPONENT_AIM
-        if (moved && (millis() - lastAimSendTime) >= AIM_SEND_INTERVAL_MS) {
-            char aimMsg[32];
-            snprintf(aimMsg, sizeof(aimMsg), "AIM:%d,%d", aimX, aimY);
-            sendMessage(aimMsg);
-            lastAimSendTime = millis();
-        }
+        aimStreamStep(moved, aimX, aimY, now);
 #endif
         // Draw opponent map
-        for (int y = 0; y < HEIGHT; y++)
-            for (int x = 0; x < WIDTH; x++)
-                if (opponentMap[x][y] == 1) frame[x][y] = COLOR_MISS;
-                else if (opponentMap[x][y] == 2) frame[x][y] = COLOR_HIT;
-                else if (opponentMap[x][y] == 3) frame[x][y] = COLOR_SUNK;
-        frame[aimX][aimY] = COLOR_AIM;
+        drawOpponentMap(frame);
+        frameSet(frame, aimX, aimY, COLOR_AIM);
         
-        if (button == 1) {
-            char shotMsg[32];
-            snprintf(shotMsg, sizeof(shotMsg), "SHOT:%d,%d", aimX, aimY);
-                Serial.print("[SHOOT] FIRING at ");
-                Serial.println(shotMsg);
+        // A cell already shot at would only get its old answer back
+        if (button == 1 && cpGet(opponentMap, aimX, aimY) == CELL_UNKNOWN) {
+            Message shotMsg = makeMessage(MSG_SHOT);
+            shotMsg.x = aimX, shotMsg.y = aimY;
+            LOG(FIRE, aimX, aimY);
+            aimStreamReset();
             sendMessage(shotMsg);
-                Serial.println("[SHOOT] >>> Transitioning to PHASE_WAIT_FOR_OPPONENT");
+            LOG(TO_WAIT);
             gamePhase = PHASE_WAIT_FOR_OPPONENT;
+            awaitingResult = true;
+            gameMoves++;
         }
     } 
     else if (gamePhase == PHASE_OPPONENT_SHOT) {
         // Display your board showing where opponent shot
-        for (int y = 0; y < HEIGHT; y++)
-            for (int x = 0; x < WIDTH; x++)
-                if (hitMap[x][y]) {
-                    int boatIdx = boatIndexAt(x, y);
-                    frame[x][y] = (boatIdx >= 0 && boatSunk(boatIdx)) ? COLOR_SUNK : COLOR_HIT;
-                }
+        drawHitMap(frame);
     }
     else if (gamePhase == PHASE_SHOW_RESULT) {
         // Display opponent's board showing the result of their shot
-        for (int y = 0; y < HEIGHT; y++)
-            for (int x = 0; x < WIDTH; x++)
-                if (opponentMap[x][y] == 1) frame[x][y] = COLOR_MISS;
-                else if (opponentMap[x][y] == 2) frame[x][y] = COLOR_HIT;
-                else if (opponentMap[x][y] == 3) frame[x][y] = COLOR_SUNK;
+        drawOpponentMap(frame);
     }
     else if (gamePhase == PHASE_WAIT_FOR_OPPONENT) {
         // Display your board while waiting for opponent
-        frame[0][0] = COLOR_WAITING;
+        frameSet(frame, 0, 0, COLOR_WAITING);
 #if SHOW_OPPONENT_AIM
-        if (oppAimX >= 0 && oppAimY >= 0 && (millis() - oppAimTime) < OPP_AIM_TIMEOUT_MS)
-            frame[oppAimX][oppAimY] = COLOR_AIM;
+        int oppX, oppY;
+        if (aimStreamPosition(now, clockOppAimTimeoutMs(OPP_AIM_TIMEOUT_MS), oppX, oppY) &&
+            oppX >= 0 && oppX < WIDTH && oppY >= 0 && oppY < HEIGHT)
+            frameSet(frame, oppX, oppY, COLOR_AIM);
 #endif
-        for (int y = 0; y < HEIGHT; y++)
-            for (int x = 0; x < WIDTH; x++)
-                if (hitMap[x][y]) {
-                    int boatIdx = boatIndexAt(x, y);
-                    frame[x][y] = (boatIdx >= 0 && boatSunk(boatIdx)) ? COLOR_SUNK : COLOR_HIT;
-                }
+        drawHitMap(frame);
     }
 }
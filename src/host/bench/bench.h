@@ -0,0 +1,34 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Tiny benchmark registry. Each case runs its body `iters` times; the
+// runner calibrates iters, times the loop and counts heap allocations.
+
+struct BenchCase {
+  std::string name;
+  std::function<void(uint64_t iters)> run;
+};
+
+std::vector<BenchCase> &benchRegistry();
+
+inline void registerBench(const std::string &name, std::function<void(uint64_t)> run) {
+  benchRegistry().push_back({name, run});
+}
+
+// Keep the compiler from discarding a computed value.
+template <class T>
+inline void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Board presets compiled into the bench (one firmware instance each).
+void registerBoard8();
+void registerBoard10();
+void registerBoard16();
+
+#endif  // BENCH_H
@@ -0,0 +1,259 @@
+// Host microbenchmarks for the firmware hot paths, compiled at several
+// board sizes. Each case is calibrated to a fixed wall time per run and
+// reports its ns/op plus heap allocations per op.
+//
+//   bench [--filter SUBSTR] [--write FILE] [--compare FILE] [--threshold F]
+//         [--rounds N]
+//
+// --write stores the results as a baseline; --compare exits non-zero if a
+// case got more than F (default 0.4) slower than the baseline, or if it
+// allocates more than it used to. A fixed reference kernel is timed next to
+// every case and times are compared relative to it, so a baseline written on
+// one machine (or at one CPU clock) stays usable on another.
+//
+// Both modes measure the same way, so a baseline written with --write is
+// what an unchanged build measures with --compare: N rounds (default 15),
+// each a forked child that runs every case, and the fastest round kept.
+// On a shared VM many cases are bimodal, up to 1.7x apart, and which mode
+// they land in is fixed for the life of a process; more runs inside one
+// process do not help, more processes do. With the defaults, 14 compares
+// of an unchanged build on a single-vCPU VM saw case changes of +19% at
+// p99 and +28% at worst, which the 40% default covers. Use a lower
+// --threshold on a quiet machine.
+
+#include <hal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <new>
+#include <sstream>
+#include "bench.h"
+
+std::vector<BenchCase> &benchRegistry() {
+  static std::vector<BenchCase> cases;
+  return cases;
+}
+
+// Allocation counting: every operator new and malloc goes through here.
+static std::atomic<uint64_t> allocations{0};
+
+extern "C" void *__libc_malloc(size_t size);
+
+extern "C" void *malloc(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = __libc_malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// Firmware serial output is irrelevant here and would skew timings.
+struct NullText : hal::TextOutput {
+  void write(const uint8_t *, size_t) override {}
+};
+
+// Fixed workload the other cases are measured against: small table loads,
+// stores and a data-dependent branch, like the firmware's own loops.
+static const BenchCase REFERENCE = {"reference", [](uint64_t iters) {
+  static uint8_t table[256];
+  uint32_t h = 2166136261u;
+  for (uint64_t i = 0; i < iters; i++) {
+    h = (h ^ table[h & 255]) * 16777619u;
+    if (h & 0x100) table[i & 255] += (uint8_t)h;
+    doNotOptimize(h);
+  }
+}};
+
+struct Result {
+  double nsPerOp;
+  double allocsPerOp;
+  double referenceNs;  // fastest reference kernel run alongside
+};
+
+static const double TARGET_SECONDS = 0.01;
+static const int REPETITIONS = 3;
+
+static double timeRun(const BenchCase &c, uint64_t iters, uint64_t &allocs) {
+  using Clock = std::chrono::steady_clock;
+  uint64_t before = allocations.load();
+  Clock::time_point start = Clock::now();
+  c.run(iters);
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  allocs = allocations.load() - before;
+  return seconds;
+}
+
+// Iterations for one run to take about TARGET_SECONDS.
+static uint64_t calibrate(const BenchCase &c) {
+  uint64_t iters = 1, allocs;
+  for (;;) {
+    double seconds = timeRun(c, iters, allocs);
+    if (seconds >= TARGET_SECONDS || iters >= (1ULL << 36)) return iters;
+    double scale = seconds > 1e-4 ? TARGET_SECONDS * 1.2 / seconds : 10.0;
+    iters = (uint64_t)(iters * (scale < 10.0 ? scale : 10.0)) + 1;
+  }
+}
+
+// Alternate reference and case runs and keep the fastest of each: noise on
+// a shared host only ever adds time, and slow phases hit both alike.
+static Result runCase(const BenchCase &c, uint64_t iters, uint64_t referenceIters) {
+  Result best = {1e300, 0, 1e300};
+  for (int i = 0; i < REPETITIONS; i++) {
+    uint64_t allocs;
+    double ref = timeRun(REFERENCE, referenceIters, allocs) * 1e9 / referenceIters;
+    double ns = timeRun(c, iters, allocs) * 1e9 / iters;
+    if (ref < best.referenceNs) best.referenceNs = ref;
+    if (ns < best.nsPerOp) best.nsPerOp = ns;
+    if ((double)allocs / iters > best.allocsPerOp) best.allocsPerOp = (double)allocs / iters;
+  }
+  return best;
+}
+
+// One round of every case, run in a child process: repeated rounds in one
+// process agree, while separate processes put a case up to 60% apart, so
+// each round gets a process of its own. Returns false if the child failed.
+static bool runRound(const std::vector<const BenchCase *> &cases, const std::vector<uint64_t> &iters,
+                     uint64_t referenceIters, std::vector<std::vector<Result>> &rounds) {
+  int fds[2];
+  if (pipe(fds) < 0) return false;
+  pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    close(fds[0]);
+    for (size_t i = 0; i < cases.size(); i++) {
+      Result r = runCase(*cases[i], iters[i], referenceIters);
+      if (write(fds[1], &r, sizeof(r)) != (ssize_t)sizeof(r)) _exit(1);
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  size_t got = 0;
+  Result r;
+  while (got < cases.size() && read(fds[0], &r, sizeof(r)) == (ssize_t)sizeof(r)) rounds[got++].push_back(r);
+  close(fds[0]);
+  int status;
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && got == cases.size();
+}
+
+// The fastest round relative to the reference; the most allocations any
+// round saw.
+static Result bestRound(const std::vector<Result> &rounds) {
+  Result r = rounds[0];
+  for (const Result &x : rounds) {
+    if (x.nsPerOp / x.referenceNs < r.nsPerOp / r.referenceNs) r.nsPerOp = x.nsPerOp, r.referenceNs = x.referenceNs;
+    if (x.allocsPerOp > r.allocsPerOp) r.allocsPerOp = x.allocsPerOp;
+  }
+  return r;
+}
+
+// Baseline lines are "<name> <ns/op relative to reference> <allocs/op>".
+static std::map<std::string, Result> loadBaseline(const char *path) {
+  std::map<std::string, Result> out;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream fields(line);
+    std::string name;
+    Result r = {0, 0, 1};
+    if (fields >> name >> r.nsPerOp >> r.allocsPerOp) out[name] = r;
+  }
+  return out;
+}
+
+int main(int argc, char **argv) {
+  const char *filter = nullptr, *writePath = nullptr, *comparePath = nullptr;
+  double threshold = 0.4;
+  int roundCount = 15;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "--filter" && more) filter = argv[++i];
+    else if (a == "--write" && more) writePath = argv[++i];
+    else if (a == "--compare" && more) comparePath = argv[++i];
+    else if (a == "--threshold" && more) threshold = atof(argv[++i]);
+    else if (a == "--rounds" && more && atoi(argv[i + 1]) > 0) roundCount = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--filter SUBSTR] [--write FILE] [--compare FILE] [--threshold F] [--rounds N]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  static hal::Board board = hal::defaultBoard();
+  static NullText quiet;
+  board.serial = &quiet;
+  hal::setActive(&board);
+
+  registerBoard8();
+  registerBoard10();
+  registerBoard16();
+
+  std::map<std::string, Result> baseline;
+  if (comparePath) baseline = loadBaseline(comparePath);
+
+  FILE *out = nullptr;
+  if (writePath) {
+    out = fopen(writePath, "w");
+    if (!out) {
+      perror(writePath);
+      return 2;
+    }
+    fprintf(out, "# name ns/op-relative-to-reference allocs/op\n");
+  }
+
+  std::vector<const BenchCase *> cases;
+  for (const BenchCase &c : benchRegistry())
+    if (!filter || c.name.find(filter) != std::string::npos) cases.push_back(&c);
+  uint64_t referenceIters = calibrate(REFERENCE);
+  std::vector<uint64_t> iters;
+  for (const BenchCase *c : cases) iters.push_back(calibrate(*c));
+  std::vector<std::vector<Result>> rounds(cases.size());
+  for (int round = 0; round < roundCount; round++) {
+    if (!runRound(cases, iters, referenceIters, rounds)) {
+      fprintf(stderr, "bench: round %d failed\n", round + 1);
+      return 2;
+    }
+  }
+
+  int regressions = 0;
+  printf("%-44s %10s %10s %s\n", "case", "ns/op", "allocs/op", comparePath ? "vs baseline" : "");
+  for (size_t i = 0; i < cases.size(); i++) {
+    const BenchCase &c = *cases[i];
+    Result r = bestRound(rounds[i]);
+    double relative = r.nsPerOp / r.referenceNs;
+    printf("%-44s %10.2f %10.3f", c.name.c_str(), r.nsPerOp, r.allocsPerOp);
+    if (out) fprintf(out, "%s %.4f %.3f\n", c.name.c_str(), relative, r.allocsPerOp);
+    auto it = baseline.find(c.name);
+    if (it != baseline.end()) {
+      const Result &b = it->second;
+      double expectedNs = b.nsPerOp * r.referenceNs;
+      double change = b.nsPerOp > 0 ? relative / b.nsPerOp - 1.0 : 0.0;
+      // Sub-nanosecond cases are noise-dominated; allow 1 ns of slack
+      bool slower = change > threshold && r.nsPerOp - expectedNs > 1.0;
+      bool allocs = r.allocsPerOp > b.allocsPerOp + 1e-6;
+      printf("  %+6.1f%%%s%s", change * 100, slower ? "  SLOWER" : "", allocs ? "  ALLOCS" : "");
+      if (slower || allocs) regressions++;
+    } else if (comparePath) {
+      printf("  (new)");
+    }
+    printf("\n");
+  }
+  if (out) fclose(out);
+  if (comparePath) {
+    printf("%d regression(s) against %s\n", regressions, comparePath);
+    return regressions ? 1 : 0;
+  }
+  return 0;
+}
@@ -0,0 +1,6 @@
+// Firmware hot paths with the 10x10 preset.
+#define BENCH_NAMESPACE bench_10
+#define BENCH_PRESET PRESET_CLASSIC
+#define BENCH_NAME "10x10/classic"
+#define BENCH_REGISTER registerBoard10
+#include "bench_instance.inc"
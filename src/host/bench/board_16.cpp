@@ -0,0 +1,7 @@
+// Firmware hot paths with the 16x16 preset.
+#define BENCH_NAMESPACE bench_16
+#define BENCH_PRESET PRESET_16X16
+#define BENCH_NAME "16x16/default"
+#define BENCH_REGISTER registerBoard16
+#define BENCH_PROTOCOL
+#include "bench_instance.inc"
@@ -0,0 +1,6 @@
+// Firmware hot paths with the 8x8 preset.
+#define BENCH_NAMESPACE bench_8
+#define BENCH_PRESET PRESET_QUICK
+#define BENCH_NAME "8x8/quick"
+#define BENCH_REGISTER registerBoard8
+#include "bench_instance.inc"
@@ -0,0 +1,115 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Minimal Arduino core for host builds, backed by hal::active().
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+#include "hal.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define F(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p) (*(const void *const *)(p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strncpy_P strncpy
+
+inline unsigned long micros() { return (unsigned long)(uint32_t)hal::active().clock->micros64(); }
+inline unsigned long millis() { return (unsigned long)(uint32_t)(hal::active().clock->micros64() / 1000); }
+inline void delay(unsigned long ms) { hal::active().clock->sleepUs((uint32_t)(ms * 1000)); }
+inline void delayMicroseconds(unsigned int us) { hal::active().clock->sleepUs(us); }
+
+inline int analogRead(uint8_t pin) { return hal::active().analog->read(pin); }
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+template <class T, class U>
+inline typename std::common_type<T, U>::type max(T a, U b) { return a > b ? a : b; }
+template <class T, class U>
+inline typename std::common_type<T, U>::type min(T a, U b) { return a < b ? a : b; }
+template <class T, class L, class H>
+inline T constrain(T v, L lo, H hi) { return v < lo ? lo : v > hi ? hi : v; }
+
+class Print;
+
+class Printable {
+ public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(const uint8_t *buf, size_t n) = 0;
+  size_t write(uint8_t c) { return write(&c, 1); }
+
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(long v, int base = DEC) { return printf(base == HEX ? "%lx" : "%ld", v); }
+  size_t print(unsigned long v, int base = DEC) { return printf(base == HEX ? "%lx" : "%lu", v); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+  size_t print(const Printable &p) { return p.printTo(*this); }
+
+  size_t println() { return print("\r\n"); }
+  template <class T>
+  size_t println(const T &v) { return print(v) + println(); }
+  template <class T>
+  size_t println(const T &v, int fmt) { return print(v, fmt) + println(); }
+
+ private:
+  template <class... Args>
+  size_t printf(const char *fmt, Args... args) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), fmt, args...);
+    return write((const uint8_t *)buf, n < 0 ? 0 : (size_t)n);
+  }
+};
+
+class HardwareSerial : public Print {
+ public:
+  void begin(unsigned long) {}
+  explicit operator bool() const { return true; }
+  int availableForWrite() { return 64; }
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush() {}
+  using Print::write;
+  size_t write(const uint8_t *buf, size_t n) override {
+    hal::active().serial->write(buf, n);
+    return n;
+  }
+};
+
+inline HardwareSerial Serial;
+
+#endif  // ARDUINO_H
@@ -0,0 +1,36 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+// Arduino EEPROM library over the active board's cells (hal::Board::eeprom),
+// which start erased at every run.
+
+#include <Arduino.h>
+
+class EEPROMClass {
+ public:
+  uint8_t read(int idx) { return cells()[idx]; }
+  void write(int idx, uint8_t val) { cells()[idx] = val; }
+  void update(int idx, uint8_t val) {
+    if (cells()[idx] != val) write(idx, val);
+  }
+  uint16_t length() { return hal::EEPROM_BYTES; }
+
+  template <typename T>
+  T &get(int idx, T &t) {
+    memcpy(&t, cells() + idx, sizeof(T));
+    return t;
+  }
+  template <typename T>
+  const T &put(int idx, const T &t) {
+    const uint8_t *p = (const uint8_t *)&t;
+    for (size_t i = 0; i < sizeof(T); i++) update(idx + (int)i, p[i]);
+    return t;
+  }
+
+ private:
+  static uint8_t *cells() { return hal::active().eeprom.bytes; }
+};
+
+inline EEPROMClass EEPROM;
+
+#endif  // EEPROM_H
@@ -0,0 +1,63 @@
+#ifndef FASTLED_H
+#define FASTLED_H
+
+// FastLED subset used by the firmware; show() hands the pixel buffer to
+// the active board's LED output.
+
+#include <Arduino.h>
+
+struct CRGB {
+  uint8_t r, g, b;
+
+  enum HTMLColorCode : uint32_t {
+    Black = 0x000000,
+    Blue = 0x0000FF,
+    Green = 0x008000,
+    Orange = 0xFFA500,
+    Purple = 0x800080,
+    Red = 0xFF0000,
+    White = 0xFFFFFF,
+    Yellow = 0xFFFF00,
+  };
+
+  CRGB() : r(0), g(0), b(0) {}
+  CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  CRGB(uint32_t code) : r((uint8_t)(code >> 16)), g((uint8_t)(code >> 8)), b((uint8_t)code) {}
+  CRGB(HTMLColorCode code) : CRGB((uint32_t)code) {}
+
+  bool operator==(const CRGB &o) const { return r == o.r && g == o.g && b == o.b; }
+  bool operator!=(const CRGB &o) const { return !(*this == o); }
+};
+
+enum EOrder { RGB = 0012, GRB = 0102 };
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER = GRB>
+class WS2812B {};
+
+class CFastLED {
+ public:
+  template <template <uint8_t, EOrder> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+  CFastLED &addLeds(CRGB *data, int count) {
+    hal::Board &board = hal::active();
+    board.ledBuffer = (uint8_t *)data;
+    board.ledCount = count;
+    return *this;
+  }
+  void setBrightness(uint8_t scale) { hal::active().brightness = scale; }
+  uint8_t getBrightness() { return hal::active().brightness; }
+  void clear(bool writeData = false) {
+    hal::Board &board = hal::active();
+    if (board.ledBuffer) memset(board.ledBuffer, 0, board.ledCount * sizeof(CRGB));
+    if (writeData) show();
+  }
+  void show() {
+    hal::Board &board = hal::active();
+    if (board.ledBuffer) board.leds->show(board.ledBuffer, board.ledCount, board.brightness);
+  }
+};
+
+static_assert(sizeof(CRGB) == 3, "CRGB must be packed RGB");
+
+inline CFastLED FastLED;
+
+#endif  // FASTLED_H
@@ -0,0 +1,40 @@
+#ifndef IPADDRESS_H
+#define IPADDRESS_H
+
+#include <Arduino.h>
+
+class IPAddress : public Printable {
+ public:
+  IPAddress() : IPAddress(0, 0, 0, 0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    bytes[0] = a;
+    bytes[1] = b;
+    bytes[2] = c;
+    bytes[3] = d;
+  }
+  // Address in network byte order, as stored by the Arduino core
+  IPAddress(uint32_t raw) { memcpy(bytes, &raw, 4); }
+  operator uint32_t() const {
+    uint32_t raw;
+    memcpy(&raw, bytes, 4);
+    return raw;
+  }
+  uint8_t operator[](int i) const { return bytes[i]; }
+  uint8_t &operator[](int i) { return bytes[i]; }
+  bool operator==(const IPAddress &o) const { return memcmp(bytes, o.bytes, 4) == 0; }
+  bool operator!=(const IPAddress &o) const { return !(*this == o); }
+
+  size_t printTo(Print &p) const override {
+    size_t n = 0;
+    for (int i = 0; i < 4; i++) {
+      if (i) n += p.print('.');
+      n += p.print(bytes[i]);
+    }
+    return n;
+  }
+
+ private:
+  uint8_t bytes[4];
+};
+
+#endif  // IPADDRESS_H
@@ -0,0 +1,51 @@
+#ifndef WIFININA_H
+#define WIFININA_H
+
+// WiFiNINA subset: association state comes from the active board's
+// datagram I/O.
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <WiFiUdp.h>
+
+enum wl_status_t {
+  WL_NO_SHIELD = 255,
+  WL_NO_MODULE = WL_NO_SHIELD,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL,
+  WL_SCAN_COMPLETED,
+  WL_CONNECTED,
+  WL_CONNECT_FAILED,
+  WL_CONNECTION_LOST,
+  WL_DISCONNECTED,
+};
+
+class WiFiClass {
+ public:
+  int begin(const char *, const char *) { return status(); }
+  void setTimeout(unsigned long) {}
+  void disconnect() {}
+  void end() {}
+  void config(IPAddress, IPAddress, IPAddress, IPAddress) {}
+  uint8_t status() { return hal::active().net->linkUp() ? WL_CONNECTED : WL_IDLE_STATUS; }
+  IPAddress localIP() { return IPAddress(hal::active().net->localIp()); }
+  IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+  IPAddress gatewayIP() { return IPAddress(localIP()[0], localIP()[1], localIP()[2], 1); }
+  uint8_t *BSSID(uint8_t *bssid) {
+    memset(bssid, 0, 6);
+    return bssid;
+  }
+  // Made up from the address, so every simulated board has its own
+  uint8_t *macAddress(uint8_t *mac) {
+    uint32_t ip = hal::active().net->localIp();
+    mac[0] = 0x02, mac[1] = 0;
+    memcpy(mac + 2, &ip, 4);
+    return mac;
+  }
+  int32_t RSSI() { return -50; }
+  uint8_t channel() { return 6; }
+};
+
+inline WiFiClass WiFi;
+
+#endif  // WIFININA_H
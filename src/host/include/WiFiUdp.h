@@ -0,0 +1,60 @@
+#ifndef WIFIUDP_H
+#define WIFIUDP_H
+
+// WiFiUDP over the active board's datagram I/O.
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+class WiFiUDP {
+ public:
+  uint8_t begin(uint16_t port) { return hal::active().net->bind(port) ? 1 : 0; }
+  void stop() {}
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    txIp = ip;
+    txPort = port;
+    txLen = 0;
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t len) {
+    if (len > sizeof(tx) - txLen) len = sizeof(tx) - txLen;
+    memcpy(tx + txLen, data, len);
+    txLen += len;
+    return len;
+  }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  int endPacket() { return hal::active().net->send(txIp, txPort, tx, txLen) ? 1 : 0; }
+
+  int parsePacket() {
+    uint32_t ip = 0;
+    int len = hal::active().net->receive(rx, sizeof(rx), ip, rxPort);
+    rxIp = ip;
+    rxLen = len > 0 ? len : 0;
+    rxPos = 0;
+    return rxLen;
+  }
+  int available() { return rxLen - rxPos; }
+  int read() { return rxPos < rxLen ? rx[rxPos++] : -1; }
+  int read(unsigned char *buf, size_t len) {
+    size_t n = (size_t)available() < len ? (size_t)available() : len;
+    memcpy(buf, rx + rxPos, n);
+    rxPos += n;
+    return (int)n;
+  }
+  int read(char *buf, size_t len) { return read((unsigned char *)buf, len); }
+  IPAddress remoteIP() { return IPAddress(rxIp); }
+  uint16_t remotePort() { return rxPort; }
+
+ private:
+  uint8_t tx[512];
+  size_t txLen = 0;
+  uint32_t txIp = 0;
+  uint16_t txPort = 0;
+  uint8_t rx[512];
+  int rxLen = 0, rxPos = 0;
+  uint32_t rxIp = 0;
+  uint16_t rxPort = 0;
+};
+
+#endif  // WIFIUDP_H
@@ -0,0 +1,8 @@
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+// Host builds associate with the simulated network; any non-empty SSID works.
+#define WIFI_SSID "native"
+#define WIFI_PASSWORD ""
+
+#endif  // CREDENTIALS_H
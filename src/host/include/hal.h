@@ -0,0 +1,126 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+// Host-side hardware abstraction. The mock Arduino, FastLED and WiFiNINA
+// headers in this directory forward to whichever hal::Board is active, so
+// several firmware instances can share one process: the simulator makes a
+// board active before calling its setup()/loop().
+namespace hal {
+
+struct Clock {
+  virtual ~Clock() {}
+  virtual uint64_t micros64() = 0;
+  virtual void sleepUs(uint32_t us) = 0;
+};
+
+struct LedOutput {
+  virtual ~LedOutput() {}
+  // rgb holds count pixels, three bytes each
+  virtual void show(const uint8_t *rgb, int count, uint8_t brightness) = 0;
+};
+
+struct AnalogInput {
+  virtual ~AnalogInput() {}
+  virtual int read(uint8_t pin) = 0;
+};
+
+struct DatagramIO {
+  virtual ~DatagramIO() {}
+  virtual bool linkUp() = 0;
+  virtual uint32_t localIp() = 0;
+  virtual bool bind(uint16_t port) = 0;
+  virtual bool send(uint32_t ip, uint16_t port, const uint8_t *data, size_t len) = 0;
+  // Pop the next datagram into buf. Returns its length, or -1 if none.
+  virtual int receive(uint8_t *buf, size_t cap, uint32_t &fromIp, uint16_t &fromPort) = 0;
+};
+
+struct TextOutput {
+  virtual ~TextOutput() {}
+  virtual void write(const uint8_t *data, size_t len) = 0;
+};
+
+// The ATmega4809's EEPROM, erased (all 0xFF) as a new part's is.
+static const uint16_t EEPROM_BYTES = 256;
+
+struct EepromCells {
+  uint8_t bytes[EEPROM_BYTES];
+  EepromCells() { memset(bytes, 0xFF, sizeof(bytes)); }
+};
+
+struct Board {
+  Clock *clock;
+  LedOutput *leds;
+  AnalogInput *analog;
+  DatagramIO *net;
+  TextOutput *serial;
+  // Filled in by FastLED.addLeds()
+  uint8_t *ledBuffer = nullptr;
+  int ledCount = 0;
+  uint8_t brightness = 255;
+  // Backs EEPROM.h
+  EepromCells eeprom{};
+};
+
+// Backends for the board used when nothing else is active: wall clock,
+// centred joystick, no network, LEDs discarded, serial to stdout.
+struct WallClock : Clock {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  uint64_t micros64() override {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start).count();
+  }
+  void sleepUs(uint32_t us) override { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+};
+
+struct NullLeds : LedOutput {
+  void show(const uint8_t *, int, uint8_t) override {}
+};
+
+struct CentredStick : AnalogInput {
+  int read(uint8_t) override { return 512; }
+};
+
+struct NoNetwork : DatagramIO {
+  bool linkUp() override { return false; }
+  uint32_t localIp() override { return 0; }
+  bool bind(uint16_t) override { return false; }
+  bool send(uint32_t, uint16_t, const uint8_t *, size_t) override { return false; }
+  int receive(uint8_t *, size_t, uint32_t &, uint16_t &) override { return -1; }
+};
+
+struct StdoutText : TextOutput {
+  void write(const uint8_t *data, size_t len) override { fwrite(data, 1, len, stdout); }
+};
+
+inline Board &defaultBoard() {
+  static WallClock clock;
+  static NullLeds leds;
+  static CentredStick analog;
+  static NoNetwork net;
+  static StdoutText serial;
+  static Board board{&clock, &leds, &analog, &net, &serial};
+  return board;
+}
+
+inline Board *&activeSlot() {
+  static Board *board = nullptr;
+  return board;
+}
+
+inline Board &active() {
+  Board *b = activeSlot();
+  return b ? *b : defaultBoard();
+}
+
+inline void setActive(Board *board) { activeSlot() = board; }
+
+}  // namespace hal
+
+#endif  // HAL_H
@@ -0,0 +1,65 @@
+#ifndef LOSSY_CHANNEL_H
+#define LOSSY_CHANNEL_H
+
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+// One direction of a simulated datagram link. Packets are dropped,
+// duplicated, delayed with jitter and occasionally held back so they
+// arrive out of order. Time is driven by the caller in milliseconds.
+struct LossyChannel {
+  struct Packet {
+    uint32_t deliverAt;
+    std::vector<uint8_t> data;
+  };
+
+  double loss = 0.0;       // drop probability
+  double duplicate = 0.0;  // probability of delivering a second copy
+  double reorder = 0.0;    // probability of an extra holdback delay
+  uint32_t delayMin = 5;
+  uint32_t delayMax = 20;
+  uint32_t reorderDelay = 40;
+
+  std::mt19937 rng;
+  std::vector<Packet> inFlight;
+  uint32_t sent = 0, dropped = 0, duplicated = 0;
+
+  explicit LossyChannel(uint32_t seed) : rng(seed) {}
+
+  bool chance(double p) {
+    return p > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < p;
+  }
+
+  uint32_t latency() {
+    uint32_t d = std::uniform_int_distribution<uint32_t>(delayMin, delayMax)(rng);
+    if (chance(reorder)) d += reorderDelay;
+    return d;
+  }
+
+  void send(const uint8_t *data, uint8_t len, uint32_t now) {
+    sent++;
+    if (chance(loss)) {
+      dropped++;
+      return;
+    }
+    inFlight.push_back({now + latency(), std::vector<uint8_t>(data, data + len)});
+    if (chance(duplicate)) {
+      duplicated++;
+      inFlight.push_back({now + latency(), std::vector<uint8_t>(data, data + len)});
+    }
+  }
+
+  // Pop one packet due at or before now. Returns false if none is due.
+  bool receive(uint32_t now, std::vector<uint8_t> &out) {
+    for (size_t i = 0; i < inFlight.size(); i++) {
+      if ((int32_t)(now - inFlight[i].deliverAt) < 0) continue;
+      out.swap(inFlight[i].data);
+      inFlight.erase(inFlight.begin() + i);
+      return true;
+    }
+    return false;
+  }
+};
+
+#endif // LOSSY_CHANNEL_H
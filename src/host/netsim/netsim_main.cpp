@@ -0,0 +1,139 @@
+// Measures SHOT -> RESULT turn latency of the reliable link over a lossy,
+// jittery, reordering channel at 0-30% packet loss.
+//
+//   netsim [--turns N] [--seed S] [--delay MIN:MAX] [--reorder P] [--dup P]
+//          [--aim N]
+//
+// Before each SHOT the shooter sends N AIM updates (default 150), as a
+// player moving the cursor does: unreliable traffic between reliable
+// sends must not push those out of the receiver's window.
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../../reliable.h"
+#include "lossy_channel.h"
+
+static const uint32_t STUCK_TURN_MS = 30000;
+
+struct Endpoint {
+  ReliableLink link;
+  LossyChannel *out;
+};
+
+static Endpoint boardA, boardB;
+static uint32_t simNow = 0;
+
+static void sendFromA(const uint8_t *data, uint8_t len) { boardA.out->send(data, len, simNow); }
+static void sendFromB(const uint8_t *data, uint8_t len) { boardB.out->send(data, len, simNow); }
+
+struct LossResult {
+  std::vector<uint32_t> latencies;
+  uint32_t stuck = 0, duplicateShots = 0, retransmits = 0, dupDropped = 0;
+};
+
+static uint32_t percentile(std::vector<uint32_t> &v, double p) {
+  if (v.empty()) return 0;
+  size_t i = (size_t)(p * (v.size() - 1));
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return v[i];
+}
+
+static LossResult runTurns(int turns, double loss, const LossyChannel &shape, int aims, uint32_t seed) {
+  LossyChannel ab(seed), ba(seed ^ 0x9e3779b9u);
+  for (LossyChannel *c : {&ab, &ba}) {
+    c->loss = loss;
+    c->duplicate = shape.duplicate;
+    c->reorder = shape.reorder;
+    c->delayMin = shape.delayMin;
+    c->delayMax = shape.delayMax;
+  }
+  simNow = 0;
+  boardA.out = &ab;
+  boardB.out = &ba;
+  rlInit(boardA.link, sendFromA);
+  rlInit(boardB.link, sendFromB);
+
+  LossResult r;
+  Endpoint *shooter = &boardA, *target = &boardB;
+  LossyChannel *toTarget = &ab, *toShooter = &ba;
+  for (int t = 0; t < turns; t++) {
+    Message shot = makeMessage(MSG_SHOT);
+    shot.x = (uint8_t)(t % 16), shot.y = (uint8_t)(t / 16 % 16);
+    for (int i = 0; i < aims; i++) {
+      Message aim = makeMessage(MSG_AIM);
+      aim.x = (uint8_t)(i % 16), aim.y = shot.y;
+      rlSend(shooter->link, aim, simNow);
+    }
+    uint32_t start = simNow;
+    rlSend(shooter->link, shot, simNow);
+    int shotsDelivered = 0;
+    bool done = false;
+    std::vector<uint8_t> pkt;
+    Message msg;
+    while (!done && simNow - start < STUCK_TURN_MS) {
+      simNow++;
+      while (toTarget->receive(simNow, pkt)) {
+        if (!decodeMessage(pkt.data(), (int)pkt.size(), msg) || !rlReceive(target->link, msg, simNow)) continue;
+        do {
+          if (msg.type != MSG_SHOT) continue;
+          shotsDelivered++;
+          Message result = makeMessage(MSG_RESULT);
+          result.result = RESULT_MISS;
+          rlSend(target->link, result, simNow);
+        } while (rlNextHeld(target->link, msg));
+      }
+      while (toShooter->receive(simNow, pkt)) {
+        if (!decodeMessage(pkt.data(), (int)pkt.size(), msg) || !rlReceive(shooter->link, msg, simNow)) continue;
+        do {
+          if (msg.type == MSG_RESULT) done = true;
+        } while (rlNextHeld(shooter->link, msg));
+      }
+      rlPoll(shooter->link, simNow);
+      rlPoll(target->link, simNow);
+    }
+    if (done) r.latencies.push_back(simNow - start);
+    else r.stuck++;
+    if (shotsDelivered > 1) r.duplicateShots++;
+    std::swap(shooter, target);
+    std::swap(toTarget, toShooter);
+  }
+  r.retransmits = boardA.link.stats.retransmits + boardB.link.stats.retransmits;
+  r.dupDropped = boardA.link.stats.duplicates + boardB.link.stats.duplicates;
+  return r;
+}
+
+int main(int argc, char **argv) {
+  int turns = 2000, aims = 150;
+  uint32_t seed = 1;
+  LossyChannel shape(0);
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--turns")) turns = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--seed")) seed = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    else if (!strcmp(argv[i], "--delay")) sscanf(argv[i + 1], "%u:%u", &shape.delayMin, &shape.delayMax);
+    else if (!strcmp(argv[i], "--reorder")) shape.reorder = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--dup")) shape.duplicate = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--aim")) aims = atoi(argv[i + 1]);
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  printf("turns=%d delay=%u..%ums reorder=%.2f dup=%.2f aim=%d\n", turns, shape.delayMin, shape.delayMax,
+         shape.reorder, shape.duplicate, aims);
+  printf("loss%%   mean   p50   p90   p99    max  retx/turn  dupDropped  dupShots  stuck\n");
+  for (int pct = 0; pct <= 30; pct += 5) {
+    LossResult r = runTurns(turns, pct / 100.0, shape, aims, seed + pct);
+    double mean = 0;
+    for (uint32_t l : r.latencies) mean += l;
+    if (!r.latencies.empty()) mean /= r.latencies.size();
+    uint32_t maxLat = r.latencies.empty() ? 0 : *std::max_element(r.latencies.begin(), r.latencies.end());
+    printf("%4d  %6.1f %5u %5u %5u %6u  %9.2f  %10u  %8u  %5u\n", pct, mean, percentile(r.latencies, 0.5),
+           percentile(r.latencies, 0.9), percentile(r.latencies, 0.99), maxLat, (double)r.retransmits / turns,
+           r.dupDropped, r.duplicateShots, r.stuck);
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+#ifndef FLAT_TABLE_H
+#define FLAT_TABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+// Open-addressed hash map from nonzero 64-bit keys to small values, in one
+// flat array: linear probing, a power-of-two capacity kept at most 3/4
+// full (it doubles when needed), and backward-shift deletion so there are
+// no tombstones and lookups stay short however many entries come and go.
+// Key 0 marks an empty slot. Not thread-safe.
+template <typename V>
+class FlatTable {
+ public:
+  struct Slot {
+    uint64_t key;
+    V value;
+  };
+
+  explicit FlatTable(size_t capacity = 64) {
+    size_t n = 16;
+    while (n < capacity * 4 / 3 + 1) n <<= 1;
+    slots_.assign(n, Slot{0, V()});
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return slots_.size(); }
+
+  V *find(uint64_t key) {
+    for (size_t i = home(key);; i = next(i)) {
+      if (slots_[i].key == key) return &slots_[i].value;
+      if (!slots_[i].key) return nullptr;
+    }
+  }
+
+  // The value for key, default-constructed if it was not there.
+  V &insert(uint64_t key) {
+    if ((size_ + 1) * 4 > slots_.size() * 3) grow();
+    size_t i = home(key);
+    for (; slots_[i].key; i = next(i))
+      if (slots_[i].key == key) return slots_[i].value;
+    slots_[i].key = key;
+    slots_[i].value = V();
+    size_++;
+    return slots_[i].value;
+  }
+
+  bool erase(uint64_t key) {
+    size_t i = home(key);
+    for (; slots_[i].key != key; i = next(i))
+      if (!slots_[i].key) return false;
+    // Pull later entries of the probe run back into the hole, unless that
+    // would move one before its home slot
+    for (size_t j = next(i);; j = next(j)) {
+      if (!slots_[j].key) break;
+      size_t h = home(slots_[j].key);
+      bool movable = i <= j ? (h <= i || h > j) : (h <= i && h > j);
+      if (movable) {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i].key = 0;
+    size_--;
+    return true;
+  }
+
+  // Calls fn(key, value) for every entry. fn must not insert or erase.
+  template <typename F>
+  void forEach(F fn) {
+    for (Slot &s : slots_)
+      if (s.key) fn(s.key, s.value);
+  }
+
+  static uint64_t hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    return key ^ (key >> 33);
+  }
+
+ private:
+  std::vector<Slot> slots_;
+  size_t size_ = 0;
+
+  size_t home(uint64_t key) const { return hash(key) & (slots_.size() - 1); }
+  size_t next(size_t i) const { return (i + 1) & (slots_.size() - 1); }
+
+  void grow() {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.assign(old.size() * 2, Slot{0, V()});
+    size_ = 0;
+    for (Slot &s : old)
+      if (s.key) insert(s.key) = s.value;
+  }
+};
+
+#endif  // FLAT_TABLE_H
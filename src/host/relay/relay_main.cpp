@@ -0,0 +1,596 @@
+// UDP relay and matchmaking server for boards built with USE_RELAY (Linux).
+//
+//   relay [--port N] [--shards N] [--max-sessions N] [--idle S]
+//         [--metrics FILE] [--interval S] [--duration S] [--quiet]
+//
+// A board registers with a HELLO for its table number (RELAY_TABLE in
+// config.h). The first board of a table waits in the lobby; the second is
+// paired with it, and from then on every datagram either board sends is
+// forwarded unchanged to the other. A HELLO is answered with the table's
+// state and the board's role (0 = registered first), which the boards use
+// to break a placement tie. A board silent for --idle seconds is dropped;
+// its partner's traffic is then answered with HELLO/waiting so that it
+// registers again.
+//
+// --shards sockets are bound to the port with SO_REUSEPORT, each served by
+// its own thread: an epoll loop reading and writing in recvmmsg/sendmmsg
+// batches. The kernel hashes each board's address to one socket, so a
+// shard alone owns the endpoint table of the boards it hears from and only
+// pairing takes a lock. Sessions live in one shared array; each side's
+// counters are written only by the shard of that side.
+//
+// Per session the relay times the leg from itself to each board and back:
+// PING forwarded -> that board's PONG (network round trip) and SHOT
+// forwarded -> its RESULT (a turn answered). --metrics rewrites FILE every
+// --interval seconds in Prometheus text format (e.g. for node_exporter's
+// textfile collector); a summary line goes to stdout.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../protocol.h"
+#include "flat_table.h"
+
+static const int BATCH = 64;
+static const int MAX_DATAGRAM = 512;
+static const int HIST_BUCKETS = 24;  // bucket b: [2^(b-1), 2^b) us, the last one open
+
+struct Options {
+  uint16_t port = 9999;
+  unsigned shards = 1;
+  uint32_t maxSessions = 16384;
+  uint32_t idleSec = 30;
+  const char *metricsPath = nullptr;
+  uint32_t intervalSec = 10;
+  uint32_t durationSec = 0;  // 0 = until interrupted
+  bool quiet = false;
+};
+
+static uint64_t monoUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// A board's address as a table key: IPv4 address and port, never 0.
+static uint64_t endpointKey(const sockaddr_in &a) {
+  return (uint64_t)ntohl(a.sin_addr.s_addr) << 16 | ntohs(a.sin_port);
+}
+
+static sockaddr_in endpointAddr(uint64_t key) {
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl((uint32_t)(key >> 16));
+  a.sin_port = htons((uint16_t)key);
+  return a;
+}
+
+static std::string endpointText(uint64_t key) {
+  char buf[32];
+  uint32_t ip = (uint32_t)(key >> 16);
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u:%u", ip >> 24, (ip >> 16) & 255, (ip >> 8) & 255, ip & 255,
+           (unsigned)(key & 0xFFFF));
+  return buf;
+}
+
+struct Histogram {
+  std::atomic<uint32_t> counts[HIST_BUCKETS];
+  std::atomic<uint32_t> maxUs;
+
+  void clear() {
+    for (auto &c : counts) c.store(0, std::memory_order_relaxed);
+    maxUs.store(0, std::memory_order_relaxed);
+  }
+
+  void record(uint64_t us) {
+    int b = 0;
+    for (uint64_t v = us; v && b < HIST_BUCKETS - 1; v >>= 1) b++;
+    counts[b].fetch_add(1, std::memory_order_relaxed);
+    uint32_t v = us > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)us;
+    if (v > maxUs.load(std::memory_order_relaxed)) maxUs.store(v, std::memory_order_relaxed);
+  }
+
+  uint64_t total() const {
+    uint64_t n = 0;
+    for (auto &c : counts) n += c.load(std::memory_order_relaxed);
+    return n;
+  }
+
+  // Upper bound of the bucket holding the q-quantile
+  uint64_t quantile(double q) const {
+    uint64_t want = (uint64_t)(q * total() + 0.5), seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+      seen += counts[b].load(std::memory_order_relaxed);
+      if (seen && seen >= want) return b == HIST_BUCKETS - 1 ? maxUs.load(std::memory_order_relaxed) : 1ULL << b;
+    }
+    return 0;
+  }
+
+  void addTo(uint64_t *into) const {
+    for (int b = 0; b < HIST_BUCKETS; b++) into[b] += counts[b].load(std::memory_order_relaxed);
+  }
+};
+
+// One board of a session. Written only by the shard that hears from it,
+// apart from pingAtUs/shotAtUs, which the other board's shard sets.
+struct Side {
+  std::atomic<uint64_t> endpoint;  // 0 = gone
+  std::atomic<uint64_t> packets, bytes, dropped;
+  std::atomic<uint64_t> pingAtUs, shotAtUs;  // forwarded to this board, answer pending
+  Histogram rtt, turn;
+
+  void clear() {
+    endpoint = packets = bytes = dropped = pingAtUs = shotAtUs = 0;
+    rtt.clear();
+    turn.clear();
+  }
+};
+
+enum SessionState : uint8_t { SESSION_FREE, SESSION_WAITING, SESSION_PAIRED, SESSION_BROKEN };
+static const char *const STATE_NAMES[] = {"free", "waiting", "paired", "broken"};
+
+struct Session {
+  std::atomic<uint8_t> state;
+  uint16_t table;     // set under the lobby lock
+  uint32_t id;        // serial number, for metrics labels
+  uint64_t startUs;
+  Side side[2];
+};
+
+// Pairing state shared by all shards, guarded by lock: the lobby maps
+// table + 1 to the session waiting there.
+struct Lobby {
+  std::mutex lock;
+  FlatTable<uint32_t> waiting;
+  std::vector<uint32_t> freeSessions;
+  uint32_t nextId = 1;
+  uint64_t full = 0;  // registrations refused, all sessions in use
+};
+
+static Options opt;
+static std::unique_ptr<Session[]> sessions;
+static Lobby lobby;
+static std::atomic<bool> stopping{false};
+
+// Hand a board's side of its session back. Caller holds lobby.lock.
+static void releaseSide(uint32_t sid, uint8_t side) {
+  Session &s = sessions[sid];
+  s.side[side].endpoint.store(0, std::memory_order_release);
+  uint8_t state = s.state.load(std::memory_order_relaxed);
+  if (state == SESSION_WAITING) lobby.waiting.erase((uint64_t)s.table + 1);
+  if (state == SESSION_PAIRED) {
+    // The partner is told on its next packet
+    s.state.store(SESSION_BROKEN, std::memory_order_release);
+    return;
+  }
+  if (state == SESSION_BROKEN && s.side[side ^ 1].endpoint.load(std::memory_order_relaxed)) return;
+  s.state.store(SESSION_FREE, std::memory_order_release);
+  lobby.freeSessions.push_back(sid);
+}
+
+struct EndpointEntry {
+  uint32_t session;
+  uint8_t side;
+  uint64_t lastUs;
+};
+
+struct Shard {
+  unsigned index = 0;
+  int fd = -1, epfd = -1, timerfd = -1;
+  FlatTable<EndpointEntry> endpoints{1024};
+
+  // Receive batch
+  mmsghdr in[BATCH];
+  iovec inIov[BATCH];
+  sockaddr_in inAddr[BATCH];
+  uint8_t inBuf[BATCH][MAX_DATAGRAM];
+
+  // Send batch: forwards point into inBuf, replies into replyBuf
+  mmsghdr out[2 * BATCH];
+  iovec outIov[2 * BATCH];
+  sockaddr_in outAddr[2 * BATCH];
+  uint8_t replyBuf[2 * BATCH][WIRE_MAX_LEN];
+  int outCount = 0;
+
+  std::atomic<uint64_t> rxPackets{0}, txPackets{0}, rxBytes{0}, unknown{0}, sendErrors{0};
+
+  bool open(uint16_t port);
+  void run();
+  void drain();
+  void handle(const uint8_t *data, int len, const sockaddr_in &from, uint64_t now);
+  void onHello(uint64_t key, const sockaddr_in &from, uint16_t table, uint64_t now);
+  void queue(const sockaddr_in &to, const uint8_t *data, int len);
+  void queueHello(const sockaddr_in &to, uint16_t table, uint8_t state, uint8_t role);
+  void flush();
+  void sweep(uint64_t now);
+};
+
+bool Shard::open(uint16_t port) {
+  fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  int one = 1, rcvbuf = 4 << 20;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("relay: bind");
+    return false;
+  }
+  timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  itimerspec tick = {{1, 0}, {1, 0}};
+  timerfd_settime(timerfd, 0, &tick, nullptr);
+  epfd = epoll_create1(0);
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+  ev.data.fd = timerfd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev);
+  for (int i = 0; i < BATCH; i++) {
+    inIov[i] = {inBuf[i], MAX_DATAGRAM};
+    memset(&in[i], 0, sizeof(in[i]));
+    in[i].msg_hdr.msg_name = &inAddr[i];
+    in[i].msg_hdr.msg_iov = &inIov[i];
+    in[i].msg_hdr.msg_iovlen = 1;
+  }
+  for (int i = 0; i < 2 * BATCH; i++) {
+    memset(&out[i], 0, sizeof(out[i]));
+    out[i].msg_hdr.msg_name = &outAddr[i];
+    out[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    out[i].msg_hdr.msg_iov = &outIov[i];
+    out[i].msg_hdr.msg_iovlen = 1;
+  }
+  return true;
+}
+
+void Shard::run() {
+  epoll_event events[4];
+  while (!stopping.load(std::memory_order_relaxed)) {
+    int n = epoll_wait(epfd, events, 4, 200);
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.fd == fd) {
+        drain();
+      } else {
+        uint64_t expirations;
+        if (read(timerfd, &expirations, sizeof(expirations)) > 0) sweep(monoUs());
+      }
+    }
+  }
+}
+
+// Read and handle batches until the socket is empty.
+void Shard::drain() {
+  for (;;) {
+    for (int i = 0; i < BATCH; i++) in[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    int n = recvmmsg(fd, in, BATCH, MSG_DONTWAIT, nullptr);
+    if (n <= 0) return;
+    uint64_t now = monoUs();
+    for (int i = 0; i < n; i++) handle(inBuf[i], (int)in[i].msg_len, inAddr[i], now);
+    rxPackets.fetch_add(n, std::memory_order_relaxed);
+    flush();
+    if (n < BATCH) return;
+  }
+}
+
+static bool isHello(const uint8_t *data, int len) {
+  if (len >= 2 && data[0] == WIRE_MAGIC) return data[1] == MSG_HELLO;
+  return len >= 6 && memcmp(data, "HELLO:", 6) == 0;
+}
+
+void Shard::handle(const uint8_t *data, int len, const sockaddr_in &from, uint64_t now) {
+  rxBytes.fetch_add(len, std::memory_order_relaxed);
+  uint64_t key = endpointKey(from);
+  Message msg;
+  if (isHello(data, len)) {
+    if (decodeMessage(data, len, msg)) onHello(key, from, msg.table, now);
+    return;
+  }
+  EndpointEntry *e = endpoints.find(key);
+  if (!e) {
+    unknown.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  e->lastUs = now;
+  Session &s = sessions[e->session];
+  Side &me = s.side[e->side], &peer = s.side[e->side ^ 1];
+  me.packets.fetch_add(1, std::memory_order_relaxed);
+  me.bytes.fetch_add(len, std::memory_order_relaxed);
+  uint64_t to = 0;
+  if (s.state.load(std::memory_order_acquire) == SESSION_PAIRED) to = peer.endpoint.load(std::memory_order_acquire);
+  if (!to) {
+    me.dropped.fetch_add(1, std::memory_order_relaxed);
+    queueHello(from, s.table, RELAY_WAITING, e->side);
+    return;
+  }
+  // Time each board's answers; text-mode traffic is forwarded untimed
+  if (len >= WIRE_HEADER_LEN && data[0] == WIRE_MAGIC) {
+    uint64_t expected = 0, sent;
+    switch (data[1]) {
+      case MSG_PING:
+        // A new PING means the last one went unanswered
+        peer.pingAtUs.store(now, std::memory_order_relaxed);
+        break;
+      case MSG_PONG:
+        if ((sent = me.pingAtUs.exchange(0, std::memory_order_relaxed))) me.rtt.record(now - sent);
+        break;
+      case MSG_SHOT:
+        // Retransmissions keep the first send time
+        peer.shotAtUs.compare_exchange_strong(expected, now, std::memory_order_relaxed);
+        break;
+      case MSG_RESULT:
+        if ((sent = me.shotAtUs.exchange(0, std::memory_order_relaxed))) me.turn.record(now - sent);
+        break;
+    }
+  }
+  queue(endpointAddr(to), data, len);
+}
+
+void Shard::onHello(uint64_t key, const sockaddr_in &from, uint16_t table, uint64_t now) {
+  EndpointEntry *e = endpoints.find(key);
+  if (e) {
+    Session &s = sessions[e->session];
+    uint8_t state = s.state.load(std::memory_order_acquire);
+    if (s.table == table && (state == SESSION_WAITING || state == SESSION_PAIRED)) {
+      // A repeat: its answer was lost, or it was still on its way
+      e->lastUs = now;
+      queueHello(from, table, state == SESSION_PAIRED ? RELAY_PAIRED : RELAY_WAITING, e->side);
+      return;
+    }
+    // Its partner left or it moved to another table: start over
+    std::lock_guard<std::mutex> guard(lobby.lock);
+    releaseSide(e->session, e->side);
+    endpoints.erase(key);
+  }
+
+  uint32_t sid;
+  uint8_t side;
+  uint64_t partner = 0;
+  {
+    std::lock_guard<std::mutex> guard(lobby.lock);
+    uint32_t *waiting = lobby.waiting.find((uint64_t)table + 1);
+    if (waiting) {
+      sid = *waiting;
+      lobby.waiting.erase((uint64_t)table + 1);
+      Session &s = sessions[sid];
+      side = 1;
+      partner = s.side[0].endpoint.load(std::memory_order_relaxed);
+      s.side[1].endpoint.store(key, std::memory_order_relaxed);
+      s.state.store(SESSION_PAIRED, std::memory_order_release);
+    } else {
+      if (lobby.freeSessions.empty()) {
+        lobby.full++;
+        return;
+      }
+      sid = lobby.freeSessions.back();
+      lobby.freeSessions.pop_back();
+      Session &s = sessions[sid];
+      s.side[0].clear();
+      s.side[1].clear();
+      s.table = table;
+      s.id = lobby.nextId++;
+      s.startUs = now;
+      side = 0;
+      s.side[0].endpoint.store(key, std::memory_order_relaxed);
+      s.state.store(SESSION_WAITING, std::memory_order_release);
+      lobby.waiting.insert((uint64_t)table + 1) = sid;
+    }
+  }
+  endpoints.insert(key) = EndpointEntry{sid, side, now};
+  queueHello(from, table, partner ? RELAY_PAIRED : RELAY_WAITING, side);
+  // The waiting board need not wait for its next HELLO to learn of it
+  if (partner) queueHello(endpointAddr(partner), table, RELAY_PAIRED, 0);
+}
+
+void Shard::queue(const sockaddr_in &to, const uint8_t *data, int len) {
+  if (outCount == 2 * BATCH) flush();
+  outAddr[outCount] = to;
+  outIov[outCount] = {(void *)data, (size_t)len};
+  outCount++;
+}
+
+void Shard::queueHello(const sockaddr_in &to, uint16_t table, uint8_t state, uint8_t role) {
+  if (outCount == 2 * BATCH) flush();
+  Message m = makeMessage(MSG_HELLO);
+  m.table = table;
+  m.relayState = state;
+  m.role = role;
+  uint8_t *buf = replyBuf[outCount];
+  outAddr[outCount] = to;
+  outIov[outCount] = {buf, encodeMessage(m, buf)};
+  outCount++;
+}
+
+void Shard::flush() {
+  int sent = 0;
+  while (sent < outCount) {
+    int n = sendmmsg(fd, out + sent, outCount - sent, MSG_DONTWAIT);
+    if (n <= 0) {
+      // Socket buffer full or the destination unreachable: drop this one
+      sendErrors.fetch_add(1, std::memory_order_relaxed);
+      sent++;
+      continue;
+    }
+    sent += n;
+    txPackets.fetch_add(n, std::memory_order_relaxed);
+  }
+  outCount = 0;
+}
+
+// Drop boards that have been silent for --idle seconds.
+void Shard::sweep(uint64_t now) {
+  uint64_t idleUs = (uint64_t)opt.idleSec * 1000000;
+  std::vector<uint64_t> stale;
+  endpoints.forEach([&](uint64_t key, EndpointEntry &e) {
+    if (now - e.lastUs > idleUs) stale.push_back(key);
+  });
+  if (stale.empty()) return;
+  std::lock_guard<std::mutex> guard(lobby.lock);
+  for (uint64_t key : stale) {
+    EndpointEntry *e = endpoints.find(key);
+    releaseSide(e->session, e->side);
+    endpoints.erase(key);
+  }
+}
+
+static void writeHistogram(FILE *f, const char *name, const char *labels, const Histogram &h) {
+  uint64_t n = h.total();
+  if (!n) return;
+  fprintf(f, "%s{%s,quantile=\"0.5\"} %llu\n", name, labels, (unsigned long long)h.quantile(0.5));
+  fprintf(f, "%s{%s,quantile=\"0.99\"} %llu\n", name, labels, (unsigned long long)h.quantile(0.99));
+  fprintf(f, "%s_count{%s} %llu\n", name, labels, (unsigned long long)n);
+  fprintf(f, "%s_max{%s} %u\n", name, labels, h.maxUs.load(std::memory_order_relaxed));
+}
+
+// Rewrite path atomically with every shard's and live session's figures.
+static void writeMetrics(const char *path, std::vector<std::unique_ptr<Shard>> &shards, uint64_t now) {
+  std::string tmp = std::string(path) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (!f) {
+    perror("relay: metrics");
+    return;
+  }
+  fprintf(f, "# TYPE relay_packets_total counter\n");
+  for (auto &s : shards) {
+    fprintf(f, "relay_packets_total{shard=\"%u\",dir=\"rx\"} %llu\n", s->index,
+            (unsigned long long)s->rxPackets.load());
+    fprintf(f, "relay_packets_total{shard=\"%u\",dir=\"tx\"} %llu\n", s->index,
+            (unsigned long long)s->txPackets.load());
+    fprintf(f, "relay_unregistered_total{shard=\"%u\"} %llu\n", s->index, (unsigned long long)s->unknown.load());
+    fprintf(f, "relay_send_errors_total{shard=\"%u\"} %llu\n", s->index, (unsigned long long)s->sendErrors.load());
+  }
+  std::lock_guard<std::mutex> guard(lobby.lock);
+  unsigned counts[4] = {0, 0, 0, 0};
+  fprintf(f, "# TYPE relay_session_packets_total counter\n# TYPE relay_session_rtt_us summary\n"
+             "# TYPE relay_session_turn_us summary\n");
+  for (uint32_t i = 0; i < opt.maxSessions; i++) {
+    Session &s = sessions[i];
+    uint8_t state = s.state.load(std::memory_order_acquire);
+    counts[state]++;
+    if (state == SESSION_FREE) continue;
+    for (int side = 0; side < 2; side++) {
+      const Side &d = s.side[side];
+      char labels[160];
+      snprintf(labels, sizeof(labels), "session=\"%u\",table=\"%u\",side=\"%d\",board=\"%s\"", s.id, s.table, side,
+               endpointText(d.endpoint.load()).c_str());
+      fprintf(f, "relay_session_packets_total{%s} %llu\n", labels, (unsigned long long)d.packets.load());
+      fprintf(f, "relay_session_dropped_total{%s} %llu\n", labels, (unsigned long long)d.dropped.load());
+      writeHistogram(f, "relay_session_rtt_us", labels, d.rtt);
+      writeHistogram(f, "relay_session_turn_us", labels, d.turn);
+    }
+    fprintf(f, "relay_session_age_seconds{session=\"%u\",table=\"%u\",state=\"%s\"} %llu\n", s.id, s.table,
+            STATE_NAMES[state], (unsigned long long)((now - s.startUs) / 1000000));
+  }
+  fprintf(f, "# TYPE relay_sessions gauge\n");
+  for (int st = SESSION_WAITING; st <= SESSION_BROKEN; st++)
+    fprintf(f, "relay_sessions{state=\"%s\"} %u\n", STATE_NAMES[st], counts[st]);
+  fprintf(f, "relay_registrations_refused_total %llu\n", (unsigned long long)lobby.full);
+  fclose(f);
+  rename(tmp.c_str(), path);
+}
+
+static void printSummary(std::vector<std::unique_ptr<Shard>> &shards, double seconds, uint64_t &lastRx,
+                         uint64_t &lastTx) {
+  uint64_t rx = 0, tx = 0, unknown = 0;
+  for (auto &s : shards) rx += s->rxPackets.load(), tx += s->txPackets.load(), unknown += s->unknown.load();
+  unsigned counts[4] = {0, 0, 0, 0};
+  uint64_t rtt[HIST_BUCKETS] = {}, turn[HIST_BUCKETS] = {};
+  {
+    std::lock_guard<std::mutex> guard(lobby.lock);
+    for (uint32_t i = 0; i < opt.maxSessions; i++) {
+      Session &s = sessions[i];
+      uint8_t state = s.state.load(std::memory_order_acquire);
+      counts[state]++;
+      if (state == SESSION_FREE) continue;
+      for (const Side &d : s.side) d.rtt.addTo(rtt), d.turn.addTo(turn);
+    }
+  }
+  auto quantile = [](const uint64_t *h, double q) -> unsigned long long {
+    uint64_t n = 0, seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) n += h[b];
+    for (int b = 0; b < HIST_BUCKETS; b++)
+      if ((seen += h[b]) && seen >= q * n) return 1ULL << b;
+    return 0;
+  };
+  printf("sessions paired %u waiting %u broken %u | %.0f pkt/s in, %.0f out, %llu unregistered"
+         " | rtt p50 <%lluus p99 <%lluus | turn p50 <%lluus p99 <%lluus\n",
+         counts[SESSION_PAIRED], counts[SESSION_WAITING], counts[SESSION_BROKEN], (rx - lastRx) / seconds,
+         (tx - lastTx) / seconds, (unsigned long long)unknown, quantile(rtt, 0.5), quantile(rtt, 0.99),
+         quantile(turn, 0.5), quantile(turn, 0.99));
+  fflush(stdout);
+  lastRx = rx, lastTx = tx;
+}
+
+static void onSignal(int) { stopping.store(true); }
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string o = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : "";
+    if (o == "--port") opt.port = (uint16_t)atoi(val), i++;
+    else if (o == "--shards") opt.shards = (unsigned)atoi(val), i++;
+    else if (o == "--max-sessions") opt.maxSessions = (uint32_t)atol(val), i++;
+    else if (o == "--idle") opt.idleSec = (uint32_t)atol(val), i++;
+    else if (o == "--metrics") opt.metricsPath = val, i++;
+    else if (o == "--interval") opt.intervalSec = (uint32_t)atol(val), i++;
+    else if (o == "--duration") opt.durationSec = (uint32_t)atol(val), i++;
+    else if (o == "--quiet") opt.quiet = true;
+    else {
+      fprintf(stderr, "unknown option %s\n", o.c_str());
+      return 2;
+    }
+  }
+  if (!opt.shards) opt.shards = 1;
+  if (!opt.intervalSec) opt.intervalSec = 1;
+
+  sessions.reset(new Session[opt.maxSessions]);
+  lobby.waiting = FlatTable<uint32_t>(1024);
+  for (uint32_t i = opt.maxSessions; i-- > 0;) {
+    sessions[i].state = SESSION_FREE;
+    lobby.freeSessions.push_back(i);
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  for (unsigned i = 0; i < opt.shards; i++) {
+    shards.emplace_back(new Shard);
+    shards.back()->index = i;
+    if (!shards.back()->open(opt.port)) return 1;
+  }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  std::vector<std::thread> threads;
+  for (auto &s : shards) threads.emplace_back([&s] { s->run(); });
+  printf("relay on udp port %u, %u shard(s), up to %u sessions\n", opt.port, opt.shards, opt.maxSessions);
+  fflush(stdout);
+
+  uint64_t start = monoUs(), lastReport = start, lastRx = 0, lastTx = 0;
+  while (!stopping.load()) {
+    usleep(100000);
+    uint64_t now = monoUs();
+    if (opt.durationSec && now - start >= (uint64_t)opt.durationSec * 1000000) stopping.store(true);
+    if (now - lastReport < (uint64_t)opt.intervalSec * 1000000 && !stopping.load()) continue;
+    if (!opt.quiet) printSummary(shards, (now - lastReport) / 1e6, lastRx, lastTx);
+    if (opt.metricsPath) writeMetrics(opt.metricsPath, shards, now);
+    lastReport = now;
+  }
+  for (auto &t : threads) t.join();
+  return 0;
+}
@@ -0,0 +1,4 @@
+// Firmware instance A for the two-board simulator.
+#define SIM_BOARD_NAMESPACE board_a
+#define SIM_BOARD_API boardA
+#include "board_instance.inc"
@@ -0,0 +1,4 @@
+// Firmware instance B for the two-board simulator.
+#define SIM_BOARD_NAMESPACE board_b
+#define SIM_BOARD_API boardB
+#include "board_instance.inc"
@@ -0,0 +1,5 @@
+// Firmware instance board B runs after --reboot: a fresh copy of its
+// statics on the same hal::Board, so EEPROM and network outlive the reset.
+#define SIM_BOARD_NAMESPACE board_b_reboot
+#define SIM_BOARD_API boardBReboot
+#include "board_instance.inc"
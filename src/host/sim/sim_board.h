@@ -0,0 +1,36 @@
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#include <stdint.h>
+
+// Snapshot of one firmware instance's game state, read by the simulator's
+// autopilot and end-of-game report.
+struct BoardView {
+  bool placing;        // still placing boats
+  bool synced;         // READY handshake finished
+  bool myTurn;         // in PHASE_MY_TURN
+  int currentIndex;    // boat being placed
+  int boatY;           // row of the boat being placed
+  int aimX, aimY;
+  int boatsCount;
+  int boatsAfloat;
+  uint32_t framesPushed;   // showFrame() calls that reached the strip
+  uint32_t framesSkipped;  // showFrame() calls with nothing changed
+};
+
+// Entry points exported by each firmware instance (board_a.cpp, board_b.cpp,
+// board_b_reboot.cpp).
+struct BoardApi {
+  int width, height;               // game board
+  int matrixWidth, matrixHeight;   // LED matrix the board is centred on
+  void (*setup)();
+  void (*loop)();
+  BoardView (*view)();
+  uint8_t (*opponentCell)(int x, int y);  // CellState of the opponent map
+};
+
+extern const BoardApi boardA;
+extern const BoardApi boardB;
+extern const BoardApi boardBReboot;  // board B after --reboot
+
+#endif  // SIM_BOARD_H
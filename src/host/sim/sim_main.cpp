@@ -0,0 +1,416 @@
+// Two-board simulator: runs two firmware instances in one process over a
+// loopback network on a shared virtual clock, with scripted or autopiloted
+// joysticks and an optional ANSI rendering of both LED matrices.
+//
+//   sim [--duration MS] [--latency MIN:MAX] [--loss P] [--seed N]
+//       [--skew MS] [--clock-offset MS] [--script FILE] [--render]
+//       [--realtime] [--quiet] [--capture FILE] [--link-drop AT:MS]
+//       [--reboot AT]
+//
+// --skew delays board B's autopilot so the boards finish placement at
+// different times (0 makes them tie). --clock-offset starts board B's
+// millis() that far ahead of board A's, as if it had booted earlier.
+//
+// Built with -D SOLO_AI=1 each board plays its own built-in AI opponent
+// instead of the other board; the autopilots still drive both.
+//
+// --link-drop takes board B's WiFi link down at AT ms for MS ms, as if it
+// had walked out of range, to exercise the reconnect supervisor.
+//
+// --reboot resets board B at AT ms: a second copy of the firmware takes
+// over with its millis() back at 0, the same EEPROM, and the WiFi link
+// down for as long as the NINA takes to come back.
+//
+// --capture writes every datagram either board sent or received to FILE in
+// the capture format of capture.h, for standin --replay.
+//
+// Script lines are "<ms> <A|B> <left|right|up|down|press> [hold ms]";
+// a board with a script does not use the autopilot.
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <IPAddress.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../capture.h"
+#include "../netsim/lossy_channel.h"
+#include "sim_board.h"
+
+// Board and LED matrix dimensions, taken from the firmware at startup.
+static int BOARD_W, BOARD_H, MATRIX_W, MATRIX_H;
+
+struct VirtualClock : hal::Clock {
+  uint64_t nowUs = 0;
+  uint64_t micros64() override { return nowUs; }
+  void sleepUs(uint32_t us) override { nowUs += us; }
+  uint32_t ms() const { return (uint32_t)(nowUs / 1000); }
+};
+
+static VirtualClock clock_;
+
+// A board's view of the shared clock, offset by a fixed amount.
+struct BoardClock : hal::Clock {
+  uint64_t offsetUs = 0;
+  uint64_t micros64() override { return clock_.nowUs + offsetUs; }
+  void sleepUs(uint32_t us) override { clock_.sleepUs(us); }
+};
+
+// Joystick state driven by the autopilot or a script.
+struct Stick : hal::AnalogInput {
+  int dx = 0, dy = 0;
+  bool button = false;
+  // Inverse of joystick.h: x=+1 below 400, x=-1 in 600..850, button above 850
+  int read(uint8_t pin) override {
+    if (pin == A0) {
+      if (button) return 1000;
+      return dx > 0 ? 100 : dx < 0 ? 700 : 512;
+    }
+    return dy > 0 ? 100 : dy < 0 ? 700 : 512;
+  }
+};
+
+struct Frame : hal::LedOutput {
+  std::vector<uint8_t> rgb;
+  uint32_t pushes = 0;
+  void show(const uint8_t *data, int count, uint8_t) override {
+    rgb.assign(data, data + count * 3);
+    pushes++;
+  }
+};
+
+struct SerialLog : hal::TextOutput {
+  const char *prefix = "";
+  bool quiet = false;
+  std::string line;
+  void write(const uint8_t *data, size_t len) override {
+    for (size_t i = 0; i < len; i++) {
+      char c = (char)data[i];
+      if (c == '\r') continue;
+      if (c != '\n') {
+        line += c;
+        continue;
+      }
+      if (!quiet) printf("%8.3f [%s] %s\n", clock_.ms() / 1000.0, prefix, line.c_str());
+      line.clear();
+    }
+  }
+};
+
+// Capture file shared by both boards, times on the virtual clock.
+struct CaptureFile {
+  FILE *file = nullptr;
+  uint32_t lastMs = 0;
+
+  bool open(const char *path) {
+    file = fopen(path, "wb");
+    return file && fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, file) == 1;
+  }
+
+  void write(uint8_t flags, const uint8_t *data, size_t len) {
+    uint8_t record[CAPTURE_MAX_RECORD];
+    uint8_t n = len <= WIRE_MAX_LEN ? captureEncode(flags, clock_.ms() - lastMs, data, (uint8_t)len, record) : 0;
+    if (!file || !n) return;
+    fwrite(record, 1, n, file);
+    lastMs = clock_.ms();
+  }
+};
+
+static CaptureFile capture;
+
+// One end of the loopback network: whatever a board sends goes to its peer,
+// regardless of the destination address it used.
+struct Port : hal::DatagramIO {
+  uint32_t ip = 0;
+  uint16_t port = 0;
+  uint32_t linkUpAtMs = 1500;
+  uint32_t linkDownAtMs = 0, linkDownForMs = 0;
+  uint8_t captureFlags = 0;  // CAPTURE_BOARD_B for board B
+  LossyChannel *out = nullptr, *in = nullptr;
+  Port *peer = nullptr;
+  std::vector<uint8_t> scratch;
+
+  bool linkUp() override {
+    uint32_t now = clock_.ms();
+    return now >= linkUpAtMs && !(linkDownForMs && now >= linkDownAtMs && now - linkDownAtMs < linkDownForMs);
+  }
+  uint32_t localIp() override { return ip; }
+  bool bind(uint16_t p) override {
+    port = p;
+    return true;
+  }
+  bool send(uint32_t, uint16_t, const uint8_t *data, size_t len) override {
+    if (!linkUp()) return false;
+    capture.write(captureFlags, data, len);
+    out->send(data, (uint8_t)len, clock_.ms());
+    return true;
+  }
+  int receive(uint8_t *buf, size_t cap, uint32_t &fromIp, uint16_t &fromPort) override {
+    if (!port || !in->receive(clock_.ms(), scratch)) return -1;
+    // Lost in the air while the link is down
+    if (!linkUp()) return -1;
+    size_t n = std::min(cap, scratch.size());
+    memcpy(buf, scratch.data(), n);
+    fromIp = peer->ip;
+    fromPort = peer->port;
+    capture.write(captureFlags | CAPTURE_RX, buf, n);
+    return (int)n;
+  }
+};
+
+struct ScriptStep {
+  uint32_t atMs;
+  int dx, dy;
+  bool button;
+  uint32_t holdMs;
+};
+
+// Drives a board's joystick the way a player would: short pulses to move
+// one cell, a long press to confirm a boat, a click to fire.
+struct Autopilot {
+  uint32_t releaseAtMs = 0, nextActionMs = 0;
+
+  void step(const BoardApi &api, Stick &stick, uint32_t now) {
+    if (now >= releaseAtMs) stick.dx = stick.dy = 0, stick.button = false;
+    if (now < nextActionMs) return;
+    BoardView v = api.view();
+    if (v.placing) {
+      // Stack boats on successive rows above the centre
+      int targetRow = std::max(0, BOARD_H / 2 - v.currentIndex);
+      if (v.boatY > targetRow) pulse(stick, 0, -1, false, 20, now);
+      else pulse(stick, 0, 0, true, 700, now);
+    } else if (v.synced && v.myTurn) {
+      int tx, ty;
+      if (!nextTarget(api, tx, ty)) return;
+      if (v.aimX != tx) pulse(stick, tx > v.aimX ? 1 : -1, 0, false, 20, now);
+      else if (v.aimY != ty) pulse(stick, 0, ty > v.aimY ? 1 : -1, false, 20, now);
+      else pulse(stick, 0, 0, true, 20, now);
+    }
+  }
+
+  // First unknown cell on a checkerboard sweep, then any unknown cell.
+  static bool nextTarget(const BoardApi &api, int &tx, int &ty) {
+    for (int pass = 0; pass < 2; pass++)
+      for (int y = 0; y < BOARD_H; y++)
+        for (int x = 0; x < BOARD_W; x++)
+          if ((pass || (x + y) % 2 == 0) && api.opponentCell(x, y) == 0) {
+            tx = x, ty = y;
+            return true;
+          }
+    return false;
+  }
+
+  void pulse(Stick &stick, int dx, int dy, bool button, uint32_t holdMs, uint32_t now) {
+    stick.dx = dx, stick.dy = dy, stick.button = button;
+    releaseAtMs = now + holdMs;
+    // Joystick events are applied at the next 75 ms game step; leave two
+    // steps for the release to be seen before acting again
+    nextActionMs = releaseAtMs + 160;
+  }
+};
+
+struct SimBoard {
+  const char *name;
+  const BoardApi *api;
+  Stick stick;
+  Frame frame;
+  SerialLog log;
+  Port port;
+  BoardClock clock;
+  hal::Board hal{&clock, &frame, &stick, &port, &log};
+  Autopilot pilot;
+  std::deque<ScriptStep> script;
+  bool scripted = false;
+  uint32_t scriptReleaseMs = 0;
+  uint64_t loops = 0, loopNs = 0, maxLoopNs = 0;
+
+  void input(uint32_t now) {
+    if (!scripted) {
+      pilot.step(*api, stick, now);
+      return;
+    }
+    if (now >= scriptReleaseMs) stick.dx = stick.dy = 0, stick.button = false;
+    while (!script.empty() && script.front().atMs <= now) {
+      ScriptStep s = script.front();
+      script.pop_front();
+      stick.dx = s.dx, stick.dy = s.dy, stick.button = s.button;
+      scriptReleaseMs = now + s.holdMs;
+    }
+  }
+
+  void runLoop() {
+    hal::setActive(&hal);
+    auto t0 = std::chrono::steady_clock::now();
+    api->loop();
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - t0).count();
+    hal::setActive(nullptr);
+    loops++;
+    loopNs += ns;
+    maxLoopNs = std::max(maxLoopNs, ns);
+  }
+};
+
+static bool loadScript(const char *path, SimBoard &a, SimBoard &b) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  char line[128], who[4], cmd[16];
+  while (fgets(line, sizeof(line), f)) {
+    unsigned at = 0, hold = 80;
+    if (line[0] == '#' || sscanf(line, "%u %3s %15s %u", &at, who, cmd, &hold) < 3) continue;
+    ScriptStep s{at, 0, 0, false, hold};
+    std::string c = cmd;
+    if (c == "left") s.dx = -1;
+    else if (c == "right") s.dx = 1;
+    else if (c == "up") s.dy = -1;
+    else if (c == "down") s.dy = 1;
+    else if (c == "press") s.button = true;
+    else continue;
+    SimBoard &target = (who[0] == 'B' || who[0] == 'b') ? b : a;
+    target.script.push_back(s);
+    target.scripted = true;
+  }
+  fclose(f);
+  return true;
+}
+
+static void renderAnsi(SimBoard &a, SimBoard &b) {
+  printf("\x1b[H\x1b[2J t=%7.3fs\n", clock_.ms() / 1000.0);
+  for (int y = 0; y < MATRIX_H; y++) {
+    for (SimBoard *board : {&a, &b}) {
+      printf("  ");
+      for (int x = 0; x < MATRIX_W; x++) {
+        // LED strip is serpentine: odd rows run right to left
+        int i = y * MATRIX_W + (y % 2 ? MATRIX_W - 1 - x : x);
+        const std::vector<uint8_t> &px = board->frame.rgb;
+        if ((size_t)i * 3 + 2 >= px.size()) {
+          printf("  ");
+          continue;
+        }
+        printf("\x1b[48;2;%d;%d;%dm  ", px[i * 3], px[i * 3 + 1], px[i * 3 + 2]);
+      }
+      printf("\x1b[0m");
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  uint32_t durationMs = 1800000, seed = 1, latMin = 2, latMax = 6, skewMs = 700, clockOffsetMs = 0;
+  uint32_t dropAtMs = 0, dropForMs = 0, rebootAtMs = 0;
+  double loss = 0;
+  bool render = false, realtime = false, quiet = false;
+  const char *scriptPath = nullptr, *capturePath = nullptr;
+  for (int i = 1; i < argc; i++) {
+    std::string opt = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : "";
+    if (opt == "--duration") durationMs = (uint32_t)atol(val), i++;
+    else if (opt == "--latency") sscanf(val, "%u:%u", &latMin, &latMax), i++;
+    else if (opt == "--loss") loss = atof(val), i++;
+    else if (opt == "--seed") seed = (uint32_t)atol(val), i++;
+    else if (opt == "--skew") skewMs = (uint32_t)atol(val), i++;
+    else if (opt == "--clock-offset") clockOffsetMs = (uint32_t)atol(val), i++;
+    else if (opt == "--script") scriptPath = val, i++;
+    else if (opt == "--render") render = true;
+    else if (opt == "--realtime") realtime = true;
+    else if (opt == "--quiet") quiet = true;
+    else if (opt == "--capture") capturePath = val, i++;
+    else if (opt == "--link-drop") sscanf(val, "%u:%u", &dropAtMs, &dropForMs), i++;
+    else if (opt == "--reboot") rebootAtMs = (uint32_t)atol(val), i++;
+    else {
+      fprintf(stderr, "unknown option %s\n", opt.c_str());
+      return 2;
+    }
+  }
+
+  LossyChannel ab(seed), ba(seed + 1);
+  for (LossyChannel *c : {&ab, &ba}) c->loss = loss, c->delayMin = latMin, c->delayMax = latMax;
+
+  BOARD_W = boardA.width, BOARD_H = boardA.height;
+  MATRIX_W = boardA.matrixWidth, MATRIX_H = boardA.matrixHeight;
+  SimBoard a, b;
+  a.name = "A", a.api = &boardA, a.port.ip = IPAddress(172, 20, 10, 3);
+  b.name = "B", b.api = &boardB, b.port.ip = IPAddress(172, 20, 10, 4);
+  a.port.out = b.port.in = &ab;
+  b.port.out = a.port.in = &ba;
+  a.port.peer = &b.port, b.port.peer = &a.port;
+  b.port.linkUpAtMs = 2100;
+  b.port.linkDownAtMs = dropAtMs, b.port.linkDownForMs = dropForMs;
+  b.port.captureFlags = CAPTURE_BOARD_B;
+  b.pilot.nextActionMs = skewMs;
+  b.clock.offsetUs = (uint64_t)clockOffsetMs * 1000;
+  for (SimBoard *s : {&a, &b}) s->log.prefix = s->name, s->log.quiet = quiet || render;
+  if (scriptPath && !loadScript(scriptPath, a, b)) {
+    fprintf(stderr, "cannot read script %s\n", scriptPath);
+    return 2;
+  }
+  if (capturePath && !capture.open(capturePath)) {
+    fprintf(stderr, "cannot write capture %s\n", capturePath);
+    return 2;
+  }
+
+  for (SimBoard *s : {&a, &b}) {
+    hal::setActive(&s->hal);
+    s->api->setup();
+    hal::setActive(nullptr);
+  }
+
+  // Step the virtual clock 250 us at a time; each board's scheduler decides
+  // which of its tasks are due.
+  const uint32_t STEP_US = 250;
+  uint32_t gameOverAt = 0, lastRender = 0;
+  auto wallStart = std::chrono::steady_clock::now();
+  while (clock_.ms() < durationMs) {
+    uint32_t now = clock_.ms();
+    if (rebootAtMs && now >= rebootAtMs) {
+      rebootAtMs = 0;
+      printf("[sim] rebooting board B at %.3f s\n", now / 1000.0);
+      b.api = &boardBReboot;
+      b.clock.offsetUs = 0 - clock_.nowUs;
+      b.port.linkUpAtMs = now + 2100;
+      hal::setActive(&b.hal);
+      b.api->setup();
+      hal::setActive(nullptr);
+    }
+    for (SimBoard *s : {&a, &b}) {
+      s->input(now);
+      s->runLoop();
+    }
+    if (!gameOverAt) {
+      BoardView va = a.api->view(), vb = b.api->view();
+      if ((va.boatsCount && !va.placing && !va.boatsAfloat) || (vb.boatsCount && !vb.placing && !vb.boatsAfloat))
+        gameOverAt = now;
+    } else if (now - gameOverAt > 2000) {
+      break;
+    }
+    if (render && now - lastRender >= 50) {
+      renderAnsi(a, b);
+      lastRender = now;
+    }
+    clock_.nowUs += STEP_US;
+    if (realtime)
+      std::this_thread::sleep_until(wallStart + std::chrono::microseconds(clock_.nowUs));
+  }
+
+  printf("\nsimulated %.3f s", clock_.ms() / 1000.0);
+  if (gameOverAt) {
+    BoardView va = a.api->view();
+    printf(", game over at %.3f s, winner %s\n", gameOverAt / 1000.0, va.boatsAfloat ? "A" : "B");
+  } else {
+    printf(", no winner\n");
+  }
+  printf("board  loops      mean us/loop  max us/loop  LED pushes/skipped  packets sent/dropped\n");
+  for (SimBoard *s : {&a, &b}) {
+    LossyChannel *c = s->port.out;
+    BoardView v = s->api->view();
+    printf("%-5s  %-9llu  %12.2f  %11.1f  %8u/%-9u  %u/%u\n", s->name, (unsigned long long)s->loops,
+           s->loops ? s->loopNs / 1000.0 / s->loops : 0.0, s->maxLoopNs / 1000.0, s->frame.pushes,
+           v.framesSkipped, c->sent, c->dropped);
+  }
+  if (capture.file) fclose(capture.file);
+  return gameOverAt ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+#ifndef STANDIN_REPLAY_H
+#define STANDIN_REPLAY_H
+
+// standin --replay: plays one board's side of a capture (capture.h)
+// against a live endpoint, a board or another replay, and checks that the
+// other side answers as it did when the capture was taken.
+//
+// Every datagram the chosen board sent is sent again at its recorded time,
+// divided by --speed. What comes back is compared with what the board
+// received in the capture, as the game saw it: READY, SHOT and RESULT put
+// in order and rid of duplicates by the reliable link's own rlSequence. A
+// message of another type, a SHOT at another cell or a different RESULT is
+// a divergence; so are messages missing at the end or extra ones. READY
+// timestamps differ from run to run and are not compared.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../../capture.h"
+#include "../../reliable.h"
+
+struct ReplayOptions {
+  const char *path = nullptr;
+  uint8_t board = 0;  // 0 = A, CAPTURE_BOARD_B = B
+  sockaddr_in target;
+  uint16_t bindPort = 0;
+  double speed = 1;
+  double settleSec = 2;  // wait for answers after the last packet
+};
+
+struct TimedPacket {
+  uint64_t atUs;
+  uint8_t len;
+  uint8_t data[WIRE_MAX_LEN];
+};
+
+inline bool loadCapture(const char *path, uint8_t board, std::vector<TimedPacket> &sent,
+                        std::vector<TimedPacket> &received, unsigned &gaps) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  std::vector<uint8_t> buf;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buf.insert(buf.end(), chunk, chunk + n);
+  fclose(f);
+  if (buf.size() < sizeof(CAPTURE_MAGIC) || memcmp(buf.data(), CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC))) return false;
+  size_t pos = sizeof(CAPTURE_MAGIC);
+  uint64_t atMs = 0;
+  CaptureRecord r;
+  gaps = 0;
+  while (pos < buf.size()) {
+    int used = captureDecode(buf.data() + pos, (int)(buf.size() - pos), r);
+    if (used <= 0) return false;
+    pos += used;
+    atMs += r.dtMs;
+    if ((r.flags & CAPTURE_BOARD_B) != board) continue;
+    if (r.flags & CAPTURE_GAP) gaps++;
+    TimedPacket p;
+    p.atUs = atMs * 1000;
+    p.len = r.len;
+    memcpy(p.data, r.data, r.len);
+    (r.flags & CAPTURE_RX ? received : sent).push_back(p);
+  }
+  return true;
+}
+
+// Append the READY, SHOT and RESULT messages a packet delivers to the game:
+// none for a duplicate or one held ahead of a gap, or it and those it
+// released. Returns how many.
+inline size_t replayGameMessages(ReliableLink &window, const uint8_t *data, uint8_t len, std::vector<Message> &out) {
+  Message msg;
+  if (!decodeMessage(data, len, msg) || !isReliableType(msg.type)) return 0;
+  size_t before = out.size();
+  if (msg.sequenced && !rlSequence(window, msg)) return 0;
+  do out.push_back(msg);
+  while (rlNextHeld(window, msg));
+  return out.size() - before;
+}
+
+inline std::string replayDescribe(const Message &m) {
+  char buf[32];
+  if (m.type == MSG_SHOT) snprintf(buf, sizeof(buf), "SHOT %u,%u", m.x, m.y);
+  else if (m.type == MSG_RESULT) snprintf(buf, sizeof(buf), "RESULT %s", resultName(m.result));
+  else snprintf(buf, sizeof(buf), "%s", m.type == MSG_READY ? "READY" : "?");
+  return buf;
+}
+
+inline bool replaySame(const Message &a, const Message &b) {
+  if (a.type != b.type) return false;
+  if (a.type == MSG_SHOT) return a.x == b.x && a.y == b.y;
+  if (a.type == MSG_RESULT) return a.result == b.result;
+  return true;
+}
+
+inline uint64_t replayNowUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+inline int runReplay(const ReplayOptions &o) {
+  std::vector<TimedPacket> sent, received;
+  unsigned gaps;
+  if (!loadCapture(o.path, o.board, sent, received, gaps)) {
+    fprintf(stderr, "cannot read capture %s\n", o.path);
+    return 2;
+  }
+  ReliableLink window;
+  rlInit(window, nullptr);
+  std::vector<Message> expected;
+  for (const TimedPacket &p : received) replayGameMessages(window, p.data, p.len, expected);
+
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_port = htons(o.bindPort);
+  if (fd < 0 || bind(fd, (sockaddr *)&local, sizeof(local)) < 0) {
+    perror("standin: bind");
+    return 2;
+  }
+
+  rlInit(window, nullptr);
+  std::vector<Message> got;
+  std::vector<uint32_t> turnUs;
+  uint64_t start = replayNowUs(), shotAtUs = 0, lastRx = start, doneAt = 0;
+  uint64_t firstAt = sent.empty() ? 0 : sent.front().atUs;
+  size_t next = 0;
+  unsigned packetsIn = 0;
+  uint8_t buf[512];
+  for (;;) {
+    uint64_t now = replayNowUs();
+    while (next < sent.size() && now - start >= (uint64_t)((sent[next].atUs - firstAt) / o.speed)) {
+      const TimedPacket &p = sent[next++];
+      sendto(fd, p.data, p.len, 0, (const sockaddr *)&o.target, sizeof(o.target));
+      if (p.len > 1 && p.data[0] == WIRE_MAGIC && p.data[1] == MSG_SHOT) shotAtUs = now;
+      if (next == sent.size()) doneAt = now;
+    }
+    int len;
+    while ((len = (int)recv(fd, buf, sizeof(buf), 0)) > 0) {
+      packetsIn++;
+      lastRx = now;
+      if (len > WIRE_MAX_LEN) continue;
+      for (size_t n = replayGameMessages(window, buf, (uint8_t)len, got); n; n--)
+        if (got[got.size() - n].type == MSG_RESULT && shotAtUs) turnUs.push_back((uint32_t)(now - shotAtUs)), shotAtUs = 0;
+    }
+    // Done once everything is sent and the other side has gone quiet
+    uint64_t quietFrom = doneAt > lastRx ? doneAt : lastRx;
+    if ((doneAt || sent.empty()) && now - quietFrom >= (uint64_t)(o.settleSec * 1e6)) break;
+    usleep(200);
+  }
+  close(fd);
+  double seconds = (replayNowUs() - start) / 1e6;
+
+  unsigned divergences = 0;
+  size_t common = expected.size() < got.size() ? expected.size() : got.size();
+  for (size_t i = 0; i < common; i++) {
+    if (replaySame(expected[i], got[i])) continue;
+    if (divergences++ < 10)
+      printf("divergence at message %zu: expected %s, got %s\n", i, replayDescribe(expected[i]).c_str(),
+             replayDescribe(got[i]).c_str());
+  }
+  divergences += (unsigned)(expected.size() + got.size() - 2 * common);
+
+  std::sort(turnUs.begin(), turnUs.end());
+  printf("replayed board %c of %s at %.1fx: %zu packets out, %u in, %.1f s (%.0f packets/s)\n",
+         o.board ? 'B' : 'A', o.path, o.speed, sent.size(), packetsIn, seconds, (sent.size() + packetsIn) / seconds);
+  printf("game messages: %zu expected, %zu received, %u divergences", expected.size(), got.size(), divergences);
+  if (expected.size() != got.size())
+    printf(" (%zu %s)", expected.size() > got.size() ? expected.size() - got.size() : got.size() - expected.size(),
+           expected.size() > got.size() ? "missing" : "extra");
+  printf("%s\n", gaps ? ", capture has gaps" : "");
+  if (!turnUs.empty())
+    printf("SHOT -> RESULT: %zu turns, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", turnUs.size(),
+           turnUs[turnUs.size() / 2] / 1e3, turnUs[(size_t)(turnUs.size() * 0.99)] / 1e3, turnUs.back() / 1e3);
+  return divergences ? 1 : 0;
+}
+
+#endif  // STANDIN_REPLAY_H
@@ -0,0 +1,416 @@
+// Stand-in boards for load-testing the relay (src/host/relay) from one
+// Linux host, and replay of captured games.
+//
+//   standin [--relay HOST:PORT] [--pairs N] [--table T] [--duration S]
+//           [--rate R] [--seed N]
+//   standin --replay FILE [--board A|B] [--target HOST:PORT] [--bind PORT]
+//           [--speed X]
+//
+// Each board has its own UDP socket, so the relay sees --pairs pairs of
+// distinct endpoints; pair i registers for table T + i. A board behaves
+// like the firmware on the wire: HELLO every RELAY_HELLO_MS until paired,
+// a PING every second answered by the other board's PONG, and SHOT/RESULT
+// over the same reliable link (reliable.h) with its ACKs and retransmits.
+//
+// The pairs play scripted games: each board places the GAME_PRESET fleet
+// at random and fires at the other in a shuffled order, turns alternating
+// as in the game, at most R shots a second per board (0 = as fast as the
+// answers come). The board that loses starts the next game with new
+// fleets on both sides. As the stand-in runs both boards of a pair it
+// checks the protocol state every game message implies and counts
+// divergences: a SHOT must reach a board that is waiting for one, at a
+// cell not yet shot at this game; a RESULT must reach a board with a shot
+// pending and match the target's fleet as it was when the shot was fired.
+//
+// Reports throughput, pairing time, SHOT -> RESULT turn latency seen by
+// the shooting board across all pairs, and the divergences.
+//
+// --replay instead plays one board of a capture (sim --capture, or
+// tools/logdecode.py --capture from a CAPTURE=1 board) against --target;
+// see replay.h.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../../board_config.h"
+#include "../../reliable.h"
+#include "replay.h"
+
+static const uint32_t RELAY_HELLO_MS = 1000;
+static const uint32_t PING_MS = 1000;
+static const int CELLS = GameBoard::cells;
+
+enum Turn : uint8_t { TURN_NONE, TURN_AIM, TURN_AWAIT_RESULT, TURN_WAIT_SHOT };
+
+struct Board {
+  int fd;
+  uint16_t table;
+  ReliableLink link;
+  bool paired;
+  uint8_t role;
+  uint64_t startUs, pairedUs;  // first HELLO, first PAIRED answer
+  uint32_t helloAt, pingAt;
+  uint32_t rng;
+  // Game state
+  Turn turn;
+  uint8_t fleet[CELLS];         // boat index + 1, 0 = water
+  bool shotAt[CELLS];           // cells the opponent has fired at
+  uint8_t boatHits[GameFleet::count];
+  uint8_t script[CELLS];        // cells to fire at, in order
+  uint16_t scriptPos;
+  uint8_t sunk;                 // opponent boats sunk
+  uint8_t expected;             // RESULT due for the shot in flight
+  uint64_t shotAtUs;
+  uint32_t nextShotAt;
+};
+
+enum Divergence { DIV_SHOT_OUT_OF_TURN, DIV_SHOT_REPEATED, DIV_RESULT_UNEXPECTED, DIV_RESULT_WRONG, DIV_COUNT };
+static const char *const DIVERGENCE_NAMES[DIV_COUNT] = {"SHOT out of turn", "SHOT at a cell already shot",
+                                                        "RESULT with no shot pending", "RESULT not matching the fleet"};
+
+struct Stats {
+  std::vector<uint32_t> turnUs, pairUs;
+  uint64_t packetsOut = 0, packetsIn = 0, sendErrors = 0;
+  uint64_t games = 0;
+  uint64_t divergences[DIV_COUNT] = {};
+  bool diverged = false;
+};
+
+static sockaddr_in relayAddr;
+static Board *sending;  // board whose link is calling sendFromBoard
+static Board *boardsBase;
+static Stats stats;
+static uint32_t periodMs;
+
+static uint64_t monoUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static uint32_t nextRandom(uint32_t &s) {
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+static Board &partnerOf(Board &b) { return boardsBase[(&b - boardsBase) ^ 1]; }
+
+static void diverge(Board &b, Divergence kind, const char *detail) {
+  if (!stats.diverged)
+    printf("first divergence: table %u, board %u: %s (%s)\n", b.table, b.role, DIVERGENCE_NAMES[kind], detail);
+  stats.diverged = true;
+  stats.divergences[kind]++;
+}
+
+static int cellOf(int x, int y, int i, bool across) {
+  return (y + (across ? 0 : i)) * GameBoard::width + x + (across ? i : 0);
+}
+
+// A fresh fleet for the next game.
+static void newFleet(Board &b) {
+  memset(b.fleet, 0, sizeof(b.fleet));
+  memset(b.shotAt, 0, sizeof(b.shotAt));
+  memset(b.boatHits, 0, sizeof(b.boatHits));
+  for (uint8_t boat = 0; boat < GameFleet::count; boat++) {
+    int size = GameFleet::sizes[boat];
+    for (;;) {
+      bool across = nextRandom(b.rng) & 1;
+      int x = (int)(nextRandom(b.rng) % (across ? GameBoard::width - size + 1 : GameBoard::width));
+      int y = (int)(nextRandom(b.rng) % (across ? GameBoard::height : GameBoard::height - size + 1));
+      bool clear = true;
+      for (int i = 0; i < size; i++) clear = clear && !b.fleet[cellOf(x, y, i, across)];
+      if (!clear) continue;
+      for (int i = 0; i < size; i++) b.fleet[cellOf(x, y, i, across)] = boat + 1;
+      break;
+    }
+  }
+}
+
+// A fresh firing order for the next game.
+static void newScript(Board &b) {
+  for (int i = 0; i < CELLS; i++) b.script[i] = (uint8_t)i;
+  for (int i = CELLS - 1; i > 0; i--) std::swap(b.script[i], b.script[nextRandom(b.rng) % (i + 1)]);
+  b.scriptPos = 0;
+  b.sunk = 0;
+}
+
+// How b answers a shot at cell, as onShotMessage does: each cell counts
+// once towards sinking its boat.
+static uint8_t answer(Board &b, int cell, bool apply) {
+  uint8_t boat = b.fleet[cell];
+  if (!boat) return RESULT_MISS;
+  uint8_t hits = b.boatHits[boat - 1] + (b.shotAt[cell] ? 0 : 1);
+  if (apply) b.boatHits[boat - 1] = hits;
+  return hits >= GameFleet::sizes[boat - 1] ? RESULT_SINK : RESULT_HIT;
+}
+
+static bool fleetSunk(const Board &b) {
+  for (uint8_t i = 0; i < GameFleet::count; i++)
+    if (b.boatHits[i] < GameFleet::sizes[i]) return false;
+  return true;
+}
+
+static void sendFrom(Board &b, const uint8_t *data, uint8_t len) {
+  if (sendto(b.fd, data, len, 0, (const sockaddr *)&relayAddr, sizeof(relayAddr)) < 0) stats.sendErrors++;
+  else stats.packetsOut++;
+}
+
+static void sendFromBoard(const uint8_t *data, uint8_t len) { sendFrom(*sending, data, len); }
+
+static void sendPlain(Board &b, const Message &m) {
+  uint8_t buf[WIRE_MAX_LEN];
+  sendFrom(b, buf, encodeMessage(m, buf));
+}
+
+static void sendReliable(Board &b, const Message &m, uint32_t nowMs) {
+  sending = &b;
+  rlSend(b.link, m, nowMs);
+}
+
+static void onShot(Board &b, const Message &msg, uint32_t nowMs) {
+  char detail[16];
+  snprintf(detail, sizeof(detail), "%u,%u", msg.x, msg.y);
+  // TURN_NONE: the relay's pairing notice may still be on its way
+  if (b.turn != TURN_WAIT_SHOT && b.turn != TURN_NONE) diverge(b, DIV_SHOT_OUT_OF_TURN, detail);
+  if (msg.x >= GameBoard::width || msg.y >= GameBoard::height) return;
+  int cell = msg.y * GameBoard::width + msg.x;
+  if (b.shotAt[cell]) diverge(b, DIV_SHOT_REPEATED, detail);
+  Message result = makeMessage(MSG_RESULT);
+  result.result = answer(b, cell, true);
+  b.shotAt[cell] = true;
+  sendReliable(b, result, nowMs);
+  if (fleetSunk(b)) {
+    // Lost: both fleets are renewed now, before this board opens the next
+    // game, as the winner cannot have been shot at since its last turn
+    newFleet(b);
+    newFleet(partnerOf(b));
+    newScript(b);
+  }
+  b.turn = TURN_AIM;
+  b.nextShotAt = nowMs + periodMs;
+}
+
+static void onResult(Board &b, const Message &msg, uint64_t nowUs) {
+  if (b.turn != TURN_AWAIT_RESULT) {
+    diverge(b, DIV_RESULT_UNEXPECTED, resultName(msg.result));
+    return;
+  }
+  stats.turnUs.push_back((uint32_t)(nowUs - b.shotAtUs));
+  if (msg.result != b.expected) {
+    char detail[32];
+    snprintf(detail, sizeof(detail), "%s, expected %s", resultName(msg.result), resultName(b.expected));
+    diverge(b, DIV_RESULT_WRONG, detail);
+  }
+  if (msg.result == RESULT_SINK && ++b.sunk == GameFleet::count) {
+    stats.games++;
+    newScript(b);
+  }
+  b.turn = TURN_WAIT_SHOT;
+}
+
+static void receive(Board &b, const uint8_t *data, int len, uint64_t nowUs) {
+  uint32_t nowMs = (uint32_t)(nowUs / 1000);
+  Message msg;
+  stats.packetsIn++;
+  if (!decodeMessage(data, len, msg)) return;
+  switch (msg.type) {
+    case MSG_HELLO:
+      if (msg.relayState == RELAY_PAIRED && !b.pairedUs) b.pairedUs = nowUs;
+      b.paired = msg.relayState == RELAY_PAIRED;
+      b.role = msg.role;
+      if (b.paired && b.turn == TURN_NONE) {
+        b.turn = b.role == 0 ? TURN_AIM : TURN_WAIT_SHOT;
+        b.nextShotAt = nowMs;
+      }
+      return;
+    case MSG_PING: {
+      Message pong = makeMessage(MSG_PONG);
+      pong.value = nowMs;
+      pong.echo = msg.value;
+      sendPlain(b, pong);
+      return;
+    }
+    case MSG_PONG:
+      rlSampleRtt(b.link, nowMs - msg.echo);
+      return;
+  }
+  sending = &b;
+  if (!rlReceive(b.link, msg, nowMs)) return;
+  do {
+    if (msg.type == MSG_SHOT) onShot(b, msg, nowMs);
+    else if (msg.type == MSG_RESULT) onResult(b, msg, nowUs);
+  } while (rlNextHeld(b.link, msg));
+}
+
+static uint32_t percentile(std::vector<uint32_t> &v, double p) {
+  if (v.empty()) return 0;
+  size_t i = (size_t)(p * (v.size() - 1));
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return v[i];
+}
+
+// Timers of one board: HELLO while unpaired, PING, its next shot and
+// retransmits.
+static void tick(Board &b, uint64_t nowUs) {
+  uint32_t nowMs = (uint32_t)(nowUs / 1000);
+  sending = &b;
+  if (!b.paired) {
+    if (!b.startUs || nowMs - b.helloAt >= RELAY_HELLO_MS) {
+      if (!b.startUs) b.startUs = nowUs;
+      Message hello = makeMessage(MSG_HELLO);
+      hello.table = b.table;
+      sendPlain(b, hello);
+      b.helloAt = nowMs;
+    }
+    return;
+  }
+  if (nowMs - b.pingAt >= PING_MS) {
+    Message ping = makeMessage(MSG_PING);
+    ping.value = nowMs;
+    sendPlain(b, ping);
+    b.pingAt = nowMs;
+  }
+  if (b.turn == TURN_AIM && (int32_t)(nowMs - b.nextShotAt) >= 0 && b.scriptPos < CELLS) {
+    int cell = b.script[b.scriptPos++];
+    Message shot = makeMessage(MSG_SHOT);
+    shot.x = (uint8_t)(cell % GameBoard::width);
+    shot.y = (uint8_t)(cell / GameBoard::width);
+    // The target has answered every earlier shot, so its fleet is as it
+    // will be when this one arrives
+    b.expected = answer(partnerOf(b), cell, false);
+    b.turn = TURN_AWAIT_RESULT;
+    b.shotAtUs = nowUs;
+    sendReliable(b, shot, nowMs);
+  }
+  rlPoll(b.link, nowMs);
+}
+
+static bool parseAddress(const std::string &text, sockaddr_in &addr) {
+  size_t colon = text.rfind(':');
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(colon == std::string::npos ? 9999 : (uint16_t)atoi(text.c_str() + colon + 1));
+  return inet_pton(AF_INET, text.substr(0, colon).c_str(), &addr.sin_addr) == 1;
+}
+
+int main(int argc, char **argv) {
+  std::string relay = "127.0.0.1:9999", target = "127.0.0.1:8888";
+  int pairs = 100;
+  unsigned table = 1;
+  uint32_t seed = 1;
+  double duration = 10, rate = 2;
+  ReplayOptions replay;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--relay")) relay = argv[i + 1];
+    else if (!strcmp(argv[i], "--pairs")) pairs = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--table")) table = (unsigned)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--duration")) duration = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--rate")) rate = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "--seed")) seed = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    else if (!strcmp(argv[i], "--replay")) replay.path = argv[i + 1];
+    else if (!strcmp(argv[i], "--board")) replay.board = (argv[i + 1][0] | 0x20) == 'b' ? CAPTURE_BOARD_B : 0;
+    else if (!strcmp(argv[i], "--target")) target = argv[i + 1];
+    else if (!strcmp(argv[i], "--bind")) replay.bindPort = (uint16_t)atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--speed")) replay.speed = atof(argv[i + 1]);
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (replay.path) {
+    if (!parseAddress(target, replay.target) || replay.speed <= 0) {
+      fprintf(stderr, "bad --target or --speed\n");
+      return 2;
+    }
+    return runReplay(replay);
+  }
+  if (pairs < 1 || table + pairs > 0x10000 || !parseAddress(relay, relayAddr)) {
+    fprintf(stderr, "bad --relay, --pairs or --table\n");
+    return 2;
+  }
+  periodMs = rate > 0 ? (uint32_t)(1000 / rate) : 0;
+
+  int epfd = epoll_create1(0);
+  std::vector<Board> boards(2 * pairs);
+  boardsBase = boards.data();
+  for (size_t i = 0; i < boards.size(); i++) {
+    Board &b = boards[i];
+    memset(&b, 0, sizeof(b));
+    b.table = (uint16_t)(table + i / 2);
+    b.rng = seed * 2654435761u + (uint32_t)i * 40503u + 1;
+    rlInit(b.link, sendFromBoard);
+    newFleet(b);
+    newScript(b);
+    b.fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (b.fd < 0) {
+      perror("standin: socket (raise ulimit -n?)");
+      return 1;
+    }
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &b;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, b.fd, &ev);
+  }
+
+  uint64_t start = monoUs(), end = start + (uint64_t)(duration * 1e6), lastTick = 0;
+  uint8_t buf[512];
+  std::vector<epoll_event> events(256);
+  for (uint64_t now = start; now < end; now = monoUs()) {
+    // Timers run every 2 ms, packets as they come
+    if (now - lastTick >= 2000) {
+      for (Board &b : boards) tick(b, now);
+      lastTick = now;
+    }
+    int n = epoll_wait(epfd, events.data(), (int)events.size(), 1);
+    for (int i = 0; i < n; i++) {
+      Board &b = *(Board *)events[i].data.ptr;
+      int len;
+      while ((len = (int)recv(b.fd, buf, sizeof(buf), 0)) > 0) receive(b, buf, len, monoUs());
+    }
+  }
+
+  int paired = 0, unanswered = 0;
+  uint64_t retransmits = 0, refused = 0, divergences = 0;
+  for (Board &b : boards) {
+    if (b.pairedUs) {
+      paired++;
+      stats.pairUs.push_back((uint32_t)(b.pairedUs - b.startUs));
+    }
+    if (b.turn == TURN_AWAIT_RESULT) unanswered++;
+    retransmits += b.link.stats.retransmits;
+    refused += b.link.stats.refused;
+  }
+  for (uint64_t d : stats.divergences) divergences += d;
+  printf("%d pairs over %s, %.1f s, up to %.1f shots/s per board, %ux%u board\n", pairs, relay.c_str(), duration,
+         rate, GameBoard::width, GameBoard::height);
+  printf("traffic   %llu packets out, %llu in (%.0f packets/s)\n", (unsigned long long)stats.packetsOut,
+         (unsigned long long)stats.packetsIn, (stats.packetsOut + stats.packetsIn) / duration);
+  printf("paired    %d of %zu boards  p50 %.1f ms  p99 %.1f ms  max %.1f ms\n", paired, boards.size(),
+         percentile(stats.pairUs, 0.5) / 1e3, percentile(stats.pairUs, 0.99) / 1e3,
+         percentile(stats.pairUs, 1.0) / 1e3);
+  printf("turns     %zu (%.0f/s), %llu games  p50 %.2f ms  p99 %.2f ms  p99.9 %.2f ms  max %.2f ms\n",
+         stats.turnUs.size(), stats.turnUs.size() / duration, (unsigned long long)stats.games,
+         percentile(stats.turnUs, 0.5) / 1e3, percentile(stats.turnUs, 0.99) / 1e3,
+         percentile(stats.turnUs, 0.999) / 1e3, percentile(stats.turnUs, 1.0) / 1e3);
+  printf("link      %llu retransmits, %llu refused, %d turns unanswered at the end, %llu send errors\n",
+         (unsigned long long)retransmits, (unsigned long long)refused, unanswered,
+         (unsigned long long)stats.sendErrors);
+  printf("diverged  %llu", (unsigned long long)divergences);
+  for (int k = 0; k < DIV_COUNT; k++)
+    if (stats.divergences[k]) printf(", %llu %s", (unsigned long long)stats.divergences[k], DIVERGENCE_NAMES[k]);
+  printf("\n");
+  for (Board &b : boards) close(b.fd);
+  return paired == (int)boards.size() && !divergences ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+// Headless AI-vs-AI tournament: plays many games between two AiPlayers on
+// every core and reports throughput, how many shots the winner needed and
+// how often the first mover wins.
+//
+//   tournament [--games N] [--threads N] [--seed N] [--depth-a D]
+//              [--depth-b D] [--place-ms MIN:MAX] [--chunk N]
+//
+// Board, fleet and rules come from the firmware headers (one preset per
+// build, -D GAME_PRESET=...). Who shoots first is decided by the firmware's
+// READY rule (shootsFirst) from a placement finishing time drawn per side
+// from --place-ms. Both sides share one clock (offset 0); equal times are
+// a tie, which the firmware gives to the board with the lower address (A
+// here), so ties are also counted separately.
+//
+// Every game's seeds come from the game index, so results do not depend on
+// the thread count. Work is handed out in chunks of games: each thread
+// takes from the front of its own range and, when that runs dry, steals
+// the back half of the largest remaining range.
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <IPAddress.h>
+#include <WiFiNINA.h>
+#include <WiFiUdp.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../game_logic.h"
+#include "../../ai_player.h"
+
+// Definitions the firmware headers declare extern; never used here
+CRGB leds[NUM_LEDS];
+WiFiUDP udp;
+
+static const int MAX_SHOTS = GameBoard::cells;
+
+struct Options {
+  uint64_t games = 1000000;
+  unsigned threads = 0;  // 0 = one per core
+  uint64_t seed = 1;
+  uint8_t depthA = AI_DEPTH_FULL, depthB = AI_DEPTH_FULL;
+  uint32_t placeMinMs = 5000, placeMaxMs = 60000;
+  uint64_t chunk = 256;
+};
+
+static uint64_t splitmix64(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Totals for one thread; merged at the end.
+struct Tally {
+  uint64_t games = 0, winsA = 0, winsFirst = 0, ties = 0;
+  uint64_t shotsToWin[MAX_SHOTS + 1] = {};
+
+  void merge(const Tally &o) {
+    games += o.games, winsA += o.winsA, winsFirst += o.winsFirst, ties += o.ties;
+    for (int i = 0; i <= MAX_SHOTS; i++) shotsToWin[i] += o.shotsToWin[i];
+  }
+};
+
+// Per-thread arena: both players and the tally live here for the whole
+// run, so playing a game allocates nothing. Padded to its own cache lines.
+struct alignas(64) Worker {
+  AiPlayer players[2];
+  uint64_t rng;  // per-thread generator, reseeded for every game
+  Tally tally;
+  std::mutex lock;
+  uint64_t next = 0, end = 0;  // unplayed games [next, end)
+};
+
+static void playGame(const Options &opt, Worker &w, uint64_t index) {
+  w.rng = opt.seed * 0x100000001B3ULL + index;
+  AiPlayer &a = w.players[0], &b = w.players[1];
+  aiBegin(a, (uint32_t)splitmix64(w.rng) | 1, opt.depthA);
+  aiBegin(b, (uint32_t)splitmix64(w.rng) | 1, opt.depthB);
+
+  uint32_t span = opt.placeMaxMs - opt.placeMinMs + 1;
+  unsigned long doneA = opt.placeMinMs + (uint32_t)(splitmix64(w.rng) % span);
+  unsigned long doneB = opt.placeMinMs + (uint32_t)(splitmix64(w.rng) % span);
+  bool aFirst = shootsFirst(doneA, 0, doneB, 0, true);
+  if (doneA == doneB) w.tally.ties++;
+
+  // players[turn] shoots at players[turn ^ 1]
+  int turn = aFirst ? 0 : 1, first = turn;
+  int x, y;
+  for (;;) {
+    AiPlayer &shooter = w.players[turn], &target = w.players[turn ^ 1];
+    if (!aiChooseShot(shooter, x, y)) break;  // cannot happen: a fleet sinks first
+    aiOnResult(shooter, aiAnswerShot(target, x, y));
+    if (aiFleetSunk(target)) break;
+    turn ^= 1;
+  }
+  w.tally.games++;
+  if (turn == 0) w.tally.winsA++;
+  if (turn == first) w.tally.winsFirst++;
+  w.tally.shotsToWin[std::min<int>(w.players[turn].shots, MAX_SHOTS)]++;
+}
+
+// Take up to chunk games from the front of w's own range.
+static bool takeOwn(Worker &w, uint64_t chunk, uint64_t &from, uint64_t &to) {
+  std::lock_guard<std::mutex> guard(w.lock);
+  if (w.next >= w.end) return false;
+  from = w.next;
+  to = std::min(w.end, from + chunk);
+  w.next = to;
+  return true;
+}
+
+// Move the back half of the largest other range to self.
+static bool steal(std::vector<Worker> &workers, Worker &self) {
+  Worker *victim = nullptr;
+  uint64_t most = 0;
+  for (Worker &w : workers) {
+    if (&w == &self) continue;
+    std::lock_guard<std::mutex> guard(w.lock);
+    if (w.end - w.next > most) most = w.end - w.next, victim = &w;
+  }
+  if (!victim) return false;
+  uint64_t from, to;
+  {
+    std::lock_guard<std::mutex> guard(victim->lock);
+    uint64_t left = victim->end - victim->next;
+    if (!left) return true;  // drained meanwhile; look again
+    from = victim->end - (left + 1) / 2;
+    to = victim->end;
+    victim->end = from;
+  }
+  std::lock_guard<std::mutex> guard(self.lock);
+  self.next = from, self.end = to;
+  return true;
+}
+
+static void runWorker(const Options &opt, std::vector<Worker> &workers, Worker &self) {
+  uint64_t from, to;
+  for (;;) {
+    if (takeOwn(self, opt.chunk, from, to)) {
+      for (uint64_t i = from; i < to; i++) playGame(opt, self, i);
+      continue;
+    }
+    if (!steal(workers, self)) return;
+  }
+}
+
+static uint64_t percentile(const Tally &t, double p) {
+  uint64_t want = (uint64_t)(p * (double)t.games), seen = 0;
+  for (int i = 0; i <= MAX_SHOTS; i++) {
+    seen += t.shotsToWin[i];
+    if (seen > want) return (uint64_t)i;
+  }
+  return MAX_SHOTS;
+}
+
+static void printHistogram(const Tally &t) {
+  int lo = MAX_SHOTS, hi = 0;
+  for (int i = 0; i <= MAX_SHOTS; i++)
+    if (t.shotsToWin[i]) lo = std::min(lo, i), hi = std::max(hi, i);
+  if (lo > hi) return;
+  const int ROWS = 24, BAR = 50;
+  int width = std::max(1, (hi - lo + ROWS) / ROWS);
+  std::vector<uint64_t> rows;
+  for (int start = lo; start <= hi; start += width) {
+    uint64_t n = 0;
+    for (int i = start; i < start + width && i <= hi; i++) n += t.shotsToWin[i];
+    rows.push_back(n);
+  }
+  uint64_t peak = *std::max_element(rows.begin(), rows.end());
+  for (size_t r = 0; r < rows.size(); r++) {
+    int start = lo + (int)r * width;
+    printf("  %3d-%-3d %7.3f%% %s\n", start, std::min(start + width - 1, hi), 100.0 * rows[r] / t.games,
+           std::string((size_t)(BAR * rows[r] / peak), '#').c_str());
+  }
+}
+
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string o = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : "";
+    if (o == "--games") opt.games = strtoull(val, nullptr, 10), i++;
+    else if (o == "--threads") opt.threads = (unsigned)atoi(val), i++;
+    else if (o == "--seed") opt.seed = strtoull(val, nullptr, 10), i++;
+    else if (o == "--depth-a") opt.depthA = (uint8_t)atoi(val), i++;
+    else if (o == "--depth-b") opt.depthB = (uint8_t)atoi(val), i++;
+    else if (o == "--place-ms") sscanf(val, "%u:%u", &opt.placeMinMs, &opt.placeMaxMs), i++;
+    else if (o == "--chunk") opt.chunk = std::max<uint64_t>(1, strtoull(val, nullptr, 10)), i++;
+    else {
+      fprintf(stderr, "unknown option %s\n", o.c_str());
+      return 2;
+    }
+  }
+  if (opt.placeMaxMs < opt.placeMinMs) std::swap(opt.placeMinMs, opt.placeMaxMs);
+  if (!opt.threads) opt.threads = std::max(1u, std::thread::hardware_concurrency());
+
+  // Split the games evenly; stealing evens out the rest
+  std::vector<Worker> workers(opt.threads);
+  for (unsigned i = 0; i < opt.threads; i++) {
+    workers[i].next = opt.games * i / opt.threads;
+    workers[i].end = opt.games * (i + 1) / opt.threads;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < opt.threads; i++)
+    threads.emplace_back(runWorker, std::cref(opt), std::ref(workers), std::ref(workers[i]));
+  for (std::thread &t : threads) t.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  Tally total;
+  for (Worker &w : workers) total.merge(w.tally);
+  if (!total.games) return 1;
+
+  double meanShots = 0;
+  for (int i = 0; i <= MAX_SHOTS; i++) meanShots += (double)i * total.shotsToWin[i];
+  meanShots /= (double)total.games;
+
+  printf("%dx%d, fleet of %d (%d cells), depth A %u / B %u\n", WIDTH, HEIGHT, GameFleet::count,
+         GameFleet::cells, opt.depthA, opt.depthB);
+  printf("games        %llu on %u threads in %.2f s: %.0f games/s\n", (unsigned long long)total.games,
+         opt.threads, seconds, total.games / seconds);
+  printf("wins         A %.2f%%  B %.2f%%\n", 100.0 * total.winsA / total.games,
+         100.0 * (total.games - total.winsA) / total.games);
+  printf("first mover  wins %.2f%% (READY ties: %llu, %.3f%%)\n", 100.0 * total.winsFirst / total.games,
+         (unsigned long long)total.ties, 100.0 * total.ties / total.games);
+  int minShots = MAX_SHOTS, maxShots = 0;
+  for (int i = 0; i <= MAX_SHOTS; i++)
+    if (total.shotsToWin[i]) minShots = std::min(minShots, i), maxShots = std::max(maxShots, i);
+  printf("shots to win mean %.2f  min %d  p50 %llu  p90 %llu  p99 %llu  max %d\n", meanShots, minShots,
+         (unsigned long long)percentile(total, 0.5), (unsigned long long)percentile(total, 0.9),
+         (unsigned long long)percentile(total, 0.99), maxShots);
+  printHistogram(total);
+  return 0;
+}
@@ -1,17 +1,193 @@
 #pragma once
 #include <Arduino.h>
 
-// Inline means: defined in header, compiled into any file that includes it
-inline void readJoystick(int& x, int& y, int& button) {
-    x = 0;
-    y = 0;
-    button = 0;
-    int valueX = analogRead(A0);  // Read X axis
-    int valueY = analogRead(A1);  // Read Y axis
-    if(valueX < 400) x = 1;
-    if(valueX > 600 && valueX < 850) x = -1;
-    if(valueY < 400) y = 1;
-    if(valueY > 600) y = -1;
-    if(valueX > 850) button = 1;
+// Joystick input as a queue of timestamped events. The stick's X axis also
+// carries the button: X above ~850 is a press, 600..850 is left. Each
+// sample is classified with hysteresis and a change only counts once it has
+// held for JOY_DEBOUNCE_MS; the event then carries the time the change
+// started, so press lengths and input latency do not depend on how often
+// the game looks at the queue.
+//
+// A held direction repeats after JOY_REPEAT_DELAY_MS, starting every
+// JOY_REPEAT_START_MS and speeding up to every JOY_REPEAT_MIN_MS.
+//
+// On the board ADC0 samples in the background: each result interrupt
+// reads one axis (16 conversions accumulated) and starts the other, about
+// every 8 ms per axis. analogRead() must not be used once joystickBegin()
+// has run. Other targets poll: call joystickPoll() every few ms.
 
+enum JoyEventKind : uint8_t { JOY_MOVE, JOY_PRESS, JOY_RELEASE };
+
+struct JoyEvent {
+    uint8_t kind;
+    int8_t dx, dy;       // JOY_MOVE: one cell
+    uint16_t heldMs;     // JOY_RELEASE: how long the button was down
+    unsigned long atMs;  // when the move or edge happened
+};
+
+static const unsigned long JOY_DEBOUNCE_MS = 10;
+static const unsigned long JOY_REPEAT_DELAY_MS = 350;
+static const uint16_t JOY_REPEAT_START_MS = 160;
+static const uint16_t JOY_REPEAT_MIN_MS = 40;
+
+// Thresholds: a direction is entered past ENTER and left again only once
+// back past EXIT
+static const int JOY_LOW_ENTER = 400, JOY_LOW_EXIT = 430;
+static const int JOY_HIGH_ENTER = 600, JOY_HIGH_EXIT = 570;
+static const int JOY_BUTTON_ENTER = 850, JOY_BUTTON_EXIT = 820;
+
+static const uint8_t JOY_QUEUE_SIZE = 8;  // power of two
+
+// One debounced input: an axis (-1/0/+1) or the button (0/1)
+struct JoyInput {
+    int8_t raw;             // latest sample
+    int8_t stable;          // debounced
+    unsigned long rawSinceMs;
+    unsigned long nextRepeatMs;
+    uint16_t repeatMs;
+};
+
+static JoyInput joyX, joyY, joyButton;
+static JoyEvent joyQueue[JOY_QUEUE_SIZE];
+static volatile uint8_t joyHead = 0, joyTail = 0;
+static volatile bool joyHeld = false;
+static unsigned long joyPressedAtMs = 0;
+static uint16_t joyDropped = 0;
+
+// Events are written by the ADC interrupt and read by the main loop; keep
+// the compiler from moving slot accesses across the index updates
+#define JOY_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+inline void joyPush(uint8_t kind, int8_t dx, int8_t dy, unsigned long atMs, uint16_t heldMs = 0) {
+    uint8_t next = (joyHead + 1) & (JOY_QUEUE_SIZE - 1);
+    if (next == joyTail) {
+        joyDropped++;
+        return;
+    }
+    JoyEvent &e = joyQueue[joyHead];
+    e.kind = kind;
+    e.dx = dx;
+    e.dy = dy;
+    e.heldMs = heldMs;
+    e.atMs = atMs;
+    JOY_BARRIER();
+    joyHead = next;
+}
+
+// Take the oldest event. Returns false when there is none.
+inline bool joystickNext(JoyEvent &e) {
+    uint8_t tail = joyTail;
+    if (tail == joyHead) return false;
+    JOY_BARRIER();
+    e = joyQueue[tail];
+    JOY_BARRIER();
+    joyTail = (tail + 1) & (JOY_QUEUE_SIZE - 1);
+    return true;
+}
+
+// Button is down (debounced)
+inline bool joystickHeld() {
+    return joyHeld;
+}
+
+// -1 below the low threshold, +1 above the high one, with hysteresis
+// around the current state
+inline int8_t joyClassify(int value, int8_t current, int highEnter, int highExit) {
+    if (value < (current < 0 ? JOY_LOW_EXIT : JOY_LOW_ENTER)) return -1;
+    if (value > (current > 0 ? highExit : highEnter)) return 1;
+    return 0;
+}
+
+// Feed one sample into in. Returns true when its debounced state changed.
+inline bool joyDebounce(JoyInput &in, int8_t raw, unsigned long now) {
+    if (raw != in.raw) {
+        in.raw = raw;
+        in.rawSinceMs = now;
+    }
+    if (in.raw == in.stable || now - in.rawSinceMs < JOY_DEBOUNCE_MS) return false;
+    in.stable = in.raw;
+    in.nextRepeatMs = in.rawSinceMs + JOY_REPEAT_DELAY_MS;
+    in.repeatMs = JOY_REPEAT_START_MS;
+    return true;
+}
+
+// Move events for a direction that just settled or is still held
+inline void joyMoves(JoyInput &in, bool changed, bool isX, unsigned long now) {
+    if (!in.stable) return;
+    // Low readings are right/down on this stick
+    int8_t d = (int8_t)-in.stable;
+    if (changed) joyPush(JOY_MOVE, isX ? d : 0, isX ? 0 : d, in.rawSinceMs);
+    while ((long)(now - in.nextRepeatMs) >= 0) {
+        joyPush(JOY_MOVE, isX ? d : 0, isX ? 0 : d, in.nextRepeatMs);
+        in.nextRepeatMs += in.repeatMs;
+        uint16_t faster = in.repeatMs - in.repeatMs / 4;
+        in.repeatMs = faster < JOY_REPEAT_MIN_MS ? JOY_REPEAT_MIN_MS : faster;
+    }
 }
+
+inline void joySampleX(int value, unsigned long now) {
+    int8_t button = value > (joyButton.raw ? JOY_BUTTON_EXIT : JOY_BUTTON_ENTER);
+    // The button reading passes through "left" on its way up and down;
+    // the debounce keeps that from becoming a move
+    int8_t x = button ? 0 : joyClassify(value, joyX.raw, JOY_HIGH_ENTER, JOY_HIGH_EXIT);
+    if (joyDebounce(joyButton, button, now)) {
+        if (joyButton.stable) {
+            joyPressedAtMs = joyButton.rawSinceMs;
+            joyHeld = true;
+            joyPush(JOY_PRESS, 0, 0, joyPressedAtMs);
+        } else {
+            unsigned long held = joyButton.rawSinceMs - joyPressedAtMs;
+            joyHeld = false;
+            joyPush(JOY_RELEASE, 0, 0, joyButton.rawSinceMs, held > 0xFFFF ? 0xFFFF : (uint16_t)held);
+        }
+    }
+    joyMoves(joyX, joyDebounce(joyX, x, now), true, now);
+}
+
+inline void joySampleY(int value, unsigned long now) {
+    int8_t y = joyClassify(value, joyY.raw, JOY_HIGH_ENTER, JOY_HIGH_EXIT);
+    joyMoves(joyY, joyDebounce(joyY, y, now), false, now);
+}
+
+#ifdef __AVR__
+
+static volatile uint8_t joyAdcAxis = 0;  // 0 = X (A0), 1 = Y (A1)
+
+inline uint8_t joyMux(uint8_t axis) {
+    return (uint8_t)(digitalPinToAnalogInput(axis ? A1 : A0) << ADC_MUXPOS_gp);
+}
+
+inline void joystickBegin() {
+    ADC0.CTRLA = ADC_RESSEL_10BIT_gc;
+    ADC0.CTRLB = ADC_SAMPNUM_ACC16_gc;
+    ADC0.CTRLC = ADC_PRESC_DIV256_gc | ADC_REFSEL_VDDREF_gc | ADC_SAMPCAP_bm;
+    ADC0.MUXPOS = joyMux(0);
+    ADC0.INTCTRL = ADC_RESRDY_bm;
+    ADC0.CTRLA |= ADC_ENABLE_bm;
+    ADC0.COMMAND = ADC_STCONV_bm;
+}
+
+inline void joystickPoll() {}
+
+ISR(ADC0_RESRDY_vect) {
+    int value = ADC0.RES >> 4;  // mean of the 16 accumulated conversions
+    uint8_t axis = joyAdcAxis;
+    joyAdcAxis = axis ^ 1;
+    ADC0.MUXPOS = joyMux(axis ^ 1);
+    ADC0.COMMAND = ADC_STCONV_bm;
+    unsigned long now = millis();
+    if (axis) joySampleY(value, now);
+    else joySampleX(value, now);
+}
+
+#else
+
+inline void joystickBegin() {}
+
+inline void joystickPoll() {
+    unsigned long now = millis();
+    joySampleX(analogRead(A0), now);
+    joySampleY(analogRead(A1), now);
+}
+
+#endif
@@ -2,15 +2,55 @@
 #define LED_MATRIX_H
 
 #include <FastLED.h>
+#include <string.h>
+#include "board_config.h"
 
 #define LED_PIN     6
-#define WIDTH       16
-#define HEIGHT      16
-#define NUM_LEDS    (WIDTH * HEIGHT)
+#define MATRIX_WIDTH  16
+#define MATRIX_HEIGHT 16
+#define NUM_LEDS    (MATRIX_WIDTH * MATRIX_HEIGHT)
 #define COLOR_ORDER GRB
 
+// Smaller boards are drawn centred on the matrix.
+static_assert(WIDTH <= MATRIX_WIDTH && HEIGHT <= MATRIX_HEIGHT, "board is larger than the LED matrix");
+#define BOARD_OFFSET_X ((MATRIX_WIDTH - WIDTH) / 2)
+#define BOARD_OFFSET_Y ((MATRIX_HEIGHT - HEIGHT) / 2)
+
 extern CRGB leds[NUM_LEDS];  // just declare, define in main.cpp
 
+// Frame the game draws into: a 4-bit palette index per cell, two cells per
+// byte (cell y * WIDTH + x, even cells in the low nibble). showFrame()
+// expands it through `palette` into leds, so changing a palette entry
+// recolours every cell using it on the next show.
+#define PALETTE_SIZE 16
+
+struct IndexedFrame {
+  uint8_t cells[(GameBoard::cells + 1) / 2];
+};
+
+static CRGB palette[PALETTE_SIZE];  // index 0 stays black unless reloaded
+
+// Load count colours (0xRRGGBB codes stored in PROGMEM) from index 0.
+inline void loadPalette(const uint32_t *codes, uint8_t count) {
+  for (uint8_t i = 0; i < count && i < PALETTE_SIZE; i++) palette[i] = CRGB(pgm_read_dword(&codes[i]));
+}
+
+inline uint8_t frameGet(const IndexedFrame &f, int x, int y) {
+  int cell = y * WIDTH + x;
+  uint8_t packed = f.cells[cell >> 1];
+  return (cell & 1) ? (packed >> 4) : (packed & 0x0F);
+}
+
+inline void frameSet(IndexedFrame &f, int x, int y, uint8_t color) {
+  int cell = y * WIDTH + x;
+  uint8_t &packed = f.cells[cell >> 1];
+  packed = (cell & 1) ? (uint8_t)((packed & 0x0F) | (color << 4)) : (uint8_t)((packed & 0xF0) | (color & 0x0F));
+}
+
+inline void frameFill(IndexedFrame &f, uint8_t color) {
+  memset(f.cells, (color & 0x0F) * 0x11, sizeof(f.cells));
+}
+
 // Setup LEDs
 void ledSetup() {
   FastLED.addLeds<WS2812B, LED_PIN, COLOR_ORDER>(leds, NUM_LEDS);
@@ -18,22 +58,64 @@ void ledSetup() {
   FastLED.clear();
 }
 
-// Map 2D coordinates to 1D (serpentine layout)
+// LED index of matrix pixel (mx, my): even rows run left to right, odd rows
+// right to left.
+constexpr uint8_t serpentineIndex(uint16_t mx, uint16_t my) {
+  return (uint8_t)(my * MATRIX_WIDTH + (my % 2 == 0 ? mx : MATRIX_WIDTH - 1 - mx));
+}
+
+// LED index of board cell y * WIDTH + x.
+constexpr uint8_t boardCellIndex(uint16_t cell) {
+  return serpentineIndex(cell % WIDTH + BOARD_OFFSET_X, cell / WIDTH + BOARD_OFFSET_Y);
+}
+
+static_assert(NUM_LEDS <= 256, "XY table stores 8-bit LED indices");
+
+// Board cell -> LED index table, generated at compile time into flash.
+template <class Seq> struct XYTable;
+template <uint16_t... Cells> struct XYTable<IndexSeq<Cells...> > {
+  static const uint8_t index[sizeof...(Cells)];
+};
+template <uint16_t... Cells>
+const uint8_t XYTable<IndexSeq<Cells...> >::index[sizeof...(Cells)] PROGMEM = {boardCellIndex(Cells)...};
+
+typedef XYTable<MakeIndexSeq<GameBoard::cells>::type> XY_TABLE;
+
+// Map board coordinates to the LED index (serpentine layout)
 int XY(int x, int y) {
-  if (y % 2 == 0) {
-    return y * WIDTH + x;
-  } else {
-    return y * WIDTH + (WIDTH - 1 - x);
-  }
+  return pgm_read_byte(&XY_TABLE::index[y * WIDTH + x]);
 }
 
-// Display any 2D CRGB array on the LED matrix
-void showFrame(CRGB frame[WIDTH][HEIGHT]) {
-  for (int y = 0; y < HEIGHT; y++) {
-    for (int x = 0; x < WIDTH; x++) {
-      leds[XY(x, y)] = frame[x][y];
+// How often showFrame() found the LEDs already showing the frame.
+struct FrameStats {
+  uint32_t pushed;
+  uint32_t skipped;
+};
+
+static FrameStats frameStats;
+
+// Expand frame through the palette onto the LED matrix; LEDs outside the
+// board stay dark. The strip is only pushed when a pixel differs from what
+// it already shows: FastLED.show() keeps interrupts off for ~30 us per LED
+// on WS2812B.
+void showFrame(const IndexedFrame &frame) {
+  // The first frame always goes out: after a reset the strip may still
+  // show whatever the previous run left on it
+  bool changed = frameStats.pushed == 0;
+  for (uint16_t cell = 0; cell < GameBoard::cells; cell++) {
+    uint8_t packed = frame.cells[cell >> 1];
+    const CRGB &color = palette[(cell & 1) ? (packed >> 4) : (packed & 0x0F)];
+    CRGB &led = leds[pgm_read_byte(&XY_TABLE::index[cell])];
+    if (led != color) {
+      led = color;
+      changed = true;
     }
   }
+  if (!changed) {
+    frameStats.skipped++;
+    return;
+  }
+  frameStats.pushed++;
   FastLED.show();
 }
 
@@ -0,0 +1,272 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "capture.h"
+#include "log_catalog.h"
+#include "protocol.h"
+
+// Buffered serial logging. LOG(name, args...) appends one message from
+// log_catalog.h to a RAM ring buffer and returns; logFlush() drains it into
+// the serial port only as far as the TX buffer has room, so logging never
+// waits on the 9600 baud line. When the ring is full messages are dropped
+// and counted, and a DROPPED message reports them once there is room.
+//
+// Messages above LOG_LEVEL compile to nothing, arguments included. With
+// LOG_BINARY a message is a few bytes: LOG_SYNC, the catalog id and each
+// argument as a varint (strings as length + bytes); the format strings never
+// reach the board. Otherwise the text is formatted on the board from
+// formats kept in flash. Only call from the main loop, not from interrupts.
+//
+// With CAPTURE the same ring also carries captured datagrams (logPacket).
+
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE (LOG_BINARY && !CAPTURE ? 128 : 256)
+#endif
+
+static const uint8_t LOG_SYNC = 0xF5;
+static const uint8_t LOG_MAX_STRING = 32;
+static const uint8_t LOG_MAX_RECORD = 96;
+
+static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "LOG_BUFFER_SIZE must be a power of two");
+static_assert(LOG_BUFFER_SIZE >= LOG_MAX_RECORD, "LOG_BUFFER_SIZE must hold the longest message");
+static_assert(!CAPTURE || LOG_LEVEL > LOG_NONE, "CAPTURE needs the serial log");
+static_assert(4 + 2 * CAPTURE_MAX_RECORD + 2 <= LOG_MAX_RECORD, "a capture line must fit a record");
+
+#define LOG_TAG_ID(tag, text) LOG_TAG_##tag,
+enum LogTag : uint8_t { LOG_TAGS(LOG_TAG_ID) LOG_TAG_COUNT };
+#undef LOG_TAG_ID
+
+#define LOG_MSG_ID(name, level, tag, format) LOG_MSG_##name,
+enum LogMessage : uint8_t { LOG_CATALOG(LOG_MSG_ID) LOG_MSG_COUNT };
+#undef LOG_MSG_ID
+
+static_assert(LOG_MSG_COUNT < 0x80, "message ids are one byte below 0x80");
+
+// Arguments a format expects: one per % other than %%.
+constexpr uint8_t logFormatArgs(const char *format) {
+  return !*format ? 0
+         : *format != '%' ? logFormatArgs(format + 1)
+         : format[1] == '%' ? logFormatArgs(format + 2)
+         : 1 + logFormatArgs(format + 1);
+}
+
+#define LOG_MSG_INFO(name, level, tag, format) \
+  LOG_LEVEL_OF_##name = level, LOG_ARGS_OF_##name = logFormatArgs(format),
+enum LogMessageInfo { LOG_CATALOG(LOG_MSG_INFO) };
+#undef LOG_MSG_INFO
+
+// Flash copies of the texts, only referenced by the text encoder.
+#define LOG_TAG_TEXT(tag, text) static const char LOG_TAG_TEXT_##tag[] PROGMEM = text;
+LOG_TAGS(LOG_TAG_TEXT)
+#undef LOG_TAG_TEXT
+#define LOG_TAG_TEXT_ENTRY(tag, text) LOG_TAG_TEXT_##tag,
+static const char *const LOG_TAG_TEXTS[LOG_TAG_COUNT] PROGMEM = {LOG_TAGS(LOG_TAG_TEXT_ENTRY)};
+#undef LOG_TAG_TEXT_ENTRY
+
+#define LOG_FORMAT_TEXT(name, level, tag, format) static const char LOG_FORMAT_##name[] PROGMEM = format;
+LOG_CATALOG(LOG_FORMAT_TEXT)
+#undef LOG_FORMAT_TEXT
+#define LOG_FORMAT_ENTRY(name, level, tag, format) LOG_FORMAT_##name,
+static const char *const LOG_FORMATS[LOG_MSG_COUNT] PROGMEM = {LOG_CATALOG(LOG_FORMAT_ENTRY)};
+#undef LOG_FORMAT_ENTRY
+#define LOG_MSG_TAG(name, level, tag, format) LOG_TAG_##tag,
+static const uint8_t LOG_MSG_TAGS[LOG_MSG_COUNT] PROGMEM = {LOG_CATALOG(LOG_MSG_TAG)};
+#undef LOG_MSG_TAG
+
+struct LogArg {
+  uint32_t value;
+  const char *text;  // set for %s
+};
+
+inline LogArg logArg(const char *text) {
+  LogArg a = {0, text ? text : ""};
+  return a;
+}
+inline LogArg logArg(char *text) { return logArg((const char *)text); }
+template <class T>
+inline LogArg logArg(T value) {
+  LogArg a = {(uint32_t)value, 0};
+  return a;
+}
+
+static uint8_t logRing[LOG_BUFFER_SIZE];
+static uint16_t logHead = 0, logTail = 0;  // write / read positions
+static uint16_t logDropped = 0;
+
+inline uint16_t logFree() {
+  return (uint16_t)(LOG_BUFFER_SIZE - 1 - ((logHead - logTail) & (LOG_BUFFER_SIZE - 1)));
+}
+
+inline uint8_t logPutVarint(uint8_t *p, uint32_t v) {
+  uint8_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+inline uint8_t logEncodeBinary(uint8_t id, const LogArg *args, uint8_t count, uint8_t *out) {
+  uint8_t n = 0;
+  out[n++] = LOG_SYNC;
+  out[n++] = id;
+  for (uint8_t i = 0; i < count; i++) {
+    if (!args[i].text) {
+      n += logPutVarint(out + n, args[i].value);
+      continue;
+    }
+    uint8_t len = 0;
+    while (len < LOG_MAX_STRING && args[i].text[len]) len++;
+    out[n++] = len;
+    memcpy(out + n, args[i].text, len);
+    n += len;
+  }
+  return n;
+}
+
+// Append the flash string s to out, up to cap.
+inline uint8_t logPutFlash(char *out, uint8_t n, uint8_t cap, const char *s) {
+  for (char c; n < cap && (c = (char)pgm_read_byte(s)) != 0; s++) out[n++] = c;
+  return n;
+}
+
+inline uint8_t logPutText(char *out, uint8_t n, uint8_t cap, const char *s) {
+  while (n < cap && *s) out[n++] = *s++;
+  return n;
+}
+
+inline uint8_t logEncodeText(uint8_t id, const LogArg *args, uint8_t count, char *out) {
+  const uint8_t cap = LOG_MAX_RECORD - 2;  // room for "\r\n"
+  uint8_t tag = pgm_read_byte(&LOG_MSG_TAGS[id]);
+  uint8_t n = logPutFlash(out, 0, cap, (const char *)pgm_read_ptr(&LOG_TAG_TEXTS[tag]));
+  const char *f = (const char *)pgm_read_ptr(&LOG_FORMATS[id]);
+  uint8_t next = 0;
+  for (char c; n < cap && (c = (char)pgm_read_byte(f)) != 0; f++) {
+    if (c != '%') {
+      out[n++] = c;
+      continue;
+    }
+    char spec = (char)pgm_read_byte(++f);
+    if (!spec) break;
+    if (spec == '%') {
+      out[n++] = '%';
+      continue;
+    }
+    LogArg a = next < count ? args[next++] : logArg(0u);
+    char num[12];
+    if (spec == 's') n = logPutText(out, n, cap, a.text ? a.text : "");
+    else if (spec == 'r') n = logPutText(out, n, cap, resultName((uint8_t)a.value));
+    else if (spec == 'd') snprintf(num, sizeof(num), "%ld", (long)(int32_t)a.value), n = logPutText(out, n, cap, num);
+    else snprintf(num, sizeof(num), "%lu", (unsigned long)a.value), n = logPutText(out, n, cap, num);
+  }
+  out[n++] = '\r';
+  out[n++] = '\n';
+  return n;
+}
+
+inline bool logPush(const uint8_t *data, uint8_t len) {
+  if (len > logFree()) return false;
+  for (uint8_t i = 0; i < len; i++) {
+    logRing[logHead] = data[i];
+    logHead = (logHead + 1) & (LOG_BUFFER_SIZE - 1);
+  }
+  return true;
+}
+
+inline bool logRecord(uint8_t id, const LogArg *args, uint8_t count) {
+  uint8_t record[LOG_MAX_RECORD];
+#if LOG_BINARY
+  uint8_t len = logEncodeBinary(id, args, count, record);
+#else
+  uint8_t len = logEncodeText(id, args, count, (char *)record);
+#endif
+  return logPush(record, len);
+}
+
+inline void logCommit(uint8_t id, const LogArg *args, uint8_t count) {
+  if (logDropped) {
+    LogArg dropped = logArg(logDropped);
+    if (!logRecord(LOG_MSG_DROPPED, &dropped, 1)) {
+      logDropped++;
+      return;
+    }
+    logDropped = 0;
+  }
+  if (!logRecord(id, args, count)) logDropped++;
+}
+
+template <uint8_t Expected, class... A>
+inline void logWrite(uint8_t id, A... args) {
+  static_assert(Expected == sizeof...(A), "log arguments do not match the catalog format");
+  LogArg list[sizeof...(A) + 1] = {logArg(args)..., logArg(0u)};
+  logCommit(id, list, sizeof...(A));
+}
+
+#define LOG(name, ...)                                                                    \
+  do {                                                                                    \
+    if (LOG_LEVEL_OF_##name <= LOG_LEVEL)                                                 \
+      logWrite<LOG_ARGS_OF_##name>(LOG_MSG_##name, ##__VA_ARGS__);                        \
+  } while (0)
+
+// As LOG, past the level filter: for output that was asked for, such as a
+// profiler dump, which keeps its own level in the log all the same. Only
+// LOG_NONE compiles it out.
+#define LOG_REQUESTED(name, ...)                                                          \
+  do {                                                                                    \
+    if (LOG_LEVEL > LOG_NONE)                                                             \
+      logWrite<LOG_ARGS_OF_##name>(LOG_MSG_##name, ##__VA_ARGS__);                        \
+  } while (0)
+
+#if CAPTURE
+static uint32_t captureLastMs = 0;
+static bool captureGap = false;
+
+// Append a datagram to the log as a capture record: behind CAPTURE_SYNC in
+// a binary log, as a "CAP <hex>" line in a text one. Dropped like a log
+// message when the ring is full; the next record then carries CAPTURE_GAP.
+inline void logPacket(bool rx, const uint8_t *data, uint8_t len, uint32_t now) {
+  uint8_t raw[CAPTURE_MAX_RECORD];
+  uint8_t flags = (rx ? CAPTURE_RX : 0) | (captureGap ? CAPTURE_GAP : 0);
+  uint8_t n = captureEncode(flags, now - captureLastMs, data, len, raw);
+  if (!n) return;
+  uint8_t record[LOG_MAX_RECORD];
+  uint8_t m = 0;
+#if LOG_BINARY
+  record[m++] = CAPTURE_SYNC;
+  memcpy(record + m, raw, n);
+  m += n;
+#else
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  memcpy(record, "CAP ", 4);
+  m = 4;
+  for (uint8_t i = 0; i < n; i++) {
+    record[m++] = HEX_DIGITS[raw[i] >> 4];
+    record[m++] = HEX_DIGITS[raw[i] & 15];
+  }
+  record[m++] = '\r';
+  record[m++] = '\n';
+#endif
+  captureGap = !logPush(record, m);
+  if (!captureGap) captureLastMs = now;
+}
+#endif
+
+// Move buffered output into the serial TX buffer without blocking; call
+// from a scheduler task.
+inline void logFlush() {
+#if LOG_LEVEL > LOG_NONE
+  int room = Serial.availableForWrite();
+  while (room > 0 && logTail != logHead) {
+    uint16_t run = (logHead > logTail ? logHead : LOG_BUFFER_SIZE) - logTail;
+    if (run > (uint16_t)room) run = (uint16_t)room;
+    Serial.write(logRing + logTail, run);
+    logTail = (logTail + run) & (LOG_BUFFER_SIZE - 1);
+    room -= run;
+  }
+#endif
+}
+
+#endif // LOG_H
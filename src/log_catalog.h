@@ -0,0 +1,93 @@
+#ifndef LOG_CATALOG_H
+#define LOG_CATALOG_H
+
+// Every log message the firmware can emit. A message's id is its position
+// in LOG_CATALOG, so tools/logdecode.py reads this file to turn binary logs
+// back into text: decode with the catalog of the build that wrote the log.
+//
+// X(name, level, tag, format). Formats take %u (unsigned), %d (signed),
+// %s (string, at most LOG_MAX_STRING chars) and %r (ShotResult, printed as
+// MISS/HIT/SINK); %% is a literal %.
+
+#define LOG_TAGS(X) \
+  X(NONE, "")             \
+  X(READY, "[READY] ")    \
+  X(AIM, "[AIM] ")        \
+  X(PHASE, "[PHASE] ")    \
+  X(SHOOT, "[SHOOT] ")    \
+  X(LOG, "[LOG] ")        \
+  X(PROF, "[PROF] ")      \
+  X(MEM, "[MEM] ")        \
+  X(CLOCK, "[CLOCK] ")    \
+  X(RELAY, "[RELAY] ")    \
+  X(PEER, "[PEER] ")      \
+  X(SNAP, "[SNAP] ")
+
+#define LOG_CATALOG(X) \
+  X(PLACEMENT_DONE, LOG_INFO, NONE, "Placement complete!")                                             \
+  X(READY_RX_TIME, LOG_INFO, READY, "Received opponent READY timestamp: %u")                           \
+  X(READY_RX_PLAIN, LOG_INFO, READY, "Received opponent READY (no timestamp)")                         \
+  X(READY_DECIDING, LOG_DEBUG, READY, "Both timestamps available - deciding who shoots first...")      \
+  X(READY_TIMES, LOG_INFO, READY, "myTime=%u theirTime=%u myOffset=%d theirOffset=%d")                \
+  X(READY_TIE, LOG_INFO, READY, "Finished together - lower address shoots first")                      \
+  X(READY_FIRST, LOG_INFO, READY, ">>> YOU FINISHED FIRST - YOU SHOOT FIRST! <<<")                     \
+  X(READY_SECOND, LOG_INFO, READY, ">>> OPPONENT FINISHED FIRST - YOU WAIT FIRST <<<")                 \
+  X(READY_TIMEOUT, LOG_WARN, READY, "Opponent timeout! Starting anyway... you shoot first")            \
+  X(READY_LOST, LOG_WARN, READY, "WARNING: Opponent became unready during game")                       \
+  X(READY_NOTIFY, LOG_DEBUG, READY, "Notifying opponent that placement is complete (with timestamp)...") \
+  X(READY_SEND, LOG_INFO, READY, "Sending: READY:%u")                                                  \
+  X(RX_AIM, LOG_DEBUG, AIM, "Received message: AIM:%u,%u")                                             \
+  X(RX_SHOT, LOG_DEBUG, AIM, "Received message: SHOT:%u,%u")                                           \
+  X(RX_RESULT, LOG_DEBUG, AIM, "Received message: RESULT:%r")                                          \
+  X(RX_OTHER, LOG_DEBUG, AIM, "Received message: ?%u")                                                 \
+  X(OPP_AIM, LOG_DEBUG, AIM, "Opponent aiming at: %u,%u")                                              \
+  X(OPP_SHOT, LOG_INFO, AIM, "Opponent shot at: %u,%u")                                                \
+  X(SHOT_RESULT, LOG_INFO, AIM, "Shot result: %r")                                                     \
+  X(SHOT_UNEXPECTED, LOG_WARN, AIM, "Ignoring SHOT:%u,%u in phase %u - not the opponent's turn")       \
+  X(SHOT_VOID, LOG_WARN, AIM, "Both fired first - our shot at %u,%u is void")                          \
+  X(TO_OPPONENT_SHOT, LOG_DEBUG, AIM, ">>> Transitioning to PHASE_OPPONENT_SHOT (local)")              \
+  X(SEND_RESULT, LOG_INFO, AIM, "Sending reply: RESULT:%r")                                            \
+  X(RESULT, LOG_INFO, AIM, "Received result: %r")                                                      \
+  X(TO_SHOW_RESULT, LOG_DEBUG, AIM, ">>> Transitioning to PHASE_SHOW_RESULT")                          \
+  X(PHASE_TO_WAIT, LOG_DEBUG, PHASE, "PHASE_SHOW_RESULT -> PHASE_WAIT_FOR_OPPONENT")                   \
+  X(PHASE_TO_MY_TURN, LOG_DEBUG, PHASE, "PHASE_OPPONENT_SHOT -> PHASE_MY_TURN")                        \
+  X(FIRE, LOG_INFO, SHOOT, "FIRING at SHOT:%u,%u")                                                     \
+  X(TO_WAIT, LOG_DEBUG, SHOOT, ">>> Transitioning to PHASE_WAIT_FOR_OPPONENT")                         \
+  X(WIFI_CONNECTING, LOG_INFO, NONE, "Connecting to WiFi: %s")                                         \
+  X(WIFI_NO_SSID, LOG_ERROR, NONE, "Connecting to WiFi: SSID is null or empty!")                       \
+  X(WIFI_CONNECTED, LOG_INFO, NONE, "Connected! IP address: %u.%u.%u.%u")                              \
+  X(WIFI_TIMEOUT, LOG_WARN, NONE, "WiFi connect timeout - retrying in %u s")                           \
+  X(WIFI_FAST_MISS, LOG_WARN, NONE, "Cached lease got no link in %u ms - trying DHCP")                 \
+  X(WIFI_NO_MODULE, LOG_ERROR, NONE, "WiFi module did not come back from reset - retrying in %u s")    \
+  X(WIFI_READY, LOG_INFO, NONE, "Network ready %u ms after boot (%s)")                                 \
+  X(WIFI_LOST, LOG_WARN, NONE, "WiFi link lost after %u s - reconnecting")                             \
+  X(WIFI_RECONNECTED, LOG_INFO, NONE, "Link back after %u ms (%s), reconnect %u, worst %u ms")         \
+  X(DROPPED, LOG_WARN, LOG, "%u messages dropped")                                                     \
+  X(TASK_TABLE_FULL, LOG_ERROR, NONE, "Task table full (%u): a task will never run")                   \
+  X(MEM_STACK, LOG_INFO, MEM, "stack peak %u B, free %u B now, %u B at worst")                         \
+  X(MEM_HEAP, LOG_INFO, MEM, "heap %u B used, %u B in holes, largest free %u B, %u%% fragmented")      \
+  X(MEM_LOW, LOG_WARN, MEM, "only %u B left between heap and stack (stack peak %u B)")                 \
+  X(RELAY_PAIRED, LOG_INFO, RELAY, "paired at table %u, role %u")                                      \
+  X(RELAY_WAITING, LOG_WARN, RELAY, "waiting for the other board at table %u")                         \
+  X(PEER_FOUND, LOG_INFO, PEER, "board %u at %u.%u.%u.%u")                                             \
+  X(PEER_PICKED, LOG_INFO, PEER, "picked board %u at %u.%u.%u.%u")                                     \
+  X(PEER_PAIRED, LOG_INFO, PEER, "paired with board %u at %u.%u.%u.%u")                                \
+  X(PEER_MOVED, LOG_INFO, PEER, "board %u moved to %u.%u.%u.%u")                                       \
+  X(PEER_MISMATCH, LOG_WARN, PEER, "ignoring board %u at %u.%u.%u.%u: config %u, ours %u")             \
+  X(RX_STRANGER, LOG_DEBUG, PEER, "dropped %u from %u.%u.%u.%u: not the peer")                         \
+  X(LINK_FULL, LOG_WARN, PEER, "%u not sent: the link has too much unacknowledged")                    \
+  X(SNAP_RESUMED, LOG_INFO, SNAP, "resumed game %u from save %u in %u us (%s)")                        \
+  X(SNAP_OVER, LOG_INFO, SNAP, "game over - save closed")                                              \
+  X(SYNC_SENT, LOG_DEBUG, SNAP, "sent %u rows the other board lacks")                                  \
+  X(SYNC_MERGED, LOG_INFO, SNAP, "merged %u rows from the other board")                                \
+  X(SYNC_DONE, LOG_INFO, SNAP, "in step with the other board after %u digests")                        \
+  X(SYNC_SHOT_ANSWERED, LOG_INFO, SNAP, "shot at %u,%u was answered while we were down")               \
+  X(SYNC_TURN, LOG_INFO, SNAP, "turn taken from the shots on both boards: %s")                         \
+  X(SYNC_OTHER_GAME, LOG_WARN, SNAP, "other board is in game %u, not %u - placing again")              \
+  X(SYNC_GAVE_UP, LOG_WARN, SNAP, "no answer from the other board - playing on")                       \
+  X(CLOCK_SYNC, LOG_INFO, CLOCK, "rtt %u ms (min %u, max %u, var %u), offset %d ms, %u samples, %u lost") \
+  X(PROFILE_DUMP, LOG_INFO, PROF, "%u probes over %u ms")                                              \
+  X(PROFILE_PROBE, LOG_INFO, PROF, "%s runs=%u max=%u")                                                \
+  X(PROFILE_HIST, LOG_INFO, PROF, "%s %u: %u %u %u %u %u %u %u %u")
+
+#endif
@@ -6,7 +6,13 @@
 #include "joystick.h"
 #include "led_matrix.h"
 #include "game_logic.h"
+#include "ai_peer.h"
+#include "discovery.h"
+#include "snapshot.h"
 #include "player_logic.h"
+#include "scheduler.h"
+#include "profile.h"
+#include "mem_stats.h"
 #include "credentials.h"
 
 // UDP object (left in main so network helpers keep working)
@@ -14,49 +20,163 @@ WiFiUDP udp;
 bool finished = false;
 
 CRGB leds[NUM_LEDS]; // define once here
-CRGB frame[WIDTH][HEIGHT];
+IndexedFrame frame;  // palette indices, expanded into leds by showFrame
 
-void setup() {
-    Serial.begin(9600);
-    while (!Serial) { delay(10); }
+// Task periods. Input is sampled much faster than the game steps so quick
+// flicks and clicks between steps are not lost.
+static const unsigned long INPUT_PERIOD_US = 5000;
+static const unsigned long NETWORK_PERIOD_US = 2000;
+static const unsigned long GAME_PERIOD_US = 75000;
+static const unsigned long RENDER_PERIOD_US = 5000;
+static const unsigned long WIFI_PERIOD_US = 250000;
+static const unsigned long LOG_PERIOD_US = 2000;
+static const unsigned long PROFILE_PERIOD_US = 20000;
+static const unsigned long MEM_PERIOD_US = 1000000;
+static_assert(GAME_PERIOD_US == AIM_STEP_MS * 1000, "aim_stream.h dates AIM samples in game steps");
 
-    // LED matrix
-    ledSetup();
+static bool frameDirty = true;
 
-    if (!beginPlacement(sizes, counts, types)) {
-        Serial.println("Too many boats configured (MAX_BOATS exceeded)");
-    }
+// Native builds poll the joystick; on the board ADC0 samples it in the
+// background and this only counts for the profiler
+void inputTask() {
+    PROFILE_SCOPE(INPUT);
+    joystickPoll();
+}
 
-    // Connect WiFi (optional for placement, kept from original project)
-    const char* ssid = WIFI_SSID;
-    const char* password = WIFI_PASSWORD;
-    
-    if (!connectWiFi(ssid, password, 20000)) {
-        Serial.println("Failed to connect to WiFi - continuing without network");
-    } else {
-        startUDP(LOCAL_PORT);
-    }
+void networkTask() {
+    PROFILE_SCOPE(NETWORK);
+#if SOLO_AI
+    // The AI answers through the same handlers as a remote board
+    aiPeerPoll();
+#else
+#if SNAPSHOT
+    // Saves go on a byte at a time, network or not
+    snapshotPoll();
+#endif
+    if (!wifiConnected()) return;
+    // Handle everything the opponent sent as soon as it arrives
+    dispatchMessages();
+    // Retransmit unacknowledged READY/SHOT/RESULT packets
+    pollNetwork();
+#if USE_RELAY
+    relayPoll();
+#elif USE_DISCOVERY
+    // Find the other board while the boats are placed
+    discoveryPoll();
+#endif
+    // Keep the RTT and clock offset estimates fresh
+    clockSyncPoll();
+#if SNAPSHOT
+    stateSyncPoll();
+#endif
+#endif
 }
 
-void loop() {
-    // Read joystick input (-1, 0, 1)
+void wifiTask() {
+    PROFILE_SCOPE(WIFI);
+    // Up for the first time or back after a drop: (re)bind the socket
+    if (!wifiPoll()) return;
+    startUDP(LOCAL_PORT);
+#if USE_RELAY
+    relayRestart();
+#endif
+}
+
+void gameTask() {
+    PROFILE_SCOPE(GAME);
+    // Everything the joystick did since the last step: every move counts,
+    // and a release carries the exact length of its press
     int xInput = 0, yInput = 0, button = 0;
-    readJoystick(xInput, yInput, button);
+    unsigned long pressMs = 0;
+    JoyEvent e;
+    while (joystickNext(e)) {
+        if (e.kind == JOY_MOVE) xInput += e.dx, yInput += e.dy;
+        else if (e.kind == JOY_PRESS) button = 1;
+        else pressMs = e.heldMs ? e.heldMs : 1;
+    }
 
     // Prepare frame and let game logic draw into it
-
     if(!finished){
-        placementStep(xInput, yInput, button, frame, finished);
+        placementStep(xInput, yInput, joystickHeld(), pressMs, frame, finished);
+        if (finished) notifyReadyToOpponent();
+    }
+    else if (readyState != READY_SYNCED) {
+        // Keep showing the fleet until both boards agree who shoots first
+        handleReadyHandshake();
+        drawPlacementFrame(frame);
     }
     else {
-        // Always call aim so incoming messages (AIM/SHOT/RESULT) are processed
-        // internally; `aim` will draw appropriate frame depending on `myTurn`.
+        // `aim` draws the appropriate frame for the current game phase
         aim(xInput, yInput, button, frame);
     }
+    frameDirty = true;
+}
 
-    // Show the frame
+void renderTask() {
+    if (!frameDirty) return;
+    PROFILE_SCOPE(RENDER);
+    frameDirty = false;
     showFrame(frame);
+}
 
-    // Small delay controls responsiveness
-    delay(75);
+void logTask() {
+    PROFILE_SCOPE(LOG);
+    logFlush();
+}
+
+// addTask, but a task that does not fit the table is reported rather than
+// silently never run.
+void schedule(TaskFn fn, unsigned long periodUs) {
+    if (!addTask(fn, periodUs)) LOG(TASK_TABLE_FULL, MAX_TASKS);
+}
+
+void setup() {
+    Serial.begin(9600);
+    while (!Serial) { delay(10); }
+
+    // LED matrix
+    ledSetup();
+    loadPalette(GAME_PALETTE, COLOR_COUNT);
+
+    joystickBegin();
+    beginPlacement();
+    registerGameHandlers();
+
+#if SOLO_AI
+    aiPeerBegin();
+#else
+    // Before anything is sent: placement can finish before WiFi is up
+    rlInit(peerLink, sendPacketToPeer);
+#if SNAPSHOT
+    // A game cut short by a reset resumes before the network is even up
+    if (snapshotRestore()) finished = true;
+    stateSyncBegin();
+#endif
+    // Associate in the background; placement starts right away
+    wifiStart(WIFI_SSID, WIFI_PASSWORD, 20000);
+    clockSyncBegin();
+#if USE_RELAY
+    relayBegin();
+#elif USE_DISCOVERY
+    discoveryBegin();
+#endif
+#endif
+
+    schedule(inputTask, INPUT_PERIOD_US);
+    schedule(networkTask, NETWORK_PERIOD_US);
+    schedule(gameTask, GAME_PERIOD_US);
+    schedule(renderTask, RENDER_PERIOD_US);
+    schedule(wifiTask, WIFI_PERIOD_US);
+    schedule(logTask, LOG_PERIOD_US);
+    schedule(memTask, MEM_PERIOD_US);
+#if PROFILE
+    profileReset();
+    onMessage(MSG_STATS, profileOnStats);
+    schedule(profileTask, PROFILE_PERIOD_US);
+#endif
+}
+
+void loop() {
+    PROFILE_SCOPE(LOOP);
+    runTasks();
 }
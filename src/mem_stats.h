@@ -0,0 +1,111 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <Arduino.h>
+#include "log.h"
+
+// SRAM use on the ATmega4809. Its 6 KB hold the globals (.data/.bss), then
+// the heap growing up from their end and the stack growing down from
+// RAMEND. Before main() the whole region above the globals is painted with
+// MEM_CANARY; a sample scans up from the heap top to the first overwritten
+// byte, which is as deep as the stack has ever reached. The heap side is
+// read from avr-libc's malloc state: bytes in freed holes, the largest
+// free block and external fragmentation (100 - largest / all free, where
+// the room between heap top and stack counts as one free block).
+//
+// memTask() takes a sample each time it runs, logs MEM_LOW whenever the
+// worst gap between heap and stack reaches a new low under MEM_LOW_BYTES,
+// and logs the full figures at the first sample and every MEM_REPORT_MS.
+// On the host there is no such layout and nothing is sampled.
+
+static const unsigned long MEM_REPORT_MS = 60000;
+static const uint16_t MEM_LOW_BYTES = 256;
+static const uint8_t MEM_CANARY = 0xC5;
+
+struct MemStats {
+  uint16_t stackPeak;     // deepest the stack has been, bytes below RAMEND
+  uint16_t freeNow;       // heap top to stack pointer
+  uint16_t freeMin;       // heap top to the deepest stack so far
+  uint16_t heapUsed;      // allocated, including malloc's size headers
+  uint16_t heapHoles;     // freed blocks below the heap top
+  uint16_t largestFree;   // biggest single allocation that would succeed
+  uint8_t fragmentation;  // percent
+};
+
+static MemStats memStats;
+
+#ifdef __AVR__
+
+static uint16_t memLowestReported = 0xFFFF;
+static unsigned long memLastReportMs = 0 - MEM_REPORT_MS;  // report at once
+
+extern uint8_t __heap_start;
+extern char *__brkval;
+extern size_t __malloc_margin;
+struct __freelist {
+  size_t sz;
+  struct __freelist *nx;
+};
+extern struct __freelist *__flp;
+
+// Placed in .init3: runs once after the stack pointer and zero register
+// are set up and before .data/.bss are initialised. Naked code in an init
+// section falls through to the next one, so it uses no stack and nothing
+// it overwrites is live yet.
+static void memPaintStack() __attribute__((naked, used, section(".init3")));
+static void memPaintStack() {
+  for (uint8_t *p = &__heap_start; p <= (uint8_t *)RAMEND; p++) *p = MEM_CANARY;
+}
+
+inline void memSample() {
+  uint8_t *heapTop = __brkval ? (uint8_t *)__brkval : &__heap_start;
+  uint8_t *sp = (uint8_t *)SP;
+  uint8_t *p = heapTop;
+  while (p <= sp && *p == MEM_CANARY) p++;
+  MemStats &m = memStats;
+  m.stackPeak = (uint16_t)((uint8_t *)RAMEND - p + 1);
+  m.freeNow = (uint16_t)(sp - heapTop);
+  m.freeMin = (uint16_t)(p - heapTop);
+
+  uint16_t holes = 0, largest = 0;
+  for (struct __freelist *f = __flp; f; f = f->nx) {
+    holes += f->sz + sizeof(size_t);
+    if (f->sz > largest) largest = f->sz;
+  }
+  uint16_t top = m.freeNow > __malloc_margin ? m.freeNow - __malloc_margin : 0;
+  m.heapUsed = (uint16_t)(heapTop - &__heap_start) - holes;
+  m.heapHoles = holes;
+  m.largestFree = largest > top ? largest : top;
+  uint16_t allFree = holes + top;
+  m.fragmentation = allFree ? (uint8_t)(100 - (uint32_t)m.largestFree * 100 / allFree) : 0;
+}
+
+#else
+
+inline void memSample() {}
+
+#endif // __AVR__
+
+inline void memReport() {
+  const MemStats &m = memStats;
+  LOG(MEM_STACK, m.stackPeak, m.freeNow, m.freeMin);
+  LOG(MEM_HEAP, m.heapUsed, m.heapHoles, m.largestFree, m.fragmentation);
+}
+
+// Run as a scheduler task.
+inline void memTask() {
+#ifdef __AVR__
+  memSample();
+  if (memStats.freeMin < MEM_LOW_BYTES && memStats.freeMin < memLowestReported) {
+    memLowestReported = memStats.freeMin;
+    LOG(MEM_LOW, memStats.freeMin, memStats.stackPeak);
+  }
+  unsigned long now = millis();
+  if (now - memLastReportMs >= MEM_REPORT_MS) {
+    memLastReportMs = now;
+    memReport();
+  }
+#endif
+}
+
+#endif // MEM_STATS_H
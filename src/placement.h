@@ -0,0 +1,130 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <Arduino.h>
+#include "bitboard.h"
+
+// Legal boat positions as row masks. For every boat length and orientation
+// the table holds, per row, the origins (top/left cell) where such a boat
+// fits on the board; it is generated at compile time into flash. Masking it
+// with the occupied rows gives every free position for a boat at once,
+// which is what placement checks and the random fleet generator use.
+
+// Row y of the origin mask for entry i = ((size - 1) * 2 + vertical) * HEIGHT + y.
+constexpr RowMask legalOriginRowAt(uint16_t i) {
+  return (i / HEIGHT) % 2
+      ? (RowMask)(i % HEIGHT + i / (2 * HEIGHT) + 1 <= HEIGHT ? (1UL << WIDTH) - 1 : 0)
+      : (RowMask)((1UL << (WIDTH - i / (2 * HEIGHT))) - 1);
+}
+
+template <class Seq> struct OriginTable;
+template <uint16_t... I> struct OriginTable<IndexSeq<I...> > {
+  static const RowMask rows[sizeof...(I)];
+};
+template <uint16_t... I>
+const RowMask OriginTable<IndexSeq<I...> >::rows[sizeof...(I)] PROGMEM = {legalOriginRowAt(I)...};
+
+typedef OriginTable<MakeIndexSeq<MAX_SPAN * 2 * HEIGHT>::type> LEGAL_ORIGINS;
+
+// Origins on row y where a boat of length size (1..MAX_SPAN) fits the board.
+inline RowMask legalOrigins(uint8_t size, bool vertical, int y) {
+  return pgm_read_word(&LEGAL_ORIGINS::rows[((size - 1) * 2 + vertical) * HEIGHT + y]);
+}
+
+inline bool originLegal(uint8_t size, bool vertical, int x, int y) {
+  if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT || size == 0 || size > MAX_SPAN) return false;
+  return (legalOrigins(size, vertical, y) >> x) & 1;
+}
+
+// Every origin where a boat of length size fits without overlapping occ.
+// Returns how many there are.
+inline uint16_t freeOrigins(const BitBoard &occ, uint8_t size, bool vertical, BitBoard &out) {
+  uint16_t count = 0;
+  for (int y = 0; y < HEIGHT; y++) {
+    RowMask legal = legalOrigins(size, vertical, y);
+    RowMask blocked = 0;
+    // A vertical origin is only legal if the rows below it exist
+    if (legal)
+      for (uint8_t i = 0; i < MAX_SPAN && i < size; i++)
+        blocked |= vertical ? occ.rows[y + i] : (RowMask)(occ.rows[y] >> i);
+    out.rows[y] = legal & ~blocked;
+    count += __builtin_popcount(out.rows[y]);
+  }
+  return count;
+}
+
+inline uint16_t bbCount(const BitBoard &b) {
+  uint16_t n = 0;
+  for (int y = 0; y < HEIGHT; y++) n += __builtin_popcount(b.rows[y]);
+  return n;
+}
+
+// Position of the n-th set cell (row-major, from 0). False if there is none.
+inline bool bbNth(const BitBoard &b, uint16_t n, int &x, int &y) {
+  for (y = 0; y < HEIGHT; y++) {
+    uint8_t inRow = __builtin_popcount(b.rows[y]);
+    if (n >= inRow) {
+      n -= inRow;
+      continue;
+    }
+    RowMask row = b.rows[y];
+    while (n--) row &= row - 1;  // drop the lower set cells
+    x = __builtin_ctz(row);
+    return true;
+  }
+  return false;
+}
+
+// xorshift32: small and fast enough to generate fleets in bulk.
+struct FleetRng {
+  uint32_t state;
+};
+
+inline uint32_t fleetRandom(FleetRng &rng) {
+  if (!rng.state) rng.state = 0x9E3779B9UL;
+  rng.state ^= rng.state << 13;
+  rng.state ^= rng.state >> 17;
+  rng.state ^= rng.state << 5;
+  return rng.state;
+}
+
+struct BoatPlacement {
+  int8_t x, y;
+  bool vertical;
+};
+
+static const uint8_t FLEET_ATTEMPTS = 16;
+
+// Place boats first..count-1 of GameFleet on top of occ. Each boat is drawn
+// uniformly from the positions still free for it, so there is no
+// per-boat rejection; the whole fleet is only redrawn if earlier boats left
+// no room for a later one. On success occ includes the new boats and out[i]
+// holds boat i's position.
+inline bool randomFleet(FleetRng &rng, BitBoard &occ, BoatPlacement *out, uint8_t first = 0) {
+  for (uint8_t attempt = 0; attempt < FLEET_ATTEMPTS; attempt++) {
+    BitBoard cur = occ;
+    uint8_t i = first;
+    for (; i < GameFleet::count; i++) {
+      uint8_t size = GameFleet::sizes[i];
+      BitBoard across, down;
+      uint16_t nAcross = freeOrigins(cur, size, false, across);
+      uint16_t total = nAcross + freeOrigins(cur, size, true, down);
+      if (!total) break;
+      uint16_t pick = (uint16_t)(fleetRandom(rng) % total);
+      bool vertical = pick >= nAcross;
+      int x = 0, y = 0;
+      bbNth(vertical ? down : across, vertical ? pick - nAcross : pick, x, y);
+      bbFill(cur, x, y, size, vertical);
+      out[i].x = (int8_t)x;
+      out[i].y = (int8_t)y;
+      out[i].vertical = vertical;
+    }
+    if (i == GameFleet::count) {
+      occ = cur;
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif // PLACEMENT_H
@@ -0,0 +1,172 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "config.h"
+#include "log.h"
+#include "protocol.h"
+
+// Loop profiler. PROFILE_SCOPE(name) at the top of a block times the rest
+// of the block with micros() and counts the duration in that probe's log2
+// histogram: bucket 0 is under 4 us, bucket n (n >= 1) is [2^(n+1),
+// 2^(n+2)) us, and the last bucket takes everything from 65.5 ms up. Each
+// probe also counts its runs and keeps the longest. When a bucket would
+// overflow, all of that probe's buckets are halved: the histogram keeps its
+// shape, weighted towards recent runs.
+//
+// Histograms are cumulative until reset. Send 'p' on the serial port to
+// dump them as log messages (drained a record at a time as the log ring
+// has room, so dumping never blocks the loop) or 'r' to reset them; a UDP
+// "STATS" query to LOCAL_PORT is answered with one binary datagram.
+// tools/profview.py renders either. With PROFILE 0 every probe, the
+// tables and the task compile to nothing.
+
+// X(name, label). The label is what the dump and tools/profview.py show.
+// RTT is not a loop stage: clock_sync.h records each PING round trip.
+#define PROFILE_PROBES(X)            \
+  X(LOOP, "loop")                    \
+  X(INPUT, "input")                  \
+  X(NETWORK, "network")              \
+  X(UDP_RX, "udp_rx")                \
+  X(UDP_TX, "udp_tx")                \
+  X(GAME, "game")                    \
+  X(AIM, "aim")                      \
+  X(AI, "ai")                        \
+  X(DRAW_OPPONENT, "draw_opponent")  \
+  X(DRAW_HITS, "draw_hits")          \
+  X(RENDER, "render")                \
+  X(WIFI, "wifi")                    \
+  X(LOG, "log_flush")                \
+  X(RTT, "peer_rtt")
+
+#define PROFILE_PROBE_ID(name, label) PROBE_##name,
+enum ProfileProbe : uint8_t { PROFILE_PROBES(PROFILE_PROBE_ID) PROBE_COUNT };
+#undef PROFILE_PROBE_ID
+
+static const uint8_t PROFILE_BUCKETS = 16;
+
+#if PROFILE
+
+struct ProfileHistogram {
+  uint32_t runs;
+  uint32_t maxUs;
+  uint16_t counts[PROFILE_BUCKETS];
+};
+
+static ProfileHistogram profileTable[PROBE_COUNT];
+static unsigned long profileSinceMs = 0;
+static uint8_t profileDumpStep = 0;  // 0 = idle, else next record + 1
+
+#define PROFILE_LABEL_TEXT(name, label) static const char PROFILE_LABEL_##name[] PROGMEM = label;
+PROFILE_PROBES(PROFILE_LABEL_TEXT)
+#undef PROFILE_LABEL_TEXT
+#define PROFILE_LABEL_ENTRY(name, label) PROFILE_LABEL_##name,
+static const char *const PROFILE_LABELS[PROBE_COUNT] PROGMEM = {PROFILE_PROBES(PROFILE_LABEL_ENTRY)};
+#undef PROFILE_LABEL_ENTRY
+
+inline uint8_t profileBucket(unsigned long us) {
+  uint8_t b = 0;
+  for (us >>= 2; us && b < PROFILE_BUCKETS - 1; us >>= 1) b++;
+  return b;
+}
+
+inline void profileRecord(uint8_t probe, unsigned long us) {
+  ProfileHistogram &h = profileTable[probe];
+  uint16_t &count = h.counts[profileBucket(us)];
+  if (count == 0xFFFF)
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) h.counts[b] >>= 1;
+  count++;
+  h.runs++;
+  if (us > h.maxUs) h.maxUs = us;
+}
+
+inline void profileReset() {
+  memset(profileTable, 0, sizeof(profileTable));
+  profileSinceMs = millis();
+}
+
+struct ProfileScope {
+  uint8_t probe;
+  unsigned long startUs;
+  explicit ProfileScope(uint8_t p) : probe(p), startUs(micros()) {}
+  ~ProfileScope() { profileRecord(probe, micros() - startUs); }
+};
+
+#define PROFILE_SCOPE(name) ProfileScope profileScope_##name(PROBE_##name)
+
+// Queue the next dump record if the log ring has room for it. A dump is a
+// PROFILE_DUMP header, then per probe its run count and maximum and two
+// halves of the histogram.
+inline void profileDumpNext() {
+  if (logFree() < LOG_MAX_RECORD) return;
+  uint8_t step = profileDumpStep - 1;
+  if (step == 0) {
+    LOG_REQUESTED(PROFILE_DUMP, PROBE_COUNT, millis() - profileSinceMs);
+  } else {
+    uint8_t probe = (step - 1) / 3, part = (step - 1) % 3;
+    char label[16];
+    strncpy_P(label, (const char *)pgm_read_ptr(&PROFILE_LABELS[probe]), sizeof(label) - 1);
+    label[sizeof(label) - 1] = 0;
+    const ProfileHistogram &h = profileTable[probe];
+    if (part == 0) {
+      LOG_REQUESTED(PROFILE_PROBE, label, h.runs, h.maxUs);
+    } else {
+      const uint16_t *c = h.counts + (part - 1) * 8;
+      LOG_REQUESTED(PROFILE_HIST, label, (part - 1) * 8, c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7]);
+    }
+  }
+  profileDumpStep = step + 1 < 1 + 3 * PROBE_COUNT ? step + 2 : 0;
+}
+
+// Serial commands and dump progress; run as a scheduler task.
+inline void profileTask() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c == 'p' && !profileDumpStep) profileDumpStep = 1;
+    if (c == 'r') profileReset();
+  }
+  if (profileDumpStep) profileDumpNext();
+}
+
+inline uint8_t *profilePut16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+inline uint8_t *profilePut32(uint8_t *p, uint32_t v) {
+  return profilePut16(profilePut16(p, (uint16_t)v), (uint16_t)(v >> 16));
+}
+
+extern WiFiUDP udp;
+
+// Answer a STATS query to whoever sent it:
+//   [WIRE_MAGIC][MSG_STATS][0] u8 probes, u8 buckets, u32 ms since reset,
+//   then per probe u32 runs, u32 max us and u16 counts[buckets],
+//   little-endian.
+inline void profileOnStats(const Message &) {
+  uint8_t buf[8 + 2 * PROFILE_BUCKETS];
+  udp.beginPacket(udp.remoteIP(), udp.remotePort());
+  buf[0] = WIRE_MAGIC;
+  buf[1] = MSG_STATS;
+  buf[2] = 0;
+  buf[3] = PROBE_COUNT;
+  buf[4] = PROFILE_BUCKETS;
+  profilePut32(buf + 5, millis() - profileSinceMs);
+  udp.write(buf, 9);
+  for (uint8_t i = 0; i < PROBE_COUNT; i++) {
+    uint8_t *p = profilePut32(profilePut32(buf, profileTable[i].runs), profileTable[i].maxUs);
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) p = profilePut16(p, profileTable[i].counts[b]);
+    udp.write(buf, p - buf);
+  }
+  udp.endPacket();
+}
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+
+#endif // PROFILE
+
+#endif // PROFILE_H
@@ -0,0 +1,436 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Game messages exchanged between boards. Kept free of Arduino types so the
+// same encoder/decoder runs on the host.
+enum MsgType : uint8_t {
+  MSG_NONE = 0,
+  MSG_READY,
+  MSG_AIM,
+  MSG_SHOT,
+  MSG_RESULT,
+  MSG_ACK,
+  MSG_STATS,  // profiler query (profile.h); answered outside this format
+  MSG_PING,   // clock sync (clock_sync.h)
+  MSG_PONG,
+  MSG_HELLO,  // registration with the relay server (relay_link.h)
+  MSG_BEACON, // opponent discovery (discovery.h)
+  MSG_STATE_SYNC,  // game state reconciliation after a reset (snapshot.h)
+  MSG_TYPE_COUNT
+};
+
+enum ShotResult : uint8_t { RESULT_MISS = 0, RESULT_HIT, RESULT_SINK };
+
+// HELLO relayState, as answered by the relay
+enum RelayState : uint8_t { RELAY_WAITING = 0, RELAY_PAIRED };
+
+// Earlier cursor samples an AIM batch can carry (aim_stream.h)
+static const uint8_t AIM_TRAIL_MAX = 8;
+
+// STATE_SYNC syncFlags: what syncData holds, and why it was sent
+static const uint8_t SYNC_DIGEST = 0x01;    // a digest of each row
+static const uint8_t SYNC_ROWS = 0x02;      // rows that differed
+static const uint8_t SYNC_REPLY = 0x40;     // answers a digest
+static const uint8_t SYNC_RESUMED = 0x80;   // sender restarted from a snapshot
+static const uint8_t STATE_SYNC_MAX_DATA = 26;
+
+// READY offset when the sender has no clock estimate yet
+static const int32_t OFFSET_UNKNOWN = -0x7FFFFFFF - 1;
+
+// Payload fields of different types share storage: a Message is cleared
+// for every packet decoded and copied for every one sent.
+struct Message {
+  uint8_t type;
+  uint8_t seq;
+  bool sequenced;   // arrived as binary, so seq is meaningful
+  union {
+    struct {
+      uint8_t x, y;     // AIM / SHOT cell (AIM: the newest sample)
+      uint8_t aimAge;   // AIM: game steps since the newest sample was taken
+      uint8_t aimCount; // AIM: entries in aimTrail
+      // AIM: earlier samples, oldest first. Borrowed: the sender's buffer,
+      // or the datagram it was decoded from, so valid only until that is
+      // reused. An AIM is encoded at once and never stored (reliable.h)
+      const uint8_t *aimTrail;
+    };
+    uint8_t result;   // RESULT: ShotResult
+    uint16_t ackBits; // ACK: bit i set = seq - 1 - i also received
+    struct {
+      uint32_t value; // READY: placement timestamp (0 = none)
+                      // PING: sender's clock; PONG: replier's clock on receipt
+                      // BEACON: sender's board id
+      union {
+        uint32_t echo;  // PONG: the PING's value; BEACON: the board it picked
+        int32_t offset; // READY: sender's estimate of our clock minus its own
+      };
+      uint16_t configHash; // BEACON: hash of the sender's game configuration
+    };
+    struct {
+      uint16_t table;     // HELLO: relay table the board registers under
+      uint8_t relayState; // HELLO from the relay: RelayState
+      uint8_t role;       // HELLO from the relay: 0 = registered first
+    };
+    struct {
+      uint8_t syncFlags;  // STATE_SYNC: SYNC_*
+      uint8_t syncLen;    // STATE_SYNC: bytes in syncData
+      uint16_t gameTag;   // STATE_SYNC: the game the sender is in, 0 = none
+      // STATE_SYNC: laid out by snapshot.h. Borrowed like aimTrail, and
+      // for as long: snapshot.h sends it from a local array
+      const uint8_t *syncData;
+    };
+  };
+};
+
+#ifdef __AVR__
+// reliable.h holds RELIABLE_SLOTS of these for early packets; a field
+// added outside the union would cost every slot
+static_assert(sizeof(Message) <= 13, "Message payload fields must share the union");
+#endif
+
+// Binary layout: [WIRE_MAGIC][type][seq][payload], little-endian.
+//   READY  u32 value, i32 offset (a 4-byte READY has no offset)
+//   AIM    u8 x, u8 y[, u8 aimCount | aimAge << 4, u8 aimTrail[aimCount]]
+//   SHOT   u8 x, u8 y
+//   RESULT u8 result
+//   ACK    u16 ackBits (seq is the sequence number being acknowledged)
+//   STATS  none
+//   PING   u32 value
+//   PONG   u32 value, u32 echo
+//   HELLO  u16 table, u8 relayState, u8 role
+//   BEACON u32 value, u32 echo, u16 configHash
+//   STATE_SYNC u8 syncFlags, u16 gameTag, u8 syncData[syncLen] (binary only)
+// The magic byte is outside printable ASCII, so legacy text packets
+// ("READY:", "AIM:", "SHOT:", "RESULT:") are never mistaken for binary.
+static const uint8_t WIRE_MAGIC = 0xB5;
+static const uint8_t WIRE_HEADER_LEN = 3;
+static const uint8_t WIRE_MAX_LEN = 32;  // also fits the longest text message
+static_assert(WIRE_HEADER_LEN + 3 + STATE_SYNC_MAX_DATA <= WIRE_MAX_LEN, "STATE_SYNC must fit a datagram");
+
+inline uint8_t payloadLength(uint8_t type) {
+  switch (type) {
+    case MSG_READY:  return 8;
+    case MSG_PING:   return 4;
+    case MSG_PONG:   return 8;
+    case MSG_HELLO:  return 4;
+    case MSG_BEACON: return 10;
+    case MSG_STATE_SYNC: return 3;  // and syncLen bytes
+    case MSG_AIM:
+    case MSG_SHOT:   return 2;
+    case MSG_RESULT: return 1;
+    case MSG_ACK:    return 2;
+    default:         return 0;
+  }
+}
+
+// Reset m to an empty message of the given type. Decoding clears in place:
+// assigning a fresh makeMessage() goes through a temporary.
+inline void clearMessage(Message &m, uint8_t type) {
+  memset(&m, 0, sizeof(m));
+  m.type = type;
+}
+
+inline Message makeMessage(uint8_t type) {
+  Message m;
+  clearMessage(m, type);
+  return m;
+}
+
+inline void putU32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+inline uint32_t getU32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Write msg into buf (at least WIRE_MAX_LEN bytes). Returns encoded length.
+inline uint8_t encodeMessage(const Message &msg, uint8_t *buf) {
+  buf[0] = WIRE_MAGIC;
+  buf[1] = msg.type;
+  buf[2] = msg.seq;
+  uint8_t *p = buf + WIRE_HEADER_LEN;
+  switch (msg.type) {
+    case MSG_READY:
+      putU32(p, msg.value);
+      putU32(p + 4, (uint32_t)msg.offset);
+      break;
+    case MSG_AIM:
+      p[0] = msg.x;
+      p[1] = msg.y;
+      if (!msg.aimCount && !msg.aimAge) break;
+      p[2] = (uint8_t)(msg.aimCount | msg.aimAge << 4);
+      memcpy(p + 3, msg.aimTrail, msg.aimCount);
+      return WIRE_HEADER_LEN + 3 + msg.aimCount;
+    case MSG_SHOT:
+      p[0] = msg.x;
+      p[1] = msg.y;
+      break;
+    case MSG_RESULT:
+      p[0] = msg.result;
+      break;
+    case MSG_ACK:
+      p[0] = (uint8_t)msg.ackBits;
+      p[1] = (uint8_t)(msg.ackBits >> 8);
+      break;
+    case MSG_PING:
+      putU32(p, msg.value);
+      break;
+    case MSG_PONG:
+      putU32(p, msg.value);
+      putU32(p + 4, msg.echo);
+      break;
+    case MSG_HELLO:
+      p[0] = (uint8_t)msg.table;
+      p[1] = (uint8_t)(msg.table >> 8);
+      p[2] = msg.relayState;
+      p[3] = msg.role;
+      break;
+    case MSG_BEACON:
+      putU32(p, msg.value);
+      putU32(p + 4, msg.echo);
+      p[8] = (uint8_t)msg.configHash;
+      p[9] = (uint8_t)(msg.configHash >> 8);
+      break;
+    case MSG_STATE_SYNC:
+      p[0] = msg.syncFlags;
+      p[1] = (uint8_t)msg.gameTag;
+      p[2] = (uint8_t)(msg.gameTag >> 8);
+      if (msg.syncLen) memcpy(p + 3, msg.syncData, msg.syncLen);
+      return WIRE_HEADER_LEN + 3 + msg.syncLen;
+  }
+  return WIRE_HEADER_LEN + payloadLength(msg.type);
+}
+
+inline const char *resultName(uint8_t result) {
+  static const char *const RESULT_NAMES[] = {"MISS", "HIT", "SINK"};
+  return RESULT_NAMES[result <= RESULT_SINK ? result : (uint8_t)RESULT_MISS];
+}
+
+// Legacy text form, e.g. "SHOT:3,7". Returns length written (excluding NUL).
+inline int formatTextMessage(const Message &msg, char *buf, size_t size) {
+  switch (msg.type) {
+    case MSG_READY:
+      if (msg.offset == OFFSET_UNKNOWN) return snprintf(buf, size, "READY:%lu", (unsigned long)msg.value);
+      return snprintf(buf, size, "READY:%lu,%ld", (unsigned long)msg.value, (long)msg.offset);
+    case MSG_AIM:    return snprintf(buf, size, "AIM:%u,%u", msg.x, msg.y);  // newest sample only
+    case MSG_SHOT:   return snprintf(buf, size, "SHOT:%u,%u", msg.x, msg.y);
+    case MSG_RESULT: return snprintf(buf, size, "RESULT:%s", resultName(msg.result));
+    case MSG_ACK:    return snprintf(buf, size, "ACK:%u", msg.seq);
+    case MSG_STATS:  return snprintf(buf, size, "STATS");
+    case MSG_PING:   return snprintf(buf, size, "PING:%lu", (unsigned long)msg.value);
+    case MSG_PONG:   return snprintf(buf, size, "PONG:%lu,%lu", (unsigned long)msg.value, (unsigned long)msg.echo);
+    case MSG_HELLO:  return snprintf(buf, size, "HELLO:%u,%u,%u", msg.table, msg.relayState, msg.role);
+    case MSG_BEACON:
+      // In hex so the longest one fits WIRE_MAX_LEN
+      return snprintf(buf, size, "BEACON:%lX,%lX,%X", (unsigned long)msg.value, (unsigned long)msg.echo, msg.configHash);
+    default:         return snprintf(buf, size, "?%u", msg.type);
+  }
+}
+
+// Parse an unsigned decimal at p, advancing p. Fails if there are no digits.
+// Works on locals: p and out may alias any char the loop reads, so
+// through the references every digit would be a store and a reload.
+inline bool parseDecimal(const char *&p, const char *end, uint32_t &out) {
+  const char *q = p;
+  uint32_t v = 0;
+  while (q < end && *q >= '0' && *q <= '9') v = v * 10 + (uint32_t)(*q++ - '0');
+  bool any = q > p;
+  p = q;
+  out = v;
+  return any;
+}
+
+// As parseDecimal, for up to eight hex digits.
+inline bool parseHex(const char *&p, const char *end, uint32_t &out) {
+  const char *q = p;
+  uint32_t v = 0;
+  for (; q < end && q - p < 8; q++) {
+    char c = *q;
+    uint8_t digit;
+    if (c >= '0' && c <= '9') digit = (uint8_t)(c - '0');
+    else if (c >= 'A' && c <= 'F') digit = (uint8_t)(c - 'A' + 10);
+    else if (c >= 'a' && c <= 'f') digit = (uint8_t)(c - 'a' + 10);
+    else break;
+    v = v << 4 | digit;
+  }
+  bool any = q > p;
+  p = q;
+  out = v;
+  return any;
+}
+
+// As parseDecimal, with an optional leading '-'.
+inline bool parseSigned(const char *&p, const char *end, int32_t &out) {
+  bool negative = p < end && *p == '-';
+  if (negative) p++;
+  uint32_t magnitude;
+  if (!parseDecimal(p, end, magnitude)) return false;
+  out = (int32_t)(negative ? 0 - magnitude : magnitude);
+  return true;
+}
+
+inline bool hasPrefix(const char *p, const char *end, const char *prefix) {
+  size_t n = strlen(prefix);
+  return (size_t)(end - p) >= n && memcmp(p, prefix, n) == 0;
+}
+
+// Parse "<x>,<y>" at p into msg.x/msg.y.
+inline bool parseTextCell(const char *p, const char *end, Message &msg) {
+  uint32_t x, y;
+  if (!parseDecimal(p, end, x) || p >= end || *p++ != ',') return false;
+  if (!parseDecimal(p, end, y)) return false;
+  if (x > 0xFF || y > 0xFF) return false;
+  msg.x = (uint8_t)x;
+  msg.y = (uint8_t)y;
+  return true;
+}
+
+inline bool parseTextMessage(const char *p, int len, Message &msg) {
+  const char *end = p + len;
+  clearMessage(msg, MSG_NONE);
+  if (hasPrefix(p, end, "READY")) {
+    // Plain READY (no timestamp) is accepted as timestamp 0
+    msg.type = MSG_READY;
+    msg.offset = OFFSET_UNKNOWN;
+    p += 5;
+    if (p < end && *p == ':') {
+      p++;
+      parseDecimal(p, end, msg.value);
+      if (p < end && *p == ',' && !parseSigned(++p, end, msg.offset)) msg.offset = OFFSET_UNKNOWN;
+    }
+    return true;
+  }
+  // Game traffic first: it is most of what arrives
+  if (hasPrefix(p, end, "AIM:")) {
+    msg.type = MSG_AIM;
+    return parseTextCell(p + 4, end, msg);
+  }
+  if (hasPrefix(p, end, "SHOT:")) {
+    msg.type = MSG_SHOT;
+    return parseTextCell(p + 5, end, msg);
+  }
+  if (hasPrefix(p, end, "RESULT:")) {
+    msg.type = MSG_RESULT;
+    p += 7;
+    if (hasPrefix(p, end, "HIT")) msg.result = RESULT_HIT;
+    else if (hasPrefix(p, end, "MISS")) msg.result = RESULT_MISS;
+    else if (hasPrefix(p, end, "SINK")) msg.result = RESULT_SINK;
+    else return false;
+    return true;
+  }
+  if (hasPrefix(p, end, "PING:")) {
+    msg.type = MSG_PING;
+    p += 5;
+    return parseDecimal(p, end, msg.value);
+  }
+  if (hasPrefix(p, end, "PONG:")) {
+    msg.type = MSG_PONG;
+    p += 5;
+    return parseDecimal(p, end, msg.value) && p < end && *p++ == ',' && parseDecimal(p, end, msg.echo);
+  }
+  if (hasPrefix(p, end, "STATS")) {
+    msg.type = MSG_STATS;
+    return true;
+  }
+  if (hasPrefix(p, end, "HELLO:")) {
+    // "HELLO:<table>", answered as "HELLO:<table>,<state>,<role>"
+    uint32_t table, state = 0, role = 0;
+    msg.type = MSG_HELLO;
+    p += 6;
+    if (!parseDecimal(p, end, table) || table > 0xFFFF) return false;
+    if (p < end && *p == ',' && !(parseDecimal(++p, end, state) && p < end && *p++ == ',' && parseDecimal(p, end, role)))
+      return false;
+    msg.table = (uint16_t)table;
+    msg.relayState = (uint8_t)state;
+    msg.role = (uint8_t)role;
+    return true;
+  }
+  if (hasPrefix(p, end, "BEACON:")) {
+    uint32_t config;
+    msg.type = MSG_BEACON;
+    p += 7;
+    if (!parseHex(p, end, msg.value) || p >= end || *p++ != ',') return false;
+    if (!parseHex(p, end, msg.echo) || p >= end || *p++ != ',') return false;
+    if (!parseHex(p, end, config) || config > 0xFFFF) return false;
+    msg.configHash = (uint16_t)config;
+    return true;
+  }
+  return false;
+}
+
+// Decode a received datagram in place; accepts binary and legacy text. An
+// AIM's trail and STATE_SYNC's data point into buf, so handle msg before
+// buf is reused.
+inline bool decodeMessage(const uint8_t *buf, int len, Message &msg) {
+  if (len <= 0) return false;
+  if (buf[0] != WIRE_MAGIC) return parseTextMessage((const char *)buf, len, msg);
+  if (len < WIRE_HEADER_LEN) return false;
+  clearMessage(msg, buf[1]);
+  msg.seq = buf[2];
+  msg.sequenced = true;
+  if (msg.type == MSG_NONE || msg.type >= MSG_TYPE_COUNT) return false;
+  int payload = len - WIRE_HEADER_LEN;
+  // Earlier firmware sent READY without the offset
+  bool shortReady = msg.type == MSG_READY && payload >= 4 && payload < 8;
+  if (payload < payloadLength(msg.type) && !shortReady) return false;
+  const uint8_t *p = buf + WIRE_HEADER_LEN;
+  switch (msg.type) {
+    case MSG_READY:
+      msg.value = getU32(p);
+      msg.offset = shortReady ? OFFSET_UNKNOWN : (int32_t)getU32(p + 4);
+      break;
+    case MSG_AIM:
+      msg.x = p[0];
+      msg.y = p[1];
+      if (payload < 3) break;
+      msg.aimCount = p[2] & 0x0F;
+      msg.aimAge = p[2] >> 4;
+      if (msg.aimCount > AIM_TRAIL_MAX || payload < 3 + msg.aimCount) return false;
+      msg.aimTrail = p + 3;
+      break;
+    case MSG_SHOT:
+      msg.x = p[0];
+      msg.y = p[1];
+      break;
+    case MSG_RESULT:
+      msg.result = p[0];
+      break;
+    case MSG_ACK:
+      msg.ackBits = (uint16_t)(p[0] | (p[1] << 8));
+      break;
+    case MSG_PING:
+      msg.value = getU32(p);
+      break;
+    case MSG_PONG:
+      msg.value = getU32(p);
+      msg.echo = getU32(p + 4);
+      break;
+    case MSG_HELLO:
+      msg.table = (uint16_t)(p[0] | (p[1] << 8));
+      msg.relayState = p[2];
+      msg.role = p[3];
+      break;
+    case MSG_BEACON:
+      msg.value = getU32(p);
+      msg.echo = getU32(p + 4);
+      msg.configHash = (uint16_t)(p[8] | (p[9] << 8));
+      break;
+    case MSG_STATE_SYNC:
+      if (payload - 3 > STATE_SYNC_MAX_DATA) return false;
+      msg.syncFlags = p[0];
+      msg.gameTag = (uint16_t)(p[1] | (p[2] << 8));
+      msg.syncLen = (uint8_t)(payload - 3);
+      msg.syncData = p + 3;
+      break;
+  }
+  return true;
+}
+
+#endif // PROTOCOL_H
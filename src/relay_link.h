@@ -0,0 +1,61 @@
+#ifndef RELAY_LINK_H
+#define RELAY_LINK_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "dispatcher.h"
+#include "log.h"
+#include "protocol.h"
+#include "udp_communication.h"
+
+// Registration with the relay server (USE_RELAY, see src/host/relay). The
+// board sends a HELLO for RELAY_TABLE every RELAY_HELLO_MS until the relay
+// answers that the table's other board has registered too; the relay then
+// forwards everything either board sends. Game traffic sent before that is
+// dropped by the relay and retransmitted by the reliable link. If the
+// other board goes away the relay answers with RELAY_WAITING again and
+// registration starts over.
+
+static const unsigned long RELAY_HELLO_MS = 1000;
+
+static bool relayPaired = false;
+static uint8_t relayRole = 0;  // 0 = this board registered first
+static unsigned long relayHelloAt = 0;
+static bool relayHelloSent = false;
+
+inline void relayOnHello(const Message &msg) {
+  if (msg.table != RELAY_TABLE) return;
+  bool paired = msg.relayState == RELAY_PAIRED;
+  if (paired != relayPaired) {
+    if (paired) LOG(RELAY_PAIRED, msg.table, msg.role);
+    else LOG(RELAY_WAITING, msg.table);
+  }
+  relayPaired = paired;
+  relayRole = msg.role;
+}
+
+inline void relayBegin() {
+  onMessage(MSG_HELLO, relayOnHello);
+}
+
+// Register again, as after a WiFi reconnect that may have given this board
+// another address. The relay answers a HELLO from an address it knows at
+// once, so an unchanged one costs a single round trip.
+inline void relayRestart() {
+  relayPaired = false;
+  relayHelloSent = false;
+}
+
+// Register while unpaired; call from the network task while connected.
+inline void relayPoll() {
+  unsigned long now = millis();
+  if (relayPaired || (relayHelloSent && now - relayHelloAt < RELAY_HELLO_MS)) return;
+  Message hello = makeMessage(MSG_HELLO);
+  hello.table = RELAY_TABLE;
+  // Straight to the relay: HELLO is repeated, not retransmitted
+  sendMessageTo(RELAY_IP, RELAY_PORT, hello);
+  relayHelloAt = now;
+  relayHelloSent = true;
+}
+
+#endif // RELAY_LINK_H
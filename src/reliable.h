@@ -0,0 +1,290 @@
+#ifndef RELIABLE_H
+#define RELIABLE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "protocol.h"
+
+// Reliable delivery for turn-critical messages (READY, SHOT, RESULT) over an
+// unreliable datagram transport. Every sequenced packet is acknowledged with
+// the highest sequence number seen plus a bitmap of the 16 before it;
+// unacknowledged packets are retransmitted after an RTO derived from the
+// measured round-trip time, and duplicates are dropped on receive. They
+// are delivered in order: one that overtakes an earlier packet is
+// acknowledged and held until the missing one arrives (rlNextHeld), so a
+// SHOT never arrives before the RESULT its sender answered first, and the
+// bitmap spares the sender resending what was held. AIM updates and ACKs
+// bypass the layer. Transport and clock are supplied by
+// the caller so the same code runs on the host.
+//
+// Nothing is given up on: a packet is retransmitted at the capped RTO for
+// as long as the link is polled (pollNetwork stops while the peer is
+// unreachable). Turn-based play keeps few packets unacknowledged at once;
+// one that finds every slot busy waits, unnumbered, in a short queue and
+// takes the next slot freed, so the numbering stays in send order.
+
+static const uint8_t RELIABLE_SLOTS = 4;
+static const uint8_t RELIABLE_QUEUE = 4;
+static const uint16_t RTO_INITIAL_MS = 250;
+static const uint16_t RTO_MIN_MS = 40;
+static const uint16_t RTO_MAX_MS = 2000;
+
+typedef void (*PacketSender)(const uint8_t *data, uint8_t len);
+
+struct PendingPacket {
+  bool inUse;
+  uint8_t seq;
+  uint8_t len;
+  uint8_t retries;
+  uint32_t firstSentAt;
+  uint32_t lastSentAt;
+  uint8_t data[WIRE_MAX_LEN];
+};
+
+struct LinkStats {
+  uint16_t sent;
+  uint16_t retransmits;
+  uint16_t duplicates;
+  uint16_t queued;     // waited for a slot
+  uint16_t refused;    // found the queue full too: not sent
+};
+
+struct ReliableLink {
+  PacketSender send;
+  uint8_t nextSeq;
+  PendingPacket pending[RELIABLE_SLOTS];
+  // Reliable messages waiting for a slot, oldest first
+  Message queued[RELIABLE_QUEUE];
+  uint8_t queuedCount;
+  // Receive window: rxWindow bit i = (rxHighest - i) was received
+  uint8_t rxHighest;
+  uint32_t rxWindow;
+  // Delivered in order up to rxDelivered. A packet received ahead of a
+  // missing one waits in held[seq % RELIABLE_SLOTS], its bit set in
+  // heldMask; the peer never has more than RELIABLE_SLOTS in flight.
+  uint8_t rxDelivered;
+  uint8_t heldMask;
+  Message held[RELIABLE_SLOTS];
+  // RTT estimate in ms (Jacobson/Karels, scaled by 8 and 4)
+  uint16_t srtt8, rttvar4, rto;
+  LinkStats stats;
+};
+
+constexpr bool isReliableType(uint8_t type) {
+  return type == MSG_READY || type == MSG_SHOT || type == MSG_RESULT;
+}
+
+// Reliable messages are copied into queued and may be sent long after
+// rlSend returns, so they must not point at the caller's buffers
+static_assert(!isReliableType(MSG_AIM), "AIM borrows aimTrail and cannot be queued");
+static_assert(!isReliableType(MSG_STATE_SYNC), "STATE_SYNC borrows syncData and cannot be queued");
+static_assert(RELIABLE_SLOTS <= 8, "heldMask has a bit per slot");
+
+// Take every sequence number before seq as received, as when the peer has
+// restarted its numbering at seq: its old packets are all duplicates now.
+inline void rlExpectSeq(ReliableLink &link, uint8_t seq) {
+  link.rxHighest = link.rxDelivered = (uint8_t)(seq - 1);
+  link.rxWindow = 0xFFFFFFFFUL;
+  link.heldMask = 0;
+}
+
+// The peer numbers from 0, so whatever arrives first, seq 0 is delivered
+// first.
+inline void rlInit(ReliableLink &link, PacketSender send) {
+  memset(&link, 0, sizeof(link));
+  link.send = send;
+  link.rto = RTO_INITIAL_MS;
+  rlExpectSeq(link, 0);
+}
+
+inline uint16_t rlSmoothedRtt(const ReliableLink &link) {
+  return link.srtt8 >> 3;
+}
+
+inline void rlSampleRtt(ReliableLink &link, uint32_t sample) {
+  if (sample > RTO_MAX_MS) sample = RTO_MAX_MS;
+  if (sample == 0) sample = 1;
+  if (!link.srtt8) {
+    link.srtt8 = (uint16_t)(sample << 3);
+    link.rttvar4 = (uint16_t)(sample << 1);
+  } else {
+    int32_t err = (int32_t)sample - (link.srtt8 >> 3);
+    link.srtt8 += err;
+    if (err < 0) err = -err;
+    link.rttvar4 += err - (link.rttvar4 >> 2);
+  }
+  uint32_t rto = (link.srtt8 >> 3) + link.rttvar4;
+  link.rto = rto < RTO_MIN_MS ? RTO_MIN_MS : rto > RTO_MAX_MS ? RTO_MAX_MS : rto;
+}
+
+inline PendingPacket *rlFreeSlot(ReliableLink &link) {
+  for (uint8_t i = 0; i < RELIABLE_SLOTS; i++)
+    if (!link.pending[i].inUse) return &link.pending[i];
+  return nullptr;
+}
+
+// Number msg, send it and keep it in p until acknowledged.
+inline void rlTransmit(ReliableLink &link, PendingPacket &p, const Message &msg, uint32_t now) {
+  Message m = msg;
+  m.seq = link.nextSeq++;
+  p.len = encodeMessage(m, p.data);
+  link.send(p.data, p.len);
+  link.stats.sent++;
+  p.inUse = true;
+  p.seq = m.seq;
+  p.retries = 0;
+  p.firstSentAt = p.lastSentAt = now;
+}
+
+// Encode and send msg. Reliable types are numbered and kept until
+// acknowledged, or queued behind the busy slots; anything else goes out
+// once with the caller's seq, since the peer's receive window only
+// advances on reliable types. Returns false if msg was not sent because
+// the queue was full as well.
+inline bool rlSend(ReliableLink &link, const Message &msg, uint32_t now) {
+  if (!isReliableType(msg.type)) {
+    uint8_t buf[WIRE_MAX_LEN];
+    link.send(buf, encodeMessage(msg, buf));
+    link.stats.sent++;
+    return true;
+  }
+  PendingPacket *p = link.queuedCount ? nullptr : rlFreeSlot(link);
+  if (p) {
+    rlTransmit(link, *p, msg, now);
+    return true;
+  }
+  if (link.queuedCount == RELIABLE_QUEUE) {
+    link.stats.refused++;
+    return false;
+  }
+  link.queued[link.queuedCount++] = msg;
+  link.stats.queued++;
+  return true;
+}
+
+inline void rlHandleAck(ReliableLink &link, const Message &ack, uint32_t now) {
+  for (uint8_t i = 0; i < RELIABLE_SLOTS; i++) {
+    PendingPacket &p = link.pending[i];
+    if (!p.inUse) continue;
+    uint8_t d = (uint8_t)(ack.seq - p.seq);
+    bool acked = d == 0 || (d <= 16 && (ack.ackBits & (1u << (d - 1))));
+    if (!acked) continue;
+    // Karn: only time packets that were never retransmitted
+    if (p.retries == 0) rlSampleRtt(link, now - p.firstSentAt);
+    p.inUse = false;
+  }
+}
+
+// Record seq in the receive window. Returns false if it was already seen.
+inline bool rlAcceptSeq(ReliableLink &link, uint8_t seq) {
+  int8_t d = (int8_t)(seq - link.rxHighest);
+  if (d > 0) {
+    link.rxWindow = d >= 32 ? 1 : (link.rxWindow << d) | 1;
+    link.rxHighest = seq;
+    return true;
+  }
+  uint8_t back = (uint8_t)(-d);
+  if (back >= 32) return false;
+  uint32_t bit = 1UL << back;
+  if (link.rxWindow & bit) return false;
+  link.rxWindow |= bit;
+  return true;
+}
+
+// The oldest sequence number the peer has not acknowledged yet: that of
+// the oldest pending packet, or the next to be numbered.
+inline uint8_t rlFirstUnacked(const ReliableLink &link) {
+  uint8_t first = link.nextSeq;
+  for (uint8_t i = 0; i < RELIABLE_SLOTS; i++) {
+    const PendingPacket &p = link.pending[i];
+    if (p.inUse && (uint8_t)(link.nextSeq - p.seq) > (uint8_t)(link.nextSeq - first)) first = p.seq;
+  }
+  return first;
+}
+
+inline void rlSendAck(ReliableLink &link) {
+  Message ack = makeMessage(MSG_ACK);
+  ack.seq = link.rxHighest;
+  ack.ackBits = (uint16_t)(link.rxWindow >> 1);
+  uint8_t buf[WIRE_MAX_LEN];
+  link.send(buf, encodeMessage(ack, buf));
+}
+
+// Order a received reliable packet, without acknowledging it. Returns true
+// if msg is the next in sequence and should be delivered now. One ahead of
+// a missing packet is recorded and held for rlNextHeld; duplicates are
+// dropped, and so is anything further ahead than the peer can have sent.
+inline bool rlSequence(ReliableLink &link, const Message &msg) {
+  int8_t ahead = (int8_t)(msg.seq - link.rxDelivered);
+  if (ahead > (int8_t)RELIABLE_SLOTS) return false;
+  if (!rlAcceptSeq(link, msg.seq)) {
+    link.stats.duplicates++;
+    return false;
+  }
+  if (ahead == 1) {
+    link.rxDelivered = msg.seq;
+    return true;
+  }
+  link.held[msg.seq % RELIABLE_SLOTS] = msg;
+  link.heldMask |= 1 << (msg.seq % RELIABLE_SLOTS);
+  return false;
+}
+
+// The next held packet, once everything before it has been delivered. Call
+// after delivering what rlReceive or rlSequence returned, until false.
+inline bool rlNextHeld(ReliableLink &link, Message &msg) {
+  uint8_t seq = (uint8_t)(link.rxDelivered + 1);
+  uint8_t slot = seq % RELIABLE_SLOTS;
+  if (!(link.heldMask & (1 << slot)) || link.held[slot].seq != seq) return false;
+  link.heldMask &= ~(1 << slot);
+  msg = link.held[slot];
+  link.rxDelivered = seq;
+  return true;
+}
+
+// Process a decoded packet. Returns true if it should be delivered to the
+// game, false for ACKs, duplicates and packets held ahead of one still
+// missing.
+inline bool rlReceive(ReliableLink &link, const Message &msg, uint32_t now) {
+  if (msg.type == MSG_ACK) {
+    rlHandleAck(link, msg, now);
+    return false;
+  }
+  if (!msg.sequenced || !isReliableType(msg.type)) return true;
+  bool deliver = rlSequence(link, msg);
+  // Always acknowledge: the sender may have missed our previous ACK, and
+  // a held packet's bit tells it what not to resend
+  rlSendAck(link);
+  return deliver;
+}
+
+// Send what waits for a slot, then retransmit anything whose RTO has
+// expired, with exponential backoff up to RTO_MAX_MS.
+inline void rlPoll(ReliableLink &link, uint32_t now) {
+  PendingPacket *free;
+  while (link.queuedCount && (free = rlFreeSlot(link))) {
+    rlTransmit(link, *free, link.queued[0], now);
+    link.queuedCount--;
+    memmove(link.queued, link.queued + 1, link.queuedCount * sizeof(Message));
+  }
+  for (uint8_t i = 0; i < RELIABLE_SLOTS; i++) {
+    PendingPacket &p = link.pending[i];
+    if (!p.inUse) continue;
+    uint32_t timeout = (uint32_t)link.rto << (p.retries < 4 ? p.retries : 4);
+    if (timeout > RTO_MAX_MS) timeout = RTO_MAX_MS;
+    if (now - p.lastSentAt < timeout) continue;
+    if (p.retries < 0xFF) p.retries++;
+    p.lastSentAt = now;
+    link.send(p.data, p.len);
+    link.stats.retransmits++;
+  }
+}
+
+inline bool rlIdle(const ReliableLink &link) {
+  if (link.queuedCount) return false;
+  for (uint8_t i = 0; i < RELIABLE_SLOTS; i++)
+    if (link.pending[i].inUse) return false;
+  return true;
+}
+
+#endif // RELIABLE_H
@@ -0,0 +1,46 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// Minimal cooperative scheduler: each task runs from loop() whenever its
+// period has elapsed. Tasks must return quickly; nothing here preempts.
+
+typedef void (*TaskFn)();
+
+struct Task {
+  TaskFn fn;
+  unsigned long periodUs;
+  unsigned long lastRunUs;
+};
+
+static const uint8_t MAX_TASKS = 8;
+static Task tasks[MAX_TASKS];
+static uint8_t taskCount = 0;
+
+// Register fn to run every periodUs microseconds (0 = every pass).
+// Returns false if the task table is full.
+inline bool addTask(TaskFn fn, unsigned long periodUs) {
+  if (taskCount >= MAX_TASKS) return false;
+  tasks[taskCount].fn = fn;
+  tasks[taskCount].periodUs = periodUs;
+  tasks[taskCount].lastRunUs = micros() - periodUs;  // due immediately
+  taskCount++;
+  return true;
+}
+
+// Run every task that is due, in registration order.
+inline void runTasks() {
+  for (uint8_t i = 0; i < taskCount; i++) {
+    Task &t = tasks[i];
+    unsigned long now = micros();
+    if (now - t.lastRunUs < t.periodUs) continue;
+    // Advance by whole periods so a late task keeps its cadence without
+    // bursting to catch up
+    unsigned long late = now - t.lastRunUs;
+    t.lastRunUs += t.periodUs ? late - (late % t.periodUs) : late;
+    t.fn();
+  }
+}
+
+#endif
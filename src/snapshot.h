@@ -0,0 +1,604 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "config.h"
+#include "dispatcher.h"
+#include "eeprom_layout.h"
+#include "game_logic.h"
+#include "log.h"
+#include "protocol.h"
+#include "udp_communication.h"
+#if !USE_RELAY && USE_DISCOVERY
+#include "discovery.h"
+#endif
+
+// Game snapshot (SNAPSHOT): the game in progress kept in EEPROM, so a board
+// that resets picks it up again at boot, before WiFi is even up, and then
+// reconciles it with the other board (STATE_SYNC).
+//
+// From EEPROM_SNAPSHOT_ADDR:
+//   fleet    u16 game tag, per boat u8 x | y << 4, u16 vertical boats,
+//            u16 CRC; written once per game
+//   boards   shotAtMap, then opponentMap's two planes, as in memory but
+//            with every bit inverted
+//   records  SNAPSHOT_RECORDS commit records of u16 generation, u8 state,
+//            u8 aim x | y << 4, u16 CRC of the boards, u16 CRC of the
+//            record and the fleet CRC
+// A shot changes a byte or two of the boards, which are updated in place;
+// within a game their bytes only gain bits, so they wear slowly. Stored
+// inverted, an erased byte reads as no shots, and one a reset caught
+// between erase and write reads as part of what was being written: the
+// boards in EEPROM never hold a shot that was not taken. The record
+// changes with every save and goes to slot generation % SNAPSHOT_RECORDS,
+// so those writes are spread over the whole ring. At boot the newest
+// record whose check holds is the snapshot. If the boards do not match its
+// CRC (the reset came mid-save) they are restored all the same, as a part
+// of the game, and the shots they lack come back from the other board.
+//
+// Saving never blocks: each poll writes at most one byte that differs, a
+// few ms of EEPROM time on the ATmega4809, every SNAPSHOT_WRITE_MS. The
+// record is written once a whole pass over fleet and boards found nothing
+// left to write, so its CRC is of what EEPROM holds.
+//
+// STATE_SYNC: a resumed board sends a digest of every row, one byte from
+// the cells fired at it and those it fired at, and a CRC-16 of them all,
+// until the other board replies with its own. Each side sends the rows
+// whose digest differs from its own view of them (SYNC_ROWS), or every row
+// if none does but the CRC does (one byte per row lets a changed row
+// through 1 time in 256), and merges the rows it gets: shots only add, so
+// the union is the game. Misses count too, so once the two agree
+// the resumed board knows whether the shot it was waiting on was answered,
+// and fires it again only if it was not. A SHOT that comes before then is
+// held until they agree, as our boards cannot yet tell whether it is the
+// other board's turn. A board in another game (another tag, 0 for none)
+// makes the resumed one drop its snapshot and place again.
+//
+// The resumed board's reliable link numbers from 0 again, which the other
+// board's receive window would take for old packets, and its own window
+// starts at 0 where the other board's numbering has moved on. So
+// STATE_SYNC goes outside the link, and a digest carries a nonce for this
+// boot and the first sequence number its sender has not had acknowledged.
+// The other board restarts its window there once per nonce, and the
+// resumed board does so at its first reply; until then it holds its own
+// traffic back (peerHeld). STATE_SYNC is
+// binary only: text builds restore but do not resync.
+
+static const uint8_t SNAPSHOT_VERSION = 3;
+static const unsigned long SNAPSHOT_WRITE_MS = 5;
+static const unsigned long SYNC_RETRY_MS = 1000;
+static const uint8_t SYNC_MAX_TRIES = 15;
+
+// Record state: gamePhase in the low two bits
+static const uint8_t SNAPSHOT_AWAITING = 0x04;  // awaitingResult
+static const uint8_t SNAPSHOT_FIRST = 0x08;     // we took the first shot
+static const uint8_t SNAPSHOT_ACTIVE = 0x80;    // clear once the game is over
+
+static const uint16_t SNAPSHOT_FLEET_LEN = 2 + BOAT_COUNT + 2 + 2;
+static const uint16_t SNAPSHOT_IMAGE_LEN = SNAPSHOT_FLEET_LEN + sizeof(BitBoard) + sizeof(CellPlanes);
+static const uint8_t SNAPSHOT_RECORD_LEN = 8;
+static const uint8_t SNAPSHOT_RECORDS = (EEPROM_SNAPSHOT_SIZE - SNAPSHOT_IMAGE_LEN) / SNAPSHOT_RECORD_LEN;
+static const uint16_t SNAPSHOT_RECORDS_ADDR = EEPROM_SNAPSHOT_ADDR + SNAPSHOT_IMAGE_LEN;
+// u8 y, then the sender's u16 shot at (shotAtMap), hit (hitMap), fired
+// (any opponentMap cell) and sunk (its own sunk boats)
+static const uint8_t SYNC_ROW_LEN = 9;
+
+static_assert(SNAPSHOT_IMAGE_LEN + 2 * SNAPSHOT_RECORD_LEN <= EEPROM_SNAPSHOT_SIZE, "the snapshot does not fit in EEPROM");
+static_assert(WIDTH <= 16 && HEIGHT <= 16, "cells are stored as nibbles");
+static_assert(BOAT_COUNT <= 16, "vertical boats are a 16-bit mask");
+static_assert(PHASE_WAIT_FOR_OPPONENT < 4, "gamePhase is stored in two bits");
+static_assert(4 + HEIGHT <= STATE_SYNC_MAX_DATA, "a digest must fit one STATE_SYNC");
+
+extern bool finished;
+
+static uint16_t snapshotTag = 0;  // this game's, 0 = not in one
+static uint16_t snapshotFleetCrc = 0;
+static uint16_t snapshotGen = 0;  // of the newest record
+static uint8_t snapshotSavedMoves = 0;
+static bool snapshotOver = false;
+static bool snapshotFirst = false;  // we took the game's first shot
+static bool snapshotSaving = false;
+static bool snapshotPassWrote = false;
+static uint16_t snapshotCursor = 0;
+static uint8_t snapshotRecord[SNAPSHOT_RECORD_LEN];
+static uint8_t snapshotRecordPos = SNAPSHOT_RECORD_LEN;  // next byte of it to write
+static unsigned long snapshotWriteAt = 0;
+
+static bool syncPending = false;
+static uint8_t syncTries = 0;
+static unsigned long syncSentAt = 0;
+static uint8_t syncNonce = 0;      // ours while resuming, never 0
+static uint8_t syncPeerNonce = 0;  // the last the other board resumed with
+static bool syncShotHeld = false;  // a SHOT came before the views agreed
+static uint8_t syncShotX = 0;
+static uint8_t syncShotY = 0;
+
+inline uint16_t snapshotCrc(uint16_t crc, uint8_t b) {
+  crc ^= (uint16_t)b << 8;
+  for (uint8_t i = 0; i < 8; i++) crc = crc & 0x8000 ? (uint16_t)(crc << 1 ^ 0x1021) : (uint16_t)(crc << 1);
+  return crc;
+}
+
+// Fleet CRCs start from the layout and configuration, so a build for
+// another preset never takes this one's snapshot.
+inline uint16_t snapshotSeed() {
+  uint16_t crc = snapshotCrc(0xFFFF, SNAPSHOT_VERSION);
+  crc = snapshotCrc(crc, WIDTH);
+  crc = snapshotCrc(crc, HEIGHT);
+  for (uint8_t i = 0; i < BOAT_COUNT; i++) crc = snapshotCrc(crc, GameFleet::sizes[i]);
+  return crc;
+}
+
+inline uint16_t snapshotVertical() {
+  uint16_t mask = 0;
+  for (uint8_t i = 0; i < BOAT_COUNT; i++)
+    if (boats[i].vertical) mask |= 1u << i;
+  return mask;
+}
+
+// Byte i of fleet and boards as they should be in EEPROM.
+inline uint8_t snapshotImageByte(uint16_t i) {
+  if (i < 2) return (uint8_t)(snapshotTag >> (8 * i));
+  i -= 2;
+  if (i < BOAT_COUNT) return (uint8_t)(boats[i].x | boats[i].y << 4);
+  i -= BOAT_COUNT;
+  if (i < 2) return (uint8_t)(snapshotVertical() >> (8 * i));
+  i -= 2;
+  if (i < 2) return (uint8_t)(snapshotFleetCrc >> (8 * i));
+  i -= 2;
+  if (i < sizeof(BitBoard)) return (uint8_t)~((const uint8_t*)&shotAtMap)[i];
+  return (uint8_t)~((const uint8_t*)&opponentMap)[i - sizeof(BitBoard)];
+}
+
+inline uint16_t snapshotBoardsCrc() {
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = SNAPSHOT_FLEET_LEN; i < SNAPSHOT_IMAGE_LEN; i++)
+    crc = snapshotCrc(crc, EEPROM.read(EEPROM_SNAPSHOT_ADDR + i));
+  return crc;
+}
+
+inline uint16_t snapshotRecordCheck(const uint8_t* rec, uint16_t fleetCrc) {
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < SNAPSHOT_RECORD_LEN - 2; i++) crc = snapshotCrc(crc, rec[i]);
+  crc = snapshotCrc(crc, (uint8_t)fleetCrc);
+  return snapshotCrc(crc, (uint8_t)(fleetCrc >> 8));
+}
+
+// Shots each side has taken; ours counts one still unanswered.
+inline uint16_t snapshotShotsTaken(bool ours) {
+  uint16_t n = ours && awaitingResult && cpGet(opponentMap, aimX, aimY) == CELL_UNKNOWN;
+  for (int y = 0; y < HEIGHT; y++)
+    for (RowMask row = ours ? opponentMap.lo.rows[y] | opponentMap.hi.rows[y] : shotAtMap.rows[y]; row; row &= row - 1) n++;
+  return n;
+}
+
+inline bool snapshotGameOver() {
+  bool mineSunk = true;
+  for (uint8_t i = 0; i < BOAT_COUNT; i++)
+    if (!boatSunk(i)) mineSunk = false;
+  uint16_t theirsSunk = 0;
+  for (int y = 0; y < HEIGHT; y++)
+    for (RowMask row = opponentMap.lo.rows[y] & opponentMap.hi.rows[y]; row; row &= row - 1) theirsSunk++;
+  return mineSunk || theirsSunk >= GameFleet::cells;
+}
+
+inline void snapshotRecountHits() {
+  for (uint8_t i = 0; i < BOAT_COUNT; i++) {
+    Boat& b = boats[i];
+    b.hits = 0;
+    for (uint8_t k = 0; k < MAX_SPAN && k < b.size; k++)
+      if (bbGet(hitMap, b.vertical ? b.x : b.x + k, b.vertical ? b.y + k : b.y)) b.hits++;
+  }
+}
+
+// The game just started: both boards derive the same tag from the two
+// READY times.
+inline void snapshotStartGame() {
+  snapshotTag = (uint16_t)(placementFinishedTime + opponentPlacementTime);
+  if (!snapshotTag) snapshotTag = 1;
+  uint16_t crc = snapshotSeed();
+  for (uint16_t i = 0; i < SNAPSHOT_FLEET_LEN - 2; i++) crc = snapshotCrc(crc, snapshotImageByte(i));
+  snapshotFleetCrc = crc;
+  snapshotSavedMoves = gameMoves - 1;  // save at once
+  snapshotOver = false;
+}
+
+inline void snapshotBuildRecord(bool over) {
+  snapshotGen++;
+  uint16_t boardsCrc = snapshotBoardsCrc();
+  uint8_t* r = snapshotRecord;
+  r[0] = (uint8_t)snapshotGen;
+  r[1] = (uint8_t)(snapshotGen >> 8);
+  // Turns alternate, so the side ahead took the first shot; level, the
+  // side about to shoot did
+  uint16_t ours = snapshotShotsTaken(true), theirs = snapshotShotsTaken(false);
+  bool first = ours != theirs ? ours > theirs : !awaitingResult && (gamePhase == PHASE_MY_TURN || gamePhase == PHASE_OPPONENT_SHOT);
+  r[2] = over ? 0 : (uint8_t)(SNAPSHOT_ACTIVE | (awaitingResult ? SNAPSHOT_AWAITING : 0) | (first ? SNAPSHOT_FIRST : 0) | gamePhase);
+  r[3] = (uint8_t)(aimX | aimY << 4);
+  r[4] = (uint8_t)boardsCrc;
+  r[5] = (uint8_t)(boardsCrc >> 8);
+  uint16_t check = snapshotRecordCheck(r, snapshotFleetCrc);
+  r[6] = (uint8_t)check;
+  r[7] = (uint8_t)(check >> 8);
+  snapshotRecordPos = 0;
+  snapshotSavedMoves = gameMoves;
+  snapshotOver = over;
+}
+
+// Write the next byte of a save that is due; call every few ms.
+inline void snapshotPoll() {
+  unsigned long now = millis();
+  if (now - snapshotWriteAt < SNAPSHOT_WRITE_MS) return;
+  if (!snapshotSaving) {
+    // The last save of a game is the one that closes it
+    if (snapshotOver) return;
+    if (!snapshotTag) {
+      // Started on the READY timeout: wait for the other READY, so both
+      // boards tag the game alike
+      if (readyState != READY_SYNCED || !opponentPlacementTimeReceived) return;
+      snapshotStartGame();
+    }
+    bool over = snapshotGameOver();
+    if (gameMoves == snapshotSavedMoves && !over) return;
+    snapshotSaving = true;
+    snapshotPassWrote = false;
+    snapshotCursor = 0;
+  }
+  if (snapshotRecordPos == SNAPSHOT_RECORD_LEN) {
+    for (; snapshotCursor < SNAPSHOT_IMAGE_LEN; snapshotCursor++) {
+      uint8_t want = snapshotImageByte(snapshotCursor);
+      if (EEPROM.read(EEPROM_SNAPSHOT_ADDR + snapshotCursor) == want) continue;
+      EEPROM.write(EEPROM_SNAPSHOT_ADDR + snapshotCursor, want);
+      snapshotWriteAt = now;
+      snapshotPassWrote = true;
+      return;
+    }
+    // Bytes already passed may have changed meanwhile: go over them again
+    // until a pass writes nothing
+    snapshotCursor = 0;
+    if (snapshotPassWrote) {
+      snapshotPassWrote = false;
+      return;
+    }
+    bool over = snapshotGameOver();
+    snapshotBuildRecord(over);
+    if (over) LOG(SNAP_OVER);
+  }
+  uint16_t addr = SNAPSHOT_RECORDS_ADDR + (snapshotGen % SNAPSHOT_RECORDS) * SNAPSHOT_RECORD_LEN;
+  for (; snapshotRecordPos < SNAPSHOT_RECORD_LEN; snapshotRecordPos++) {
+    uint8_t want = snapshotRecord[snapshotRecordPos];
+    if (EEPROM.read(addr + snapshotRecordPos) == want) continue;
+    EEPROM.write(addr + snapshotRecordPos, want);
+    snapshotWriteAt = now;
+    snapshotRecordPos++;
+    break;
+  }
+  if (snapshotRecordPos == SNAPSHOT_RECORD_LEN) snapshotSaving = false;
+}
+
+// Resume the game in EEPROM, if there is one; call from setup() after
+// beginPlacement(). Returns true when it did.
+inline bool snapshotRestore() {
+  unsigned long start = micros();
+  uint16_t fleetCrc = (uint16_t)(EEPROM.read(EEPROM_SNAPSHOT_ADDR + SNAPSHOT_FLEET_LEN - 2) |
+                                 EEPROM.read(EEPROM_SNAPSHOT_ADDR + SNAPSHOT_FLEET_LEN - 1) << 8);
+  uint8_t rec[SNAPSHOT_RECORD_LEN], best[SNAPSHOT_RECORD_LEN];
+  bool found = false;
+  for (uint8_t i = 0; i < SNAPSHOT_RECORDS; i++) {
+    uint16_t addr = SNAPSHOT_RECORDS_ADDR + i * SNAPSHOT_RECORD_LEN;
+    for (uint8_t j = 0; j < SNAPSHOT_RECORD_LEN; j++) rec[j] = EEPROM.read(addr + j);
+    uint16_t gen = (uint16_t)(rec[0] | rec[1] << 8);
+    if (gen % SNAPSHOT_RECORDS != i || snapshotRecordCheck(rec, fleetCrc) != (uint16_t)(rec[6] | rec[7] << 8)) continue;
+    if (found && (int16_t)(gen - snapshotGen) <= 0) continue;
+    // New records go on after the newest, even if it is not resumed
+    snapshotGen = gen;
+    memcpy(best, rec, sizeof(best));
+    found = true;
+  }
+  if (!found || !(best[2] & SNAPSHOT_ACTIVE)) return false;
+
+  uint16_t crc = snapshotSeed();
+  for (uint16_t i = 0; i < SNAPSHOT_FLEET_LEN - 2; i++) crc = snapshotCrc(crc, EEPROM.read(EEPROM_SNAPSHOT_ADDR + i));
+  if (crc != fleetCrc) return false;
+  uint16_t vertical = (uint16_t)(EEPROM.read(EEPROM_SNAPSHOT_ADDR + 2 + BOAT_COUNT) |
+                                 EEPROM.read(EEPROM_SNAPSHOT_ADDR + 3 + BOAT_COUNT) << 8);
+  for (uint8_t i = 0; i < BOAT_COUNT; i++) {
+    uint8_t xy = EEPROM.read(EEPROM_SNAPSHOT_ADDR + 2 + i);
+    boats[i].x = xy & 0x0F;
+    boats[i].y = xy >> 4;
+    boats[i].vertical = (vertical >> i) & 1;
+    bool done = false;
+    confirmPlacement(done);
+    if (currentIndex != i + 1) {
+      beginPlacement();
+      return false;
+    }
+  }
+
+  // A save cut short leaves part of a game, which the resync completes
+  bool complete = snapshotBoardsCrc() == (uint16_t)(best[4] | best[5] << 8);
+  for (uint16_t i = 0; i < sizeof(BitBoard) + sizeof(CellPlanes); i++) {
+    uint8_t b = (uint8_t)~EEPROM.read(EEPROM_SNAPSHOT_ADDR + SNAPSHOT_FLEET_LEN + i);
+    if (i < sizeof(BitBoard)) ((uint8_t*)&shotAtMap)[i] = b;
+    else ((uint8_t*)&opponentMap)[i - sizeof(BitBoard)] = b;
+  }
+  for (int y = 0; y < HEIGHT; y++) hitMap.rows[y] = shotAtMap.rows[y] & occupied.rows[y];
+  snapshotRecountHits();
+  uint8_t phase = best[2] & 3;
+  // A shot on display when the reset came has been seen
+  if (phase == PHASE_SHOW_RESULT) phase = PHASE_WAIT_FOR_OPPONENT;
+  if (phase == PHASE_OPPONENT_SHOT) phase = PHASE_MY_TURN;
+  gamePhase = (GamePhase)phase;
+  awaitingResult = (best[2] & SNAPSHOT_AWAITING) != 0;
+  snapshotFirst = (best[2] & SNAPSHOT_FIRST) != 0;
+  aimX = best[3] & 0x0F;
+  aimY = best[3] >> 4;
+  readyState = READY_SYNCED;
+  opponentReady = true;
+  readyStateStartTime = millis();
+
+  snapshotTag = (uint16_t)(EEPROM.read(EEPROM_SNAPSHOT_ADDR) | EEPROM.read(EEPROM_SNAPSHOT_ADDR + 1) << 8);
+  snapshotFleetCrc = fleetCrc;
+  snapshotSavedMoves = gameMoves;
+#if WIRE_BINARY
+  syncPending = true;
+  peerHeld = true;
+  syncNonce = (uint8_t)(micros() ^ snapshotGen);
+  if (!syncNonce) syncNonce = 1;
+#endif
+  LOG(SNAP_RESUMED, snapshotTag, snapshotGen, micros() - start, complete ? "complete" : "part of the boards");
+  return true;
+}
+
+// The other board is in another game: forget this one and place again.
+inline void snapshotAbandon(uint16_t theirTag) {
+  LOG(SYNC_OTHER_GAME, theirTag, snapshotTag);
+  syncPending = false;
+  syncShotHeld = false;
+  peerHeld = false;
+  snapshotTag = 0;
+  beginPlacement();
+  readyState = READY_PLACEMENT;
+  opponentReady = false;
+  opponentPlacementTimeReceived = false;
+  gamePhase = PHASE_MY_TURN;
+  awaitingResult = false;
+  finished = false;
+}
+
+inline uint8_t syncRowDigest(RowMask shotAt, RowMask fired) {
+  uint16_t h = (uint16_t)(shotAt ^ (uint16_t)(fired * 40503u));
+  h ^= h >> 7;
+  return (uint8_t)(h ^ h >> 8);
+}
+
+// Cells of row y we have fired at, whatever the answer.
+inline RowMask syncFiredRow(int y) {
+  return opponentMap.lo.rows[y] | opponentMap.hi.rows[y];
+}
+
+// CRC of every row as the digests see it: ours, or mirrored to how the
+// other board should see it.
+inline uint16_t syncBoardCrc(bool mirrored) {
+  uint16_t crc = 0xFFFF;
+  for (int y = 0; y < HEIGHT; y++) {
+    RowMask shotAt = shotAtMap.rows[y], fired = syncFiredRow(y);
+    if (mirrored) shotAt = fired, fired = shotAtMap.rows[y];
+    crc = snapshotCrc(crc, (uint8_t)shotAt);
+    crc = snapshotCrc(crc, (uint8_t)(shotAt >> 8));
+    crc = snapshotCrc(crc, (uint8_t)fired);
+    crc = snapshotCrc(crc, (uint8_t)(fired >> 8));
+  }
+  return crc;
+}
+
+// Cells of our sunk boats in row y.
+inline RowMask syncSunkRow(int y) {
+  RowMask sunk = 0;
+  for (int x = 0; x < WIDTH; x++)
+    if (bbGet(hitMap, x, y) && boatSunk(boatIndexAt(x, y))) sunk |= (RowMask)1 << x;
+  return sunk;
+}
+
+inline void syncPutRow(uint8_t* p, RowMask row) {
+  p[0] = (uint8_t)row;
+  p[1] = (uint8_t)(row >> 8);
+}
+
+inline RowMask syncGetRow(const uint8_t* p) {
+  return (RowMask)((p[0] | p[1] << 8) & rowSpan(0, WIDTH));
+}
+
+inline void syncSendDigest(uint8_t flags) {
+  uint8_t data[4 + HEIGHT];
+  data[0] = syncPending ? syncNonce : 0;
+  data[1] = rlFirstUnacked(peerLink);
+  uint16_t crc = syncBoardCrc(false);
+  data[2] = (uint8_t)crc;
+  data[3] = (uint8_t)(crc >> 8);
+  for (int y = 0; y < HEIGHT; y++) data[4 + y] = syncRowDigest(shotAtMap.rows[y], syncFiredRow(y));
+  Message m = makeMessage(MSG_STATE_SYNC);
+  m.syncFlags = SYNC_DIGEST | flags;
+  m.gameTag = snapshotTag;
+  m.syncData = data;
+  m.syncLen = sizeof(data);
+  sendMessageTo(peerIp(), peerPort(), m);
+}
+
+// Send every row whose digest from the other board differs from what it
+// should be by our view, or every row if only crc does. Returns how many.
+inline uint8_t syncSendRows(uint16_t crc, const uint8_t* digests) {
+  // What it was shot at is what we fired at, and the other way round
+  bool all = crc != syncBoardCrc(true);
+  for (int y = 0; y < HEIGHT && all; y++)
+    if (digests[y] != syncRowDigest(syncFiredRow(y), shotAtMap.rows[y])) all = false;
+  uint8_t data[STATE_SYNC_MAX_DATA];
+  Message m = makeMessage(MSG_STATE_SYNC);
+  m.syncFlags = SYNC_ROWS;
+  m.gameTag = snapshotTag;
+  m.syncData = data;
+  uint8_t rows = 0;
+  for (int y = 0; y < HEIGHT; y++) {
+    if (!all && digests[y] == syncRowDigest(syncFiredRow(y), shotAtMap.rows[y])) continue;
+    uint8_t* p = data + m.syncLen;
+    p[0] = (uint8_t)y;
+    syncPutRow(p + 1, shotAtMap.rows[y]);
+    syncPutRow(p + 3, hitMap.rows[y]);
+    syncPutRow(p + 5, syncFiredRow(y));
+    syncPutRow(p + 7, syncSunkRow(y));
+    m.syncLen += SYNC_ROW_LEN;
+    rows++;
+    if (m.syncLen + SYNC_ROW_LEN > STATE_SYNC_MAX_DATA) {
+      sendMessageTo(peerIp(), peerPort(), m);
+      m.syncLen = 0;
+    }
+  }
+  if (m.syncLen) sendMessageTo(peerIp(), peerPort(), m);
+  if (rows) LOG(SYNC_SENT, rows);
+  return rows;
+}
+
+// Merge a row from the other board: its shots on us, ours on it with what
+// they hit, and which of its boats those sank.
+inline bool syncMergeRow(const uint8_t* p) {
+  int y = p[0];
+  if (y >= HEIGHT) return false;
+  RowMask shotAt = syncGetRow(p + 1), hit = syncGetRow(p + 3), fired = syncGetRow(p + 5), sunk = syncGetRow(p + 7);
+  RowMask fresh = fired & ~shotAtMap.rows[y];
+  bool changed = fresh != 0;
+  shotAtMap.rows[y] |= fresh;
+  fresh &= occupied.rows[y];
+  for (int x = 0; fresh; x++, fresh >>= 1) {
+    if (!(fresh & 1)) continue;
+    bbSet(hitMap, x, y);
+    boats[boatIndexAt(x, y)].hits++;
+  }
+  for (int x = 0; x < WIDTH; x++) {
+    uint8_t cell = cpGet(opponentMap, x, y);
+    uint8_t want = (sunk >> x) & 1     ? (uint8_t)CELL_SUNK
+                   : (hit >> x) & 1    ? (uint8_t)CELL_HIT
+                   : (shotAt >> x) & 1 ? (uint8_t)CELL_MISS
+                                       : cell;
+    if (want <= cell) continue;
+    cpSet(opponentMap, x, y, want);
+    changed = true;
+  }
+  return changed;
+}
+
+// The other board fires one shot a turn, so one is all there is to hold.
+inline void syncOnShot(const Message& msg) {
+  if (!syncPending) {
+    onShotMessage(msg);
+    return;
+  }
+  syncShotHeld = true;
+  syncShotX = msg.x;
+  syncShotY = msg.y;
+}
+
+inline void syncReleaseShot() {
+  if (!syncShotHeld) return;
+  syncShotHeld = false;
+  Message shot = makeMessage(MSG_SHOT);
+  shot.x = syncShotX, shot.y = syncShotY;
+  onShotMessage(shot);
+}
+
+// The record may be a move behind the boards, which the other board has
+// now completed: the side behind shoots next, or level, the one that shot
+// first.
+inline void syncSettleTurn() {
+  if (awaitingResult) return;
+  uint16_t ours = snapshotShotsTaken(true), theirs = snapshotShotsTaken(false);
+  if (!ours && !theirs) return;
+  bool mine = ours != theirs ? ours < theirs : snapshotFirst;
+  if (mine == (gamePhase == PHASE_MY_TURN || gamePhase == PHASE_OPPONENT_SHOT)) return;
+  LOG(SYNC_TURN, mine ? "ours" : "theirs");
+  gamePhase = mine ? PHASE_MY_TURN : PHASE_WAIT_FOR_OPPONENT;
+  gameMoves++;
+}
+
+inline void onStateSync(const Message& msg) {
+  if (msg.syncFlags & SYNC_ROWS) {
+    if (msg.gameTag != snapshotTag || !snapshotTag) return;
+    uint8_t merged = 0;
+    for (uint8_t i = 0; i + SYNC_ROW_LEN <= msg.syncLen; i += SYNC_ROW_LEN)
+      if (syncMergeRow(msg.syncData + i)) merged++;
+    if (!merged) return;
+    gameMoves++;
+    LOG(SYNC_MERGED, merged);
+    return;
+  }
+  if (!(msg.syncFlags & SYNC_DIGEST) || msg.syncLen < 4 + HEIGHT) return;
+  bool reply = msg.syncFlags & SYNC_REPLY;
+  // It restarted: its link numbers from 0 again
+  uint8_t nonce = msg.syncData[0];
+  if (nonce && nonce != syncPeerNonce) {
+    rlExpectSeq(peerLink, msg.syncData[1]);
+    syncPeerNonce = nonce;
+  }
+  // It has heard that we restarted; take its numbering from where it is
+  if (reply && peerHeld) {
+    rlExpectSeq(peerLink, msg.syncData[1]);
+    peerHeld = false;
+  }
+  if (msg.gameTag != snapshotTag || !snapshotTag) {
+    if (!reply) syncSendDigest(SYNC_REPLY);
+    else if (syncPending) snapshotAbandon(msg.gameTag);
+    return;
+  }
+  uint8_t sent = syncSendRows((uint16_t)(msg.syncData[2] | msg.syncData[3] << 8), msg.syncData + 4);
+  if (!reply) {
+    syncSendDigest(SYNC_REPLY);
+    return;
+  }
+  if (!syncPending || sent) return;
+  // Both views agree
+  syncPending = false;
+  LOG(SYNC_DONE, syncTries);
+  if (awaitingResult && gamePhase == PHASE_WAIT_FOR_OPPONENT && cpGet(opponentMap, aimX, aimY) != CELL_UNKNOWN) {
+    // It took the shot while we were down; the rows brought the answer
+    LOG(SYNC_SHOT_ANSWERED, aimX, aimY);
+    awaitingResult = false;
+    gameMoves++;
+  }
+  syncSettleTurn();
+  syncReleaseShot();
+  if (!awaitingResult || gamePhase != PHASE_WAIT_FOR_OPPONENT) return;
+  // It never got the shot: fire it again
+  Message shot = makeMessage(MSG_SHOT);
+  shot.x = aimX, shot.y = aimY;
+  sendMessage(shot);
+}
+
+inline void stateSyncBegin() {
+  onMessage(MSG_STATE_SYNC, onStateSync);
+  onMessage(MSG_SHOT, syncOnShot);
+}
+
+// Offer the digest until the other board answers; call from the network
+// task while connected.
+inline void stateSyncPoll() {
+  if (!syncPending) return;
+#if USE_RELAY
+  if (!relayPaired) return;
+#elif USE_DISCOVERY
+  if (!discoveryLocked) return;
+#endif
+  unsigned long now = millis();
+  if (syncTries && now - syncSentAt < SYNC_RETRY_MS) return;
+  if (syncTries == SYNC_MAX_TRIES) {
+    syncPending = false;
+    peerHeld = false;
+    LOG(SYNC_GAVE_UP);
+    syncReleaseShot();
+    return;
+  }
+  syncTries++;
+  syncSentAt = now;
+  syncSendDigest(SYNC_RESUMED);
+}
+
+#endif // SNAPSHOT_H
@@ -3,38 +3,179 @@
 
 #include <WiFiUdp.h>
 #include "config.h"
+#include "log.h"
+#include "profile.h"
+#include "protocol.h"
+#include "reliable.h"
 
 // Create a UDP object in the implementation translation unit
 extern WiFiUDP udp;
 
-// Initialize UDP on the given local port.
-inline void startUDP(unsigned int localPort = LOCAL_PORT) {
-  udp.begin(localPort);
+// Receive buffer for one datagram; messages are decoded from it in place.
+static uint8_t rxBuffer[WIRE_MAX_LEN];
+static uint8_t txSeq = 0;
+
+// Retransmit/ACK state for traffic with the peer.
+static ReliableLink peerLink;
+
+// When set, sendMessage hands messages to this local peer instead of the
+// network (single-board mode, see ai_peer.h).
+typedef void (*LocalPeer)(const Message& message);
+static LocalPeer localPeer = 0;
+
+inline void setLocalPeer(LocalPeer peer) {
+  localPeer = peer;
 }
 
-// Send a null-terminated message to a specific target IP and port.
-inline void sendMessageTo(const IPAddress& targetIp, unsigned int targetPort, const char* message) {
+// Send raw bytes as one datagram to a specific target IP and port.
+inline void sendPacketTo(const IPAddress& targetIp, unsigned int targetPort, const uint8_t* data, size_t len) {
+  PROFILE_SCOPE(UDP_TX);
+#if CAPTURE
+  logPacket(false, data, (uint8_t)len, millis());
+#endif
   udp.beginPacket(targetIp, targetPort);
-  udp.write((const uint8_t*)message, strlen(message));
+  udp.write(data, len);
   udp.endPacket();
 }
 
-// Convenience: send to the default OTHER_IP/OTHER_PORT from config.h
-inline void sendMessage(const char* message) {
-  sendMessageTo(OTHER_IP, OTHER_PORT, message);
+// The other board. With discovery there is none until discovery.h picks
+// one, and nothing goes to the peer until then; without, it is OTHER_IP.
+#if USE_DISCOVERY && !USE_RELAY
+static IPAddress peerAddress;
+static bool peerKnown = false;
+#else
+static IPAddress peerAddress = OTHER_IP;
+static bool peerKnown = true;
+#endif
+static unsigned int peerAddressPort = OTHER_PORT;
+
+inline void setPeerAddress(const IPAddress& ip, unsigned int port) {
+  peerAddress = ip;
+  peerAddressPort = port;
+  peerKnown = true;
+}
+
+inline void clearPeerAddress() {
+  peerKnown = false;
+}
+
+// Where the peer's traffic goes: the other board, or the relay that
+// forwards to it.
+inline const IPAddress& peerIp() {
+  return USE_RELAY ? RELAY_IP : peerAddress;
+}
+
+inline unsigned int peerPort() {
+  return USE_RELAY ? RELAY_PORT : peerAddressPort;
+}
+
+// Set while a game resumed at boot (snapshot.h) waits for the other board
+// to hear that this one restarted: until then its receive window would
+// take our new sequence numbers for old ones. Reliable messages wait in
+// the link, unsent and without using up retries; the rest is dropped.
+static bool peerHeld = false;
+
+// Whether traffic for the peer may go out: there is one, and it is not held.
+inline bool peerReachable() {
+  return peerKnown && !peerHeld;
+}
+
+// Whether a datagram of this type is taken from its sender: discovery,
+// relay and profiler messages from anyone, the rest only from the peer.
+inline bool acceptFrom(uint8_t type, const IPAddress& ip, unsigned int port) {
+  if (type == MSG_BEACON || type == MSG_HELLO || type == MSG_STATS) return true;
+  return peerKnown && ip == peerIp() && port == peerPort();
 }
 
-// Receive a single UDP packet as a String (empty if none)
-inline String receiveMessage() {
-  int packetSize = udp.parsePacket();
-  if (packetSize) {
-    char incoming[256];
-    int len = udp.read(incoming, sizeof(incoming) - 1);
-    if (len > 0) incoming[len] = 0;
-    else incoming[0] = 0;
-    return String(incoming);
+static bool udpStarted = false;
+static unsigned long udpStartedAt = 0;  // last (re)bind
+
+// The reliable link's transport. Until startUDP() has bound the socket
+// nothing goes on the air; reliable messages stay in the link and go out
+// with its first retransmission once the network is up.
+inline void sendPacketToPeer(const uint8_t* data, uint8_t len) {
+  if (!udpStarted || !peerReachable()) return;
+  sendPacketTo(peerIp(), peerPort(), data, len);
+}
+
+// Initialize UDP on the given local port. Called again after a WiFi
+// reconnect it only rebinds the socket: the reliable link keeps whatever
+// is in flight and retransmits it once the peer hears us again.
+inline void startUDP(unsigned int localPort = LOCAL_PORT) {
+  if (udpStarted) udp.stop();
+  udp.begin(localPort);
+  udpStarted = true;
+  udpStartedAt = millis();
+}
+
+// Send a message to a specific target, in binary or legacy text per
+// WIRE_BINARY. Fire-and-forget: no retransmission.
+inline void sendMessageTo(const IPAddress& targetIp, unsigned int targetPort, const Message& message) {
+  uint8_t buf[WIRE_MAX_LEN];
+  Message m = message;
+  m.seq = txSeq++;
+#if WIRE_BINARY
+  uint8_t len = encodeMessage(m, buf);
+#else
+  int len = formatTextMessage(m, (char*)buf, sizeof(buf));
+#endif
+  sendPacketTo(targetIp, targetPort, buf, len);
+}
+
+// Send to the peer, directly or through the relay (peerIp()).
+// READY/SHOT/RESULT are retransmitted until acknowledged; text mode has no
+// sequence numbers and stays fire-and-forget. Reliable messages sent before
+// the network and the peer are there wait in the link (sendPacketToPeer).
+// The rest take their seq from txSeq, outside the link's numbering, and
+// are dropped until then.
+inline void sendMessage(const Message& message) {
+  if (localPeer) {
+    localPeer(message);
+    return;
+  }
+#if WIRE_BINARY
+  if (isReliableType(message.type)) {
+    if (!rlSend(peerLink, message, millis())) LOG(LINK_FULL, message.type);
+  }
+  else if (udpStarted && peerReachable()) sendMessageTo(peerIp(), peerPort(), message);
+#else
+  if (peerKnown) sendMessageTo(peerIp(), peerPort(), message);
+#endif
+}
+
+// Drive retransmissions; call once per loop.
+inline void pollNetwork() {
+  if (!peerReachable()) return;
+  rlPoll(peerLink, millis());
+}
+
+// Read and decode a single UDP packet. Returns false if none is pending.
+// out.type is MSG_NONE when the packet was undecodable, came from a board
+// other than the peer, or was an ACK, duplicate or early packet consumed by
+// the reliability layer. An early packet is returned here, ahead of the
+// socket, once the one it waited for has been.
+inline bool receiveMessage(Message& out) {
+  if (rlNextHeld(peerLink, out)) return true;
+  int len;
+  {
+    // Just the SPI round-trips to the WiFi module; ACKs are sent below
+    PROFILE_SCOPE(UDP_RX);
+    if (!udp.parsePacket()) return false;
+    len = udp.read(rxBuffer, sizeof(rxBuffer));
+  }
+#if CAPTURE
+  if (len > 0) logPacket(true, rxBuffer, (uint8_t)len, millis());
+#endif
+  if (!decodeMessage(rxBuffer, len, out)) {
+    out.type = MSG_NONE;
+  } else if (!acceptFrom(out.type, udp.remoteIP(), udp.remotePort())) {
+    IPAddress from = udp.remoteIP();
+    LOG(RX_STRANGER, out.type, from[0], from[1], from[2], from[3]);
+    out.type = MSG_NONE;
+  } else if (!rlReceive(peerLink, out, millis())) {
+    out.type = MSG_NONE;
   }
-  return String("");
+  return true;
 }
 
 #endif
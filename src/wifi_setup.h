@@ -1,33 +1,208 @@
 #ifndef WIFI_SETUP_H
 #define WIFI_SETUP_H
 
+#include <EEPROM.h>
 #include <WiFiNINA.h>
+#include <stddef.h>
+#include "eeprom_layout.h"
+#include "log.h"
 
-// Connect to WiFi and wait up to timeoutMs for connection.
-// Returns true if connected, false on timeout.
-inline bool connectWiFi(const char* ssid, const char* password, unsigned long timeoutMs = 15000) {
-  Serial.print("Connecting to WiFi: ");
+// Non-blocking association: wifiStart() kicks off the connection and
+// wifiPoll() advances it from a scheduler task, so the game runs meanwhile.
+//
+// Most of a cold start is the DHCP exchange after the scan. The lease that
+// worked last is kept in EEPROM (NetCache) and the next attempt asks for
+// that address statically; if it gets no link within WIFI_FAST_TIMEOUT_MS
+// the lease is forgotten and every attempt from then on, this session and
+// after a reset, uses DHCP until one succeeds and is cached again.
+// WiFiNINA's begin() takes no channel or BSSID, so the scan itself cannot
+// be skipped.
+//
+// Once up, wifiPoll() supervises the link: when the NINA reports it gone
+// it reconnects the same way, then retries with a backoff of
+// WIFI_RETRY_MIN_MS doubling to WIFI_RETRY_MAX_MS, and returns true again
+// when the link is back so the caller rebinds its socket.
+enum WifiState { WIFI_IDLE, WIFI_CONNECTING, WIFI_CONNECTED, WIFI_RETRY_WAIT, WIFI_FAILED };
+
+static const unsigned long WIFI_FAST_TIMEOUT_MS = 6000;
+static const unsigned long WIFI_RETRY_MIN_MS = 1000;
+static const unsigned long WIFI_RETRY_MAX_MS = 32000;
+static const uint8_t NET_CACHE_MAGIC = 0xB5;  // change with NetCache's layout
+
+// The last lease, as stored in EEPROM. No padding, so it compares bytewise.
+struct NetCache {
+  uint32_t ip, gateway, subnet;  // IPAddress raw values
+  uint16_t ssidHash;             // reused only on the network it came from
+  uint8_t magic;
+  uint8_t check;
+};
+static_assert(sizeof(NetCache) <= EEPROM_NET_CACHE_SIZE, "NetCache outgrew its EEPROM range");
+
+// Link metrics; each is also logged when it changes.
+struct WifiStats {
+  unsigned long readyMs;        // boot to first link, 0 until then
+  unsigned long lastOutageMs;   // link lost to link back
+  unsigned long worstOutageMs;
+  uint16_t reconnects;
+  uint16_t fastHits, fastMisses;  // attempts with the cached lease
+};
+
+static WifiState wifiState = WIFI_IDLE;
+static WifiStats wifiStats;
+static NetCache netCache;
+static bool netCacheValid = false;
+static const char* wifiSsid = nullptr;
+static const char* wifiPassword = nullptr;
+static unsigned long wifiStartTime = 0;  // of the attempt, or of the wait
+static unsigned long wifiTimeoutMs = 0;
+static unsigned long wifiRetryMs = WIFI_RETRY_MIN_MS;
+static unsigned long wifiUpAt = 0;
+static unsigned long wifiLostAt = 0;
+static bool wifiFastPath = false;  // this attempt uses the cached lease
+static bool wifiStaticIp = false;  // the NINA has been given one
+
+inline bool wifiConnected() { return wifiState == WIFI_CONNECTED; }
+
+inline uint16_t netCacheSsidHash(const char* ssid) {
+  uint16_t h = 0;
+  while (*ssid) h = h * 31 + (uint8_t)*ssid++;
+  return h;
+}
+
+inline uint8_t netCacheCheck(const NetCache& c) {
+  const uint8_t* p = (const uint8_t*)&c;
+  uint8_t sum = 0x5A;
+  for (uint8_t i = 0; i < sizeof(NetCache) - 1; i++) sum = (uint8_t)((sum << 1 | sum >> 7) + p[i]);
+  return sum;
+}
+
+inline void netCacheLoad(const char* ssid) {
+  EEPROM.get(EEPROM_NET_CACHE_ADDR, netCache);
+  netCacheValid = netCache.magic == NET_CACHE_MAGIC && netCache.check == netCacheCheck(netCache) &&
+                  netCache.ssidHash == netCacheSsidHash(ssid) && netCache.ip != 0;
+}
+
+// Remember the lease in use. EEPROM.put only writes bytes that differ, and
+// an unchanged lease is not written at all.
+inline void netCacheSave() {
+  NetCache c;
+  c.ip = WiFi.localIP();
+  c.gateway = WiFi.gatewayIP();
+  c.subnet = WiFi.subnetMask();
+  c.ssidHash = netCacheSsidHash(wifiSsid);
+  c.magic = NET_CACHE_MAGIC;
+  c.check = netCacheCheck(c);
+  if (netCacheValid && memcmp(&c, &netCache, sizeof(c)) == 0) return;
+  netCache = c;
+  netCacheValid = c.ip != 0;
+  EEPROM.put(EEPROM_NET_CACHE_ADDR, c);
+}
+
+// The cached lease got no link: stop using it, now and at the next boot.
+inline void netCacheForget() {
+  netCacheValid = false;
+  EEPROM.update(EEPROM_NET_CACHE_ADDR + offsetof(NetCache, magic), 0);
+}
+
+// One association attempt, with the cached lease if there is one and
+// fast, else with DHCP.
+inline void wifiBegin(bool fast) {
+  wifiFastPath = fast && netCacheValid;
+  if (wifiFastPath) {
+    IPAddress gateway(netCache.gateway);
+    WiFi.config(IPAddress(netCache.ip), gateway, gateway, IPAddress(netCache.subnet));
+    wifiStaticIp = true;
+  } else if (wifiStaticIp) {
+    // WiFiNINA has no documented way back to DHCP once config() was
+    // called. end() holds the NINA in reset and the next call into the
+    // library starts it again as at power-up, without the address. Ask
+    // status() first, as the library's examples do at boot, and leave a
+    // module that did not come back to the retry rather than begin()
+    WiFi.end();
+    wifiStaticIp = false;
+    if (WiFi.status() == WL_NO_MODULE) {
+      LOG(WIFI_NO_MODULE, wifiRetryMs / 1000);
+      wifiState = WIFI_RETRY_WAIT;
+      wifiStartTime = millis();
+      return;
+    }
+  }
+  WiFi.begin(wifiSsid, wifiPassword);
+  wifiStartTime = millis();
+  wifiState = WIFI_CONNECTING;
+}
+
+inline void wifiStart(const char* ssid, const char* password, unsigned long timeoutMs = 15000) {
   if(ssid == nullptr || strlen(ssid) == 0) {
-    Serial.println("SSID is null or empty!");
-    return false;
+    LOG(WIFI_NO_SSID);
+    wifiState = WIFI_FAILED;
+    return;
   }
-  Serial.println(ssid);
-
-  unsigned long start = millis();
-  WiFi.begin(ssid, password);
-  while (WiFi.status() != WL_CONNECTED) {
-    if (millis() - start > timeoutMs) {
-      Serial.println("\nWiFi connect timeout");
-      return false;
-    }
-    Serial.print('.');
-    delay(500);
+  LOG(WIFI_CONNECTING, ssid);
+  wifiSsid = ssid;
+  wifiPassword = password;
+  wifiTimeoutMs = timeoutMs;
+  netCacheLoad(ssid);
+  // With a zero timeout WiFiNINA's begin() only issues the request
+  WiFi.setTimeout(0);
+  wifiBegin(true);
+}
+
+inline void wifiOnUp(unsigned long now) {
+  wifiState = WIFI_CONNECTED;
+  wifiUpAt = now;
+  wifiRetryMs = WIFI_RETRY_MIN_MS;
+  if (wifiFastPath) wifiStats.fastHits++;
+  const char* path = wifiFastPath ? "cached lease" : "DHCP";
+  IPAddress ip = WiFi.localIP();
+  LOG(WIFI_CONNECTED, ip[0], ip[1], ip[2], ip[3]);
+  if (!wifiStats.readyMs) {
+    wifiStats.readyMs = now;
+    LOG(WIFI_READY, now, path);
+  } else {
+    unsigned long outage = now - wifiLostAt;
+    wifiStats.lastOutageMs = outage;
+    if (outage > wifiStats.worstOutageMs) wifiStats.worstOutageMs = outage;
+    wifiStats.reconnects++;
+    LOG(WIFI_RECONNECTED, outage, path, wifiStats.reconnects, wifiStats.worstOutageMs);
   }
+  netCacheSave();
+}
 
-  Serial.println("\nConnected!");
-  Serial.print("IP address: ");
-  Serial.println(WiFi.localIP());
-  return true;
+// Returns true on the poll where the link comes up: the first time and
+// after every drop.
+inline bool wifiPoll() {
+  unsigned long now = millis();
+  if (wifiState == WIFI_CONNECTED) {
+    if (WiFi.status() == WL_CONNECTED) return false;
+    LOG(WIFI_LOST, (now - wifiUpAt) / 1000);
+    wifiLostAt = now;
+    // The lease was good a moment ago
+    wifiBegin(true);
+    return false;
+  }
+  if (wifiState == WIFI_RETRY_WAIT) {
+    if (now - wifiStartTime < wifiRetryMs) return false;
+    wifiRetryMs = wifiRetryMs * 2 > WIFI_RETRY_MAX_MS ? WIFI_RETRY_MAX_MS : wifiRetryMs * 2;
+    wifiBegin(true);
+    return false;
+  }
+  if (wifiState != WIFI_CONNECTING) return false;
+  if (WiFi.status() == WL_CONNECTED) {
+    wifiOnUp(now);
+    return true;
+  }
+  if (wifiFastPath && now - wifiStartTime > WIFI_FAST_TIMEOUT_MS) {
+    wifiStats.fastMisses++;
+    LOG(WIFI_FAST_MISS, now - wifiStartTime);
+    netCacheForget();
+    wifiBegin(false);
+  } else if (now - wifiStartTime > wifiTimeoutMs) {
+    LOG(WIFI_TIMEOUT, wifiRetryMs / 1000);
+    wifiState = WIFI_RETRY_WAIT;
+    wifiStartTime = now;
+  }
+  return false;
 }
 
 #endif
@@ -0,0 +1,175 @@
+// The relay's session table: insert, find and erase, backward-shift
+// deletion across colliding keys and the end of the array, and growth.
+
+#include <unity.h>
+#include <map>
+#include <vector>
+#include "../../src/host/relay/flat_table.h"
+
+typedef FlatTable<int> Table;
+
+void setUp() {}
+void tearDown() {}
+
+// The first n nonzero keys whose home slot in a table of cap slots is home
+static std::vector<uint64_t> keysAt(size_t cap, size_t home, size_t n) {
+  std::vector<uint64_t> keys;
+  for (uint64_t k = 1; keys.size() < n; k++)
+    if ((Table::hash(k) & (cap - 1)) == home) keys.push_back(k);
+  return keys;
+}
+
+// Keys in slot order
+static std::vector<uint64_t> layout(Table &t) {
+  std::vector<uint64_t> keys;
+  t.forEach([&](uint64_t k, int) { keys.push_back(k); });
+  return keys;
+}
+
+static void test_insert_find_erase() {
+  Table t;
+  TEST_ASSERT_EQUAL(0, t.size());
+  TEST_ASSERT_NULL(t.find(42));
+  t.insert(42) = 7;
+  t.insert(43) = 8;
+  TEST_ASSERT_EQUAL(2, t.size());
+  TEST_ASSERT_EQUAL(7, *t.find(42));
+  TEST_ASSERT_EQUAL(8, *t.find(43));
+  // Inserting an existing key returns its value untouched
+  TEST_ASSERT_EQUAL(7, t.insert(42));
+  TEST_ASSERT_EQUAL(2, t.size());
+  TEST_ASSERT_TRUE(t.erase(42));
+  TEST_ASSERT_FALSE(t.erase(42));
+  TEST_ASSERT_NULL(t.find(42));
+  TEST_ASSERT_EQUAL(8, *t.find(43));
+  TEST_ASSERT_EQUAL(1, t.size());
+  // A reinserted key starts from a default value
+  TEST_ASSERT_EQUAL(0, t.insert(42));
+}
+
+static void test_capacity_rounding() {
+  TEST_ASSERT_EQUAL(16, Table(1).capacity());
+  TEST_ASSERT_EQUAL(16, Table(11).capacity());
+  TEST_ASSERT_EQUAL(32, Table(12).capacity());
+  TEST_ASSERT_EQUAL(128, Table(64).capacity());
+}
+
+static void test_backward_shift_in_run() {
+  Table t(8);
+  TEST_ASSERT_EQUAL(16, t.capacity());
+  std::vector<uint64_t> same = keysAt(16, 4, 3);
+  uint64_t next = keysAt(16, 5, 1)[0];
+  uint64_t after = keysAt(16, 7, 1)[0];
+  // Slots 4..7: same[0] same[1] same[2] next, then after in 8
+  for (uint64_t k : same) t.insert(k) = (int)k;
+  t.insert(next) = (int)next;
+  t.insert(after) = (int)after;
+  TEST_ASSERT_TRUE(t.erase(same[0]));
+  // Everything moves back one, including after, which sat past its home
+  std::vector<uint64_t> want = {same[1], same[2], next, after};
+  std::vector<uint64_t> got = layout(t);
+  TEST_ASSERT_EQUAL(want.size(), got.size());
+  for (size_t i = 0; i < want.size(); i++) TEST_ASSERT_EQUAL_UINT64(want[i], got[i]);
+  for (uint64_t k : want) TEST_ASSERT_EQUAL((int)k, *t.find(k));
+  TEST_ASSERT_NULL(t.find(same[0]));
+}
+
+static void test_backward_shift_keeps_home() {
+  Table t(8);
+  uint64_t a = keysAt(16, 4, 1)[0];
+  uint64_t b = keysAt(16, 5, 1)[0];
+  uint64_t c = keysAt(16, 5, 2)[1];
+  t.insert(a);
+  t.insert(b);
+  t.insert(c);
+  // Slots 4, 5, 6. b and c cannot move before slot 5, so c shifts into
+  // b's place only when b goes
+  TEST_ASSERT_TRUE(t.erase(a));
+  std::vector<uint64_t> got = layout(t);
+  TEST_ASSERT_EQUAL(2, got.size());
+  TEST_ASSERT_EQUAL_UINT64(b, got[0]);
+  TEST_ASSERT_EQUAL_UINT64(c, got[1]);
+  TEST_ASSERT_NOT_NULL(t.find(b));
+  TEST_ASSERT_NOT_NULL(t.find(c));
+  TEST_ASSERT_TRUE(t.erase(b));
+  TEST_ASSERT_NOT_NULL(t.find(c));
+  TEST_ASSERT_FALSE(t.erase(b));
+}
+
+static void test_wraparound_at_last_slot() {
+  Table t(8);
+  std::vector<uint64_t> last = keysAt(16, 15, 3);
+  uint64_t first = keysAt(16, 0, 1)[0];
+  // Slots 15, 0, 1, 2
+  for (uint64_t k : last) t.insert(k) = (int)k;
+  t.insert(first) = (int)first;
+  std::vector<uint64_t> before = layout(t);
+  TEST_ASSERT_EQUAL_UINT64(last[0], before.back());
+  TEST_ASSERT_TRUE(t.erase(last[0]));
+  // last[1] wraps back into slot 15; last[2] and first follow from 0
+  std::vector<uint64_t> got = layout(t);
+  TEST_ASSERT_EQUAL(3, got.size());
+  TEST_ASSERT_EQUAL_UINT64(last[2], got[0]);
+  TEST_ASSERT_EQUAL_UINT64(first, got[1]);
+  TEST_ASSERT_EQUAL_UINT64(last[1], got[2]);
+  for (uint64_t k : {last[1], last[2], first}) TEST_ASSERT_EQUAL((int)k, *t.find(k));
+  TEST_ASSERT_NULL(t.find(last[0]));
+  // A probe for a missing key with home 15 stops at the new hole
+  TEST_ASSERT_NULL(t.find(keysAt(16, 15, 4)[3]));
+}
+
+static void test_growth() {
+  Table t(8);
+  for (uint64_t k = 1; k <= 12; k++) t.insert(k) = (int)k * 10;
+  // 12 of 16 is 3/4; the next insert doubles first
+  TEST_ASSERT_EQUAL(16, t.capacity());
+  t.insert(13) = 130;
+  TEST_ASSERT_EQUAL(32, t.capacity());
+  TEST_ASSERT_EQUAL(13, t.size());
+  for (uint64_t k = 1; k <= 13; k++) TEST_ASSERT_EQUAL((int)k * 10, *t.find(k));
+}
+
+static void test_random_against_map() {
+  Table t(8);
+  std::map<uint64_t, int> ref;
+  uint64_t state = 99;
+  auto next = [&]() { return state = state * 6364136223846793005ULL + 1442695040888963407ULL; };
+  for (int i = 0; i < 200000; i++) {
+    // A small key space so collisions, re-inserts and misses are common
+    uint64_t key = (next() >> 33) % 300 + 1;
+    switch ((next() >> 40) % 3) {
+      case 0:
+        t.insert(key) = i;
+        ref[key] = i;
+        break;
+      case 1:
+        TEST_ASSERT_EQUAL(ref.erase(key) == 1, t.erase(key));
+        break;
+      default: {
+        int *v = t.find(key);
+        auto it = ref.find(key);
+        TEST_ASSERT_EQUAL(it != ref.end(), v != nullptr);
+        if (v) TEST_ASSERT_EQUAL(it->second, *v);
+      }
+    }
+    TEST_ASSERT_EQUAL(ref.size(), t.size());
+  }
+  size_t seen = 0;
+  t.forEach([&](uint64_t k, int v) {
+    TEST_ASSERT_EQUAL(ref[k], v);
+    seen++;
+  });
+  TEST_ASSERT_EQUAL(ref.size(), seen);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_insert_find_erase);
+  RUN_TEST(test_capacity_rounding);
+  RUN_TEST(test_backward_shift_in_run);
+  RUN_TEST(test_backward_shift_keeps_home);
+  RUN_TEST(test_wraparound_at_last_slot);
+  RUN_TEST(test_growth);
+  RUN_TEST(test_random_against_map);
+  return UNITY_END();
+}
@@ -0,0 +1,107 @@
+// First-mover rule: both boards run placementOrder on the same four numbers
+// from opposite sides and must reach opposite answers, so exactly one of
+// them shoots first.
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <IPAddress.h>
+#include <WiFiNINA.h>
+#include <WiFiUdp.h>
+#include <unity.h>
+#include "../../src/game_logic.h"
+
+// Definitions the firmware headers declare extern; never used here
+CRGB leds[NUM_LEDS];
+WiFiUDP udp;
+
+void setUp() {}
+void tearDown() {}
+
+// Board A's view and board B's view of one handshake
+static void checkSymmetric(unsigned long timeA, int32_t offsetA, unsigned long timeB, int32_t offsetB) {
+  int32_t orderA = placementOrder(timeA, offsetA, timeB, offsetB);
+  int32_t orderB = placementOrder(timeB, offsetB, timeA, offsetA);
+  TEST_ASSERT_EQUAL_INT32(orderA, -orderB);
+  // The tie flag differs between the boards, as clockWinsTie guarantees
+  for (int tieA = 0; tieA < 2; tieA++) {
+    bool aFirst = shootsFirst(timeA, offsetA, timeB, offsetB, tieA);
+    bool bFirst = shootsFirst(timeB, offsetB, timeA, offsetA, !tieA);
+    TEST_ASSERT_TRUE(aFirst != bFirst);
+  }
+}
+
+static void test_earlier_shoots_first() {
+  // Same clock: A finished 500 ms before B
+  TEST_ASSERT_EQUAL_INT32(-1000, placementOrder(1000, 0, 1500, 0));
+  TEST_ASSERT_TRUE(shootsFirst(1000, 0, 1500, 0, false));
+  TEST_ASSERT_FALSE(shootsFirst(1500, 0, 1000, 0, true));
+  checkSymmetric(1000, 0, 1500, 0);
+}
+
+static void test_offsets_translate_clocks() {
+  // B's clock runs 10000 ms ahead of A's; B finished 200 ms after A in
+  // real time, so B's own stamp is 10200 ms past A's
+  TEST_ASSERT_TRUE(placementOrder(5000, 10000, 15200, -10000) < 0);
+  checkSymmetric(5000, 10000, 15200, -10000);
+  // Estimates that disagree by a few ms are averaged, not trusted one-sided
+  checkSymmetric(5000, 10003, 15200, -9996);
+}
+
+static void test_tie_goes_to_flag() {
+  TEST_ASSERT_EQUAL_INT32(0, placementOrder(7000, 0, 7000, 0));
+  TEST_ASSERT_TRUE(shootsFirst(7000, 0, 7000, 0, true));
+  TEST_ASSERT_FALSE(shootsFirst(7000, 0, 7000, 0, false));
+  checkSymmetric(7000, 0, 7000, 0);
+  checkSymmetric(7000, 250, 7500, -250);
+}
+
+static void test_missing_offsets() {
+  checkSymmetric(1000, OFFSET_UNKNOWN, 1500, OFFSET_UNKNOWN);
+  checkSymmetric(1000, OFFSET_UNKNOWN, 1500, 300);
+  checkSymmetric(1000, -300, 1500, OFFSET_UNKNOWN);
+  // One side's offset stands in for both
+  TEST_ASSERT_EQUAL_INT32(placementOrder(1000, -300, 1500, 300), placementOrder(1000, OFFSET_UNKNOWN, 1500, 300));
+  TEST_ASSERT_EQUAL_INT32(placementOrder(1000, 0, 1500, 0), placementOrder(1000, OFFSET_UNKNOWN, 1500, OFFSET_UNKNOWN));
+}
+
+static void test_missing_timestamp_finishes_last() {
+  TEST_ASSERT_TRUE(placementOrder(0, 0, 1500, 0) > 0);
+  TEST_ASSERT_TRUE(placementOrder(1500, 0, 0, 0) < 0);
+  TEST_ASSERT_EQUAL_INT32(0, placementOrder(0, 0, 0, 0));
+  checkSymmetric(0, 0, 1500, 0);
+  checkSymmetric(0, OFFSET_UNKNOWN, 1500, 40);
+  checkSymmetric(0, 0, 0, 0);
+}
+
+static void test_clock_wraparound() {
+  // A's millis() wrapped just after placement ended; B's did not
+  TEST_ASSERT_TRUE(placementOrder(0xFFFFFF00UL, 0, 0x00000100UL, 0) < 0);
+  checkSymmetric(0xFFFFFF00UL, 0, 0x00000100UL, 0);
+  checkSymmetric(0xFFFFFFFFUL, 2000, 1UL, -2000);
+  checkSymmetric(0x7FFFFFFFUL, 0, 0x80000000UL, 0);
+}
+
+static void test_random_handshakes() {
+  uint32_t state = 12345;
+  auto next = [&]() { return state = state * 1664525u + 1013904223u; };
+  for (int i = 0; i < 10000; i++) {
+    unsigned long timeA = next(), timeB = timeA + (int32_t)next() % 100000;
+    int32_t skew = (int32_t)(next() % 2000000) - 1000000;
+    int32_t error = (int32_t)(next() % 41) - 20;
+    int32_t offsetA = next() % 8 ? skew : OFFSET_UNKNOWN;
+    int32_t offsetB = next() % 8 ? -skew + error : OFFSET_UNKNOWN;
+    checkSymmetric(timeA, offsetA, timeB, offsetB);
+  }
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_earlier_shoots_first);
+  RUN_TEST(test_offsets_translate_clocks);
+  RUN_TEST(test_tie_goes_to_flag);
+  RUN_TEST(test_missing_offsets);
+  RUN_TEST(test_missing_timestamp_finishes_last);
+  RUN_TEST(test_clock_wraparound);
+  RUN_TEST(test_random_handshakes);
+  return UNITY_END();
+}
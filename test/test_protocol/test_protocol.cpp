@@ -0,0 +1,263 @@
+// Wire codec: every message type survives encode/decode in binary and in
+// the legacy text form, and short or malformed datagrams are refused.
+
+#include <unity.h>
+#include "../../src/protocol.h"
+
+void setUp() {}
+void tearDown() {}
+
+// buf is the caller's: a decoded AIM trail or STATE_SYNC data points into
+// it, so it must outlive the checks on got
+static void roundTrip(const Message &sent, uint8_t *buf, Message &got, uint8_t &len) {
+  len = encodeMessage(sent, buf);
+  TEST_ASSERT_TRUE(decodeMessage(buf, len, got));
+}
+
+static Message decodeText(const char *text, bool &ok) {
+  Message m;
+  ok = decodeMessage((const uint8_t *)text, (int)strlen(text), m);
+  return m;
+}
+
+static void test_binary_round_trip() {
+  uint8_t buf[WIRE_MAX_LEN], len;
+  Message m = makeMessage(MSG_READY);
+  m.seq = 7;
+  m.value = 123456789;
+  m.offset = -4321;
+  Message got;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL(WIRE_HEADER_LEN + 8, len);
+  TEST_ASSERT_EQUAL(MSG_READY, got.type);
+  TEST_ASSERT_EQUAL(7, got.seq);
+  TEST_ASSERT_TRUE(got.sequenced);
+  TEST_ASSERT_EQUAL_UINT32(123456789, got.value);
+  TEST_ASSERT_EQUAL_INT32(-4321, got.offset);
+
+  m = makeMessage(MSG_SHOT);
+  m.x = 15, m.y = 3;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL(MSG_SHOT, got.type);
+  TEST_ASSERT_EQUAL(15, got.x);
+  TEST_ASSERT_EQUAL(3, got.y);
+
+  m = makeMessage(MSG_RESULT);
+  m.result = RESULT_SINK;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL(RESULT_SINK, got.result);
+
+  m = makeMessage(MSG_ACK);
+  m.seq = 200;
+  m.ackBits = 0xA5C3;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL(200, got.seq);
+  TEST_ASSERT_EQUAL_UINT16(0xA5C3, got.ackBits);
+
+  m = makeMessage(MSG_PONG);
+  m.value = 0xFFFFFFF0u;
+  m.echo = 42;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFF0u, got.value);
+  TEST_ASSERT_EQUAL_UINT32(42, got.echo);
+
+  m = makeMessage(MSG_HELLO);
+  m.table = 0xBEEF;
+  m.relayState = RELAY_PAIRED;
+  m.role = 1;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL_UINT16(0xBEEF, got.table);
+  TEST_ASSERT_EQUAL(RELAY_PAIRED, got.relayState);
+  TEST_ASSERT_EQUAL(1, got.role);
+
+  m = makeMessage(MSG_BEACON);
+  m.value = 0x01020304;
+  m.echo = 0xA0B0C0D0;
+  m.configHash = 0x1234;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL_UINT32(0x01020304, got.value);
+  TEST_ASSERT_EQUAL_UINT32(0xA0B0C0D0, got.echo);
+  TEST_ASSERT_EQUAL_UINT16(0x1234, got.configHash);
+}
+
+static void test_binary_variable_length() {
+  uint8_t buf[WIRE_MAX_LEN], len;
+  const uint8_t trail[3] = {0x12, 0x34, 0x56};
+  Message m = makeMessage(MSG_AIM);
+  m.x = 4, m.y = 9;
+  m.aimAge = 2;
+  m.aimCount = 3;
+  m.aimTrail = trail;
+  Message got;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL(WIRE_HEADER_LEN + 3 + 3, len);
+  TEST_ASSERT_EQUAL(4, got.x);
+  TEST_ASSERT_EQUAL(9, got.y);
+  TEST_ASSERT_EQUAL(2, got.aimAge);
+  TEST_ASSERT_EQUAL(3, got.aimCount);
+  TEST_ASSERT_TRUE(got.aimTrail == buf + WIRE_HEADER_LEN + 3);
+  TEST_ASSERT_EQUAL_MEMORY(trail, got.aimTrail, 3);
+
+  // A lone sample is the plain two-byte AIM
+  m.aimAge = 0;
+  m.aimCount = 0;
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL(WIRE_HEADER_LEN + 2, len);
+  TEST_ASSERT_EQUAL(0, got.aimCount);
+
+  uint8_t data[STATE_SYNC_MAX_DATA];
+  for (uint8_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 7);
+  m = makeMessage(MSG_STATE_SYNC);
+  m.syncFlags = SYNC_ROWS;
+  m.gameTag = 0x4242;
+  m.syncData = data;
+  m.syncLen = sizeof(data);
+  roundTrip(m, buf, got, len);
+  TEST_ASSERT_EQUAL(WIRE_MAX_LEN, len);
+  TEST_ASSERT_EQUAL(SYNC_ROWS, got.syncFlags);
+  TEST_ASSERT_EQUAL_UINT16(0x4242, got.gameTag);
+  TEST_ASSERT_EQUAL(sizeof(data), got.syncLen);
+  TEST_ASSERT_TRUE(got.syncData == buf + WIRE_HEADER_LEN + 3);
+  TEST_ASSERT_EQUAL_MEMORY(data, got.syncData, sizeof(data));
+}
+
+static void test_text_round_trip() {
+  const uint8_t types[] = {MSG_READY, MSG_AIM, MSG_SHOT, MSG_RESULT, MSG_STATS, MSG_PING, MSG_PONG, MSG_HELLO, MSG_BEACON};
+  for (uint8_t type : types) {
+    Message m = makeMessage(type);
+    // Payload fields share storage: set only the ones this type uses
+    if (type == MSG_AIM || type == MSG_SHOT) m.x = 12, m.y = 0;
+    if (type == MSG_RESULT) m.result = RESULT_HIT;
+    if (type == MSG_READY) m.value = 4000000000u, m.offset = -17;
+    if (type == MSG_PING || type == MSG_PONG) m.value = 99, m.echo = 4294967295u;
+    if (type == MSG_HELLO) m.table = 65535, m.relayState = RELAY_WAITING, m.role = 1;
+    if (type == MSG_BEACON) m.value = 0xDEADBEEF, m.echo = 0x89ABCDEF, m.configHash = 0xFFFF;
+    char text[WIRE_MAX_LEN + 1];
+    int n = formatTextMessage(m, text, sizeof(text));
+    TEST_ASSERT_TRUE(n > 0 && n <= WIRE_MAX_LEN);
+    Message got;
+    TEST_ASSERT_TRUE(decodeMessage((const uint8_t *)text, n, got));
+    TEST_ASSERT_EQUAL(type, got.type);
+    TEST_ASSERT_FALSE(got.sequenced);
+    if (type == MSG_AIM || type == MSG_SHOT) {
+      TEST_ASSERT_EQUAL(12, got.x);
+      TEST_ASSERT_EQUAL(0, got.y);
+    }
+    if (type == MSG_RESULT) TEST_ASSERT_EQUAL(RESULT_HIT, got.result);
+    if (type == MSG_READY) TEST_ASSERT_EQUAL_INT32(-17, got.offset);
+    if (type == MSG_HELLO) TEST_ASSERT_EQUAL_UINT16(65535, got.table);
+    if (type == MSG_BEACON) TEST_ASSERT_EQUAL_UINT16(0xFFFF, got.configHash);
+    if (type != MSG_AIM && type != MSG_SHOT && type != MSG_RESULT && type != MSG_STATS && type != MSG_HELLO)
+      TEST_ASSERT_EQUAL_UINT32(m.value, got.value);
+    if (type == MSG_PONG || type == MSG_BEACON) TEST_ASSERT_EQUAL_UINT32(m.echo, got.echo);
+  }
+}
+
+static void test_text_legacy_forms() {
+  bool ok;
+  Message m = decodeText("READY", ok);
+  TEST_ASSERT_TRUE(ok);
+  TEST_ASSERT_EQUAL_UINT32(0, m.value);
+  TEST_ASSERT_EQUAL_INT32(OFFSET_UNKNOWN, m.offset);
+  m = decodeText("READY:1500", ok);
+  TEST_ASSERT_TRUE(ok);
+  TEST_ASSERT_EQUAL_UINT32(1500, m.value);
+  TEST_ASSERT_EQUAL_INT32(OFFSET_UNKNOWN, m.offset);
+  m = decodeText("RESULT:MISS", ok);
+  TEST_ASSERT_TRUE(ok);
+  TEST_ASSERT_EQUAL(RESULT_MISS, m.result);
+  m = decodeText("HELLO:7", ok);
+  TEST_ASSERT_TRUE(ok);
+  TEST_ASSERT_EQUAL_UINT16(7, m.table);
+}
+
+static void test_truncated_binary() {
+  const uint8_t types[] = {MSG_READY, MSG_AIM, MSG_SHOT, MSG_RESULT, MSG_ACK, MSG_PING, MSG_PONG, MSG_HELLO, MSG_BEACON, MSG_STATE_SYNC};
+  for (uint8_t type : types) {
+    uint8_t buf[WIRE_MAX_LEN];
+    uint8_t len = encodeMessage(makeMessage(type), buf);
+    Message got;
+    TEST_ASSERT_TRUE(decodeMessage(buf, len, got));
+    // One byte short; a READY cut to its old 4-byte form still decodes
+    bool shortReadyOk = type == MSG_READY && len - 1 - WIRE_HEADER_LEN >= 4;
+    TEST_ASSERT_EQUAL(shortReadyOk, decodeMessage(buf, len - 1, got));
+    TEST_ASSERT_FALSE(decodeMessage(buf, WIRE_HEADER_LEN - 1, got));
+  }
+  uint8_t ready[WIRE_MAX_LEN];
+  Message m = makeMessage(MSG_READY);
+  m.value = 77;
+  encodeMessage(m, ready);
+  Message got;
+  TEST_ASSERT_TRUE(decodeMessage(ready, WIRE_HEADER_LEN + 4, got));
+  TEST_ASSERT_EQUAL_UINT32(77, got.value);
+  TEST_ASSERT_EQUAL_INT32(OFFSET_UNKNOWN, got.offset);
+  TEST_ASSERT_FALSE(decodeMessage(ready, WIRE_HEADER_LEN + 3, got));
+
+  // An AIM trail cut short
+  const uint8_t trail[4] = {1, 2, 3, 4};
+  m = makeMessage(MSG_AIM);
+  m.aimCount = 4;
+  m.aimTrail = trail;
+  uint8_t aim[WIRE_MAX_LEN];
+  uint8_t len = encodeMessage(m, aim);
+  TEST_ASSERT_FALSE(decodeMessage(aim, len - 1, got));
+  TEST_ASSERT_FALSE(decodeMessage(aim, 0, got));
+}
+
+static void test_oversize_and_malformed_binary() {
+  Message got;
+  // Trailing bytes after a fixed-size payload are ignored
+  uint8_t shot[WIRE_MAX_LEN] = {WIRE_MAGIC, MSG_SHOT, 1, 5, 6, 0xEE, 0xEE};
+  TEST_ASSERT_TRUE(decodeMessage(shot, 7, got));
+  TEST_ASSERT_EQUAL(5, got.x);
+  TEST_ASSERT_EQUAL(6, got.y);
+
+  // More STATE_SYNC data than one message may carry
+  uint8_t sync[WIRE_HEADER_LEN + 3 + STATE_SYNC_MAX_DATA + 1] = {WIRE_MAGIC, MSG_STATE_SYNC, 0};
+  TEST_ASSERT_TRUE(decodeMessage(sync, sizeof(sync) - 1, got));
+  TEST_ASSERT_FALSE(decodeMessage(sync, sizeof(sync), got));
+
+  // An AIM claiming more trail than AIM_TRAIL_MAX
+  uint8_t aim[WIRE_MAX_LEN] = {WIRE_MAGIC, MSG_AIM, 0, 1, 1, (uint8_t)(AIM_TRAIL_MAX + 1)};
+  TEST_ASSERT_FALSE(decodeMessage(aim, WIRE_MAX_LEN, got));
+
+  uint8_t none[] = {WIRE_MAGIC, MSG_NONE, 0};
+  TEST_ASSERT_FALSE(decodeMessage(none, sizeof(none), got));
+  uint8_t unknown[] = {WIRE_MAGIC, MSG_TYPE_COUNT, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  TEST_ASSERT_FALSE(decodeMessage(unknown, sizeof(unknown), got));
+}
+
+static void test_malformed_text() {
+  bool ok;
+  decodeText("SHOT:300,1", ok);
+  TEST_ASSERT_FALSE(ok);
+  decodeText("SHOT:3", ok);
+  TEST_ASSERT_FALSE(ok);
+  decodeText("SHOT:,4", ok);
+  TEST_ASSERT_FALSE(ok);
+  decodeText("RESULT:WAT", ok);
+  TEST_ASSERT_FALSE(ok);
+  decodeText("PONG:5", ok);
+  TEST_ASSERT_FALSE(ok);
+  decodeText("HELLO:70000", ok);
+  TEST_ASSERT_FALSE(ok);
+  decodeText("BEACON:1,2,10000", ok);
+  TEST_ASSERT_FALSE(ok);
+  decodeText("FIRE:1,2", ok);
+  TEST_ASSERT_FALSE(ok);
+  // Only the given length is read, not up to a terminator
+  Message m;
+  TEST_ASSERT_FALSE(decodeMessage((const uint8_t *)"SHOT:1,2", 6, m));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_binary_round_trip);
+  RUN_TEST(test_binary_variable_length);
+  RUN_TEST(test_text_round_trip);
+  RUN_TEST(test_text_legacy_forms);
+  RUN_TEST(test_truncated_binary);
+  RUN_TEST(test_oversize_and_malformed_binary);
+  RUN_TEST(test_malformed_text);
+  return UNITY_END();
+}
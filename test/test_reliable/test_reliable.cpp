@@ -0,0 +1,200 @@
+// Reliable link receive side: duplicates are dropped, a packet ahead of a
+// missing one is acknowledged and held until the gap is filled, and
+// sequence numbers wrap.
+
+#include <unity.h>
+#include <vector>
+#include "../../src/reliable.h"
+
+static std::vector<Message> acks;
+
+static void captureAck(const uint8_t *data, uint8_t len) {
+  Message m;
+  if (decodeMessage(data, len, m) && m.type == MSG_ACK) acks.push_back(m);
+}
+
+static ReliableLink link;
+
+void setUp() {
+  acks.clear();
+  rlInit(link, captureAck);
+}
+
+void tearDown() {}
+
+static bool receive(uint8_t seq, uint8_t type = MSG_SHOT) {
+  Message m = makeMessage(type);
+  m.seq = seq;
+  m.sequenced = true;
+  return rlReceive(link, m, 0);
+}
+
+static void test_in_order_delivery_and_acks() {
+  TEST_ASSERT_TRUE(receive(0, MSG_READY));
+  TEST_ASSERT_TRUE(receive(1));
+  TEST_ASSERT_TRUE(receive(2, MSG_RESULT));
+  TEST_ASSERT_EQUAL(3, acks.size());
+  TEST_ASSERT_EQUAL(2, acks.back().seq);
+  // Bit i is seq - 1 - i: 1 and 0 were received
+  TEST_ASSERT_EQUAL_UINT16(0x0003, acks.back().ackBits & 0x0003);
+}
+
+static void test_duplicates_dropped() {
+  TEST_ASSERT_TRUE(receive(0));
+  TEST_ASSERT_TRUE(receive(1));
+  TEST_ASSERT_FALSE(receive(1));
+  TEST_ASSERT_FALSE(receive(0));
+  TEST_ASSERT_EQUAL(2, link.stats.duplicates);
+  // Still acknowledged: the sender may have missed the first ACK
+  TEST_ASSERT_EQUAL(4, acks.size());
+  TEST_ASSERT_EQUAL(1, acks.back().seq);
+}
+
+static void test_gap_held_until_filled() {
+  Message held;
+  TEST_ASSERT_TRUE(receive(0));
+  TEST_ASSERT_FALSE(receive(2, MSG_RESULT));
+  TEST_ASSERT_FALSE(receive(3));
+  TEST_ASSERT_FALSE(rlNextHeld(link, held));
+  // 3 and 2 are acknowledged, 1 is not
+  TEST_ASSERT_EQUAL(3, acks.back().seq);
+  TEST_ASSERT_EQUAL_UINT16(0x0005, acks.back().ackBits & 0x0007);
+  TEST_ASSERT_FALSE(receive(2));
+  TEST_ASSERT_EQUAL(1, link.stats.duplicates);
+  TEST_ASSERT_TRUE(receive(1));
+  TEST_ASSERT_TRUE(rlNextHeld(link, held));
+  TEST_ASSERT_EQUAL(2, held.seq);
+  TEST_ASSERT_EQUAL(MSG_RESULT, held.type);
+  TEST_ASSERT_TRUE(rlNextHeld(link, held));
+  TEST_ASSERT_EQUAL(3, held.seq);
+  TEST_ASSERT_FALSE(rlNextHeld(link, held));
+  TEST_ASSERT_FALSE(receive(3));
+  TEST_ASSERT_TRUE(receive(4));
+}
+
+// The first packet of a session is not trusted to be seq 0
+static void test_gap_at_session_start() {
+  Message held;
+  TEST_ASSERT_FALSE(receive(1));
+  TEST_ASSERT_EQUAL(0, link.stats.duplicates);
+  TEST_ASSERT_TRUE(receive(0));
+  TEST_ASSERT_TRUE(rlNextHeld(link, held));
+  TEST_ASSERT_EQUAL(1, held.seq);
+  TEST_ASSERT_FALSE(receive(0));
+  TEST_ASSERT_FALSE(receive(1));
+}
+
+// Further ahead than the peer can have in flight: not recorded, so it is
+// neither acknowledged nor taken for a duplicate when it comes again
+static void test_too_far_ahead_dropped() {
+  Message held;
+  TEST_ASSERT_FALSE(receive(RELIABLE_SLOTS + 1));
+  TEST_ASSERT_EQUAL(255, acks.back().seq);
+  for (uint8_t seq = 0; seq < RELIABLE_SLOTS; seq++) TEST_ASSERT_TRUE(receive(seq));
+  TEST_ASSERT_FALSE(rlNextHeld(link, held));
+  TEST_ASSERT_TRUE(receive(RELIABLE_SLOTS));
+  TEST_ASSERT_TRUE(receive(RELIABLE_SLOTS + 1));
+  TEST_ASSERT_EQUAL(0, link.stats.duplicates);
+}
+
+static void test_seq_wraparound() {
+  rlExpectSeq(link, 250);
+  TEST_ASSERT_FALSE(receive(249));
+  for (int i = 0; i < 12; i++) TEST_ASSERT_TRUE(receive((uint8_t)(250 + i)));
+  TEST_ASSERT_EQUAL(5, acks.back().seq);
+  TEST_ASSERT_FALSE(receive(254));
+  TEST_ASSERT_FALSE(receive(3));
+  // A gap across the wrap is held like any other
+  Message held;
+  rlExpectSeq(link, 255);
+  TEST_ASSERT_FALSE(receive(0));
+  TEST_ASSERT_TRUE(receive(255));
+  TEST_ASSERT_TRUE(rlNextHeld(link, held));
+  TEST_ASSERT_EQUAL(0, held.seq);
+  TEST_ASSERT_FALSE(receive(0));
+  // Resynchronizing drops whatever was held
+  TEST_ASSERT_FALSE(receive(2));
+  rlExpectSeq(link, 10);
+  TEST_ASSERT_FALSE(rlNextHeld(link, held));
+}
+
+static void test_unsequenced_and_unreliable_pass_through() {
+  Message text = makeMessage(MSG_SHOT);
+  text.seq = 9;
+  TEST_ASSERT_TRUE(rlReceive(link, text, 0));
+  TEST_ASSERT_TRUE(receive(40, MSG_AIM));
+  TEST_ASSERT_TRUE(receive(40, MSG_PING));
+  TEST_ASSERT_EQUAL(0, acks.size());
+  TEST_ASSERT_TRUE(receive(0));
+}
+
+static void test_ack_clears_pending() {
+  Message shot = makeMessage(MSG_SHOT);
+  TEST_ASSERT_TRUE(rlSend(link, shot, 0));
+  TEST_ASSERT_TRUE(rlSend(link, shot, 0));
+  TEST_ASSERT_FALSE(rlIdle(link));
+  TEST_ASSERT_EQUAL(0, rlFirstUnacked(link));
+  Message ack = makeMessage(MSG_ACK);
+  ack.seq = 1;
+  ack.ackBits = 0x0001;  // and seq 0
+  TEST_ASSERT_FALSE(rlReceive(link, ack, 30));
+  TEST_ASSERT_TRUE(rlIdle(link));
+  TEST_ASSERT_EQUAL(2, rlFirstUnacked(link));
+  TEST_ASSERT_EQUAL(30, rlSmoothedRtt(link));
+}
+
+// Two links end to end: when the first of a full window is lost, the
+// ACKs for the rest keep them from being sent again
+static std::vector<std::vector<uint8_t>> wire;
+
+static void captureAll(const uint8_t *data, uint8_t len) {
+  wire.push_back(std::vector<uint8_t>(data, data + len));
+}
+
+static void test_selective_ack_resends_only_the_loss() {
+  ReliableLink sender, receiver;
+  rlInit(sender, captureAll);
+  rlInit(receiver, captureAll);
+  wire.clear();
+  Message shot = makeMessage(MSG_SHOT);
+  for (uint8_t i = 0; i < RELIABLE_SLOTS; i++) TEST_ASSERT_TRUE(rlSend(sender, shot, 0));
+  std::vector<std::vector<uint8_t>> sent;
+  sent.swap(wire);
+  Message m;
+  for (size_t i = 1; i < sent.size(); i++) {
+    TEST_ASSERT_TRUE(decodeMessage(sent[i].data(), (int)sent[i].size(), m));
+    TEST_ASSERT_FALSE(rlReceive(receiver, m, 0));
+  }
+  std::vector<std::vector<uint8_t>> acksBack;
+  acksBack.swap(wire);
+  for (auto &a : acksBack) {
+    TEST_ASSERT_TRUE(decodeMessage(a.data(), (int)a.size(), m));
+    rlReceive(sender, m, 10);
+  }
+  rlPoll(sender, 10 + RTO_MAX_MS);
+  TEST_ASSERT_EQUAL(1, wire.size());
+  TEST_ASSERT_EQUAL(1, sender.stats.retransmits);
+  TEST_ASSERT_TRUE(decodeMessage(wire[0].data(), (int)wire[0].size(), m));
+  TEST_ASSERT_EQUAL(0, m.seq);
+  wire.clear();
+  TEST_ASSERT_TRUE(rlReceive(receiver, m, 20));
+  for (uint8_t seq = 1; seq < RELIABLE_SLOTS; seq++) {
+    TEST_ASSERT_TRUE(rlNextHeld(receiver, m));
+    TEST_ASSERT_EQUAL(seq, m.seq);
+  }
+  TEST_ASSERT_FALSE(rlNextHeld(receiver, m));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_in_order_delivery_and_acks);
+  RUN_TEST(test_duplicates_dropped);
+  RUN_TEST(test_gap_held_until_filled);
+  RUN_TEST(test_gap_at_session_start);
+  RUN_TEST(test_too_far_ahead_dropped);
+  RUN_TEST(test_seq_wraparound);
+  RUN_TEST(test_unsequenced_and_unreliable_pass_through);
+  RUN_TEST(test_ack_clears_pending);
+  RUN_TEST(test_selective_ack_resends_only_the_loss);
+  return UNITY_END();
+}
@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+"""Turn the firmware's binary serial log (LOG_BINARY=1, see src/log.h) back
+into the readable lines a text build prints.
+
+    tools/logdecode.py [FILE]                   # a captured log, or stdin
+    tools/logdecode.py --port /dev/ttyACM0      # live; needs pyserial
+    tools/logdecode.py log.bin --capture game.bcap
+
+Message ids are positions in src/log_catalog.h, so decode with the catalog
+of the build that produced the log (--catalog to point elsewhere). Bytes
+outside a record are passed through as text.
+
+A CAPTURE=1 build also logs every datagram it sends or receives (see
+src/capture.h); they print as "CAP <hex>" lines, or with --capture go
+into FILE, ready for src/host/standin --replay. Text builds print the same
+lines, so --capture works on their logs too.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+LOG_SYNC = 0xF5
+CAPTURE_SYNC = 0xF6
+CAPTURE_MAGIC = b"BSCAP1\n\0"
+CAPTURE_LINE = re.compile(r"\bCAP ([0-9a-f]+)\s*$")
+RESULT_NAMES = ["MISS", "HIT", "SINK"]
+DEFAULT_CATALOG = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "log_catalog.h")
+
+C_STRING = r'"((?:[^"\\]|\\.)*)"'
+
+
+def unescape(s):
+    return bytes(s, "utf-8").decode("unicode_escape")
+
+
+def macro_body(source, name):
+    """Text of #define name(X) ..., with line continuations joined."""
+    m = re.search(r"#define\s+" + name + r"\(X\)((?:.*\\\n)*.*)", source)
+    if not m:
+        raise ValueError("no %s in catalog" % name)
+    return m.group(1).replace("\\\n", " ")
+
+
+def load_catalog(path):
+    with open(path) as f:
+        source = f.read()
+    tags = {}
+    for name, text in re.findall(r"X\(\s*(\w+)\s*,\s*" + C_STRING + r"\s*\)", macro_body(source, "LOG_TAGS")):
+        tags[name] = unescape(text)
+    messages = []
+    pattern = r"X\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*" + C_STRING + r"\s*\)"
+    for name, _level, tag, fmt in re.findall(pattern, macro_body(source, "LOG_CATALOG")):
+        messages.append((name, tags[tag], unescape(fmt)))
+    return messages
+
+
+class Decoder:
+    def __init__(self, messages):
+        self.messages = messages
+        self.pending = bytearray()
+        self.text = bytearray()
+
+    def feed(self, data):
+        """Yield every line completed by data."""
+        self.pending += data
+        buf, pos = self.pending, 0
+        while pos < len(buf):
+            if buf[pos] == CAPTURE_SYNC:
+                line, used = capture_record(buf, pos + 1)
+                if used == 0:
+                    break
+                if line is not None:
+                    pos += 1 + used
+                    yield line
+                    continue
+            if buf[pos] != LOG_SYNC:
+                byte = buf[pos]
+                pos += 1
+                if byte == ord("\n"):
+                    yield self.text.decode("utf-8", "replace").rstrip("\r")
+                    self.text.clear()
+                elif byte != ord("\r"):
+                    self.text.append(byte)
+                continue
+            line, used = self.record(buf, pos)
+            if used == 0:
+                break  # record not complete yet
+            if line is None:
+                self.text.append(buf[pos])  # not a record after all
+                pos += 1
+                continue
+            pos += used
+            yield line
+        del self.pending[:pos]
+
+    def flush(self):
+        if self.text:
+            yield self.text.decode("utf-8", "replace")
+            self.text.clear()
+
+    def record(self, buf, start):
+        """(line, bytes used) for the record at start; used 0 = incomplete,
+        line None = not a record."""
+        if len(buf) < start + 2:
+            return None, 0
+        if buf[start + 1] >= len(self.messages):
+            return None, 1
+        _name, tag, fmt = self.messages[buf[start + 1]]
+        pos = start + 2
+        out = []
+        i = 0
+        while i < len(fmt):
+            c = fmt[i]
+            i += 1
+            if c != "%" or i >= len(fmt):
+                out.append(c)
+                continue
+            spec = fmt[i]
+            i += 1
+            if spec == "%":
+                out.append("%")
+                continue
+            if spec == "s":
+                if pos >= len(buf):
+                    return None, 0
+                n = buf[pos]
+                if pos + 1 + n > len(buf):
+                    return None, 0
+                out.append(buf[pos + 1:pos + 1 + n].decode("utf-8", "replace"))
+                pos += 1 + n
+                continue
+            value, pos = read_varint(buf, pos)
+            if value is None:
+                return None, 0
+            if spec == "d" and value >= 1 << 31:
+                value -= 1 << 32
+            if spec == "r":
+                out.append(RESULT_NAMES[value] if value < len(RESULT_NAMES) else "MISS")
+            else:
+                out.append(str(value))
+        return tag + "".join(out), pos - start
+
+
+def capture_record(buf, start):
+    """("CAP <hex>", bytes used) for the capture record at start; used 0 =
+    incomplete, line None = not a record."""
+    if start >= len(buf):
+        return None, 0
+    length = (buf[start] & 0x1F) + 1
+    value, pos = read_varint(buf, start + 1)
+    if value is None:
+        return None, 0 if pos - start <= 5 else 1
+    if pos + length > len(buf):
+        return None, 0
+    return "CAP " + buf[start:pos + length].hex(), pos + length - start
+
+
+def read_varint(buf, pos):
+    value = shift = 0
+    while pos < len(buf):
+        byte = buf[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value & 0xFFFFFFFF, pos
+        shift += 7
+    return None, pos
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("file", nargs="?", help="captured log (default: stdin)")
+    ap.add_argument("--catalog", default=DEFAULT_CATALOG, help="log_catalog.h of the build")
+    ap.add_argument("--port", help="serial port to read live")
+    ap.add_argument("--baud", type=int, default=9600)
+    ap.add_argument("--capture", metavar="FILE", help="write captured datagrams to FILE instead of printing them")
+    args = ap.parse_args()
+
+    decoder = Decoder(load_catalog(args.catalog))
+    capture = None
+    if args.capture:
+        capture = open(args.capture, "wb")
+        capture.write(CAPTURE_MAGIC)
+
+    def emit(line, flush=False):
+        m = CAPTURE_LINE.search(line) if capture else None
+        if m:
+            capture.write(bytes.fromhex(m.group(1)))
+            if flush:
+                capture.flush()
+        else:
+            print(line, flush=flush)
+
+    if args.port:
+        import serial  # pyserial
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            while True:
+                for line in decoder.feed(port.read(256)):
+                    emit(line, flush=True)
+    stream = open(args.file, "rb") if args.file else sys.stdin.buffer
+    with stream:
+        while True:
+            chunk = stream.read(4096)
+            if not chunk:
+                break
+            for line in decoder.feed(chunk):
+                emit(line)
+    for line in decoder.flush():
+        emit(line)
+    if capture:
+        capture.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Per-symbol RAM and flash use of a firmware ELF.
+
+As a PlatformIO extra script (see platformio.ini) it runs after every link:
+it prints the totals against the board's capacity, the largest symbols and
+what changed since the previous build, and keeps the full list in
+memreport.txt next to firmware.elf. Standalone:
+
+    tools/memreport.py .pio/build/uno_wifi_rev2/firmware.elf
+    tools/memreport.py firmware.elf --baseline old-memreport.txt
+
+RAM is .data and .bss (the heap and stack come after them); .data also
+takes flash for its initial values. PROGMEM tables count as flash.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+RAM_TYPES = set("bBdDvV")
+FLASH_TYPES = set("tTrRwWdD")
+TOP = 15
+
+
+def read_symbols(elf, nm):
+    """{(region, name): bytes} from nm --print-size."""
+    out = subprocess.run([nm, "--print-size", "--size-sort", "--demangle", elf],
+                         check=True, capture_output=True, text=True).stdout
+    symbols = {}
+    for line in out.splitlines():
+        m = re.match(r"\s*([0-9a-fA-F]+)\s+([0-9a-fA-F]+)\s+(\w)\s+(.+)$", line)
+        if not m:
+            continue
+        size, kind, name = int(m.group(2), 16), m.group(3), m.group(4)
+        for region, types in (("ram", RAM_TYPES), ("flash", FLASH_TYPES)):
+            if kind in types:
+                symbols[(region, name)] = symbols.get((region, name), 0) + size
+    return symbols
+
+
+def write_report(symbols, path):
+    with open(path, "w") as f:
+        for (region, name), size in sorted(symbols.items(), key=lambda kv: (kv[0][0], -kv[1], kv[0][1])):
+            f.write("%s\t%d\t%s\n" % (region, size, name))
+
+
+def read_report(path):
+    symbols = {}
+    with open(path) as f:
+        for line in f:
+            region, size, name = line.rstrip("\n").split("\t", 2)
+            symbols[(region, name)] = int(size)
+    return symbols
+
+
+def total(symbols, region):
+    return sum(size for (r, _), size in symbols.items() if r == region)
+
+
+def print_report(symbols, capacity, baseline=None):
+    for region in ("ram", "flash"):
+        used, cap = total(symbols, region), capacity[region]
+        line = "%-5s %6d B" % (region.upper(), used)
+        if cap:
+            line += " of %d (%.1f%%)" % (cap, 100.0 * used / cap)
+        if baseline is not None:
+            line += "  %+d B" % (used - total(baseline, region))
+        print(line)
+        largest = sorted(((size, name) for (r, name), size in symbols.items() if r == region), reverse=True)
+        for size, name in largest[:TOP]:
+            print("  %6d  %s" % (size, name))
+    if baseline is None:
+        return
+    changed = []
+    for key in set(symbols) | set(baseline):
+        delta = symbols.get(key, 0) - baseline.get(key, 0)
+        if delta:
+            changed.append((-abs(delta), key, delta))
+    if not changed:
+        print("no symbol changed size")
+        return
+    print("changed:")
+    for _, (region, name), delta in sorted(changed)[:2 * TOP]:
+        print("  %-5s %+6d  %s" % (region, delta, name))
+
+
+def pio_post_link(env):
+    def report(target, source, env):
+        elf = target[0].get_abspath()
+        cc = os.path.basename(env.subst("$CC"))
+        nm = cc[:-3] + "nm" if cc.endswith("gcc") else "nm"
+        upload = env.BoardConfig().get("upload", {})
+        capacity = {"ram": int(upload.get("maximum_ram_size", 0)), "flash": int(upload.get("maximum_size", 0))}
+        path = os.path.join(os.path.dirname(elf), "memreport.txt")
+        baseline = read_report(path) if os.path.exists(path) else None
+        symbols = read_symbols(elf, nm)
+        print_report(symbols, capacity, baseline)
+        write_report(symbols, path)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("elf")
+    ap.add_argument("--nm", default="avr-nm")
+    ap.add_argument("--ram", type=int, default=6144, help="RAM capacity in bytes (ATmega4809)")
+    ap.add_argument("--flash", type=int, default=49152, help="flash capacity in bytes (ATmega4809)")
+    ap.add_argument("--baseline", help="earlier memreport.txt to compare against")
+    ap.add_argument("--write", help="save the symbol list here")
+    args = ap.parse_args()
+
+    symbols = read_symbols(args.elf, args.nm)
+    baseline = read_report(args.baseline) if args.baseline else None
+    print_report(symbols, {"ram": args.ram, "flash": args.flash}, baseline)
+    if args.write:
+        write_report(symbols, args.write)
+
+
+if __name__ == "__main__":
+    main()
+elif "Import" in globals():
+    Import("env")  # noqa: F821 - provided by PlatformIO's SCons
+    pio_post_link(env)  # noqa: F821
@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""Render the loop profiler's latency histograms (PROFILE=1, see
+src/profile.h).
+
+    tools/profview.py --udp 172.20.10.4          # STATS query to the board
+    tools/profview.py --port /dev/ttyACM0        # sends 'p', reads the dump
+    tools/profview.py [FILE]                     # a captured serial log
+
+Serial logs may be binary (decoded with tools/logdecode.py) or text; the
+last complete dump in the input is shown. Send 'r' on the serial port to
+reset the board's histograms.
+"""
+
+import argparse
+import os
+import re
+import socket
+import struct
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import logdecode  # noqa: E402
+
+DEFAULT_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "profile.h")
+DEFAULT_PORT = 8888
+WIRE_MAGIC = 0xB5
+MSG_STATS = 6
+BAR = 40
+NOT_LOOP_TIME = {"peer_rtt"}  # histograms of something other than loop time
+
+
+def load_labels(path):
+    with open(path) as f:
+        body = logdecode.macro_body(f.read(), "PROFILE_PROBES")
+    return [label for _name, label in re.findall(r"X\(\s*(\w+)\s*,\s*" + logdecode.C_STRING + r"\s*\)", body)]
+
+
+def bucket_range(b, buckets):
+    """[lo, hi) in us of bucket b; hi is None for the open last bucket."""
+    lo = 0 if b == 0 else 1 << (b + 1)
+    return lo, None if b == buckets - 1 else 1 << (b + 2)
+
+
+def fmt_us(us):
+    if us >= 1000000:
+        return "%.3gs" % (us / 1e6)
+    if us >= 1000:
+        return "%.3gms" % (us / 1e3)
+    return "%dus" % us
+
+
+class Dump:
+    def __init__(self, elapsed_ms, buckets=16):
+        self.elapsed_ms = elapsed_ms
+        self.buckets = buckets
+        self.probes = {}  # label -> [runs, max_us, counts]
+
+    def probe(self, label):
+        return self.probes.setdefault(label, [0, 0, [0] * self.buckets])
+
+
+def parse_stats(data, labels):
+    if len(data) < 9 or data[0] != WIRE_MAGIC or data[1] != MSG_STATS:
+        raise ValueError("not a STATS reply")
+    count, buckets, elapsed = data[3], data[4], struct.unpack_from("<I", data, 5)[0]
+    dump, pos = Dump(elapsed, buckets), 9
+    for i in range(count):
+        runs, max_us = struct.unpack_from("<II", data, pos)
+        counts = list(struct.unpack_from("<%dH" % buckets, data, pos + 8))
+        pos += 8 + 2 * buckets
+        dump.probes[labels[i] if i < len(labels) else "probe%d" % i] = [runs, max_us, counts]
+    return dump
+
+
+DUMP_LINE = re.compile(r"\[PROF\] (\d+) probes over (\d+) ms")
+RUNS_LINE = re.compile(r"\[PROF\] (\S+) runs=(\d+) max=(\d+)$")
+HIST_LINE = re.compile(r"\[PROF\] (\S+) (\d+): ((?:\d+ ?)+)$")
+
+
+class LogParser:
+    """Collect dumps from log lines; complete holds the last finished one."""
+
+    def __init__(self):
+        self.current = None
+        self.expected = 0
+        self.complete = None
+
+    def line(self, line):
+        m = DUMP_LINE.search(line)
+        if m:
+            self.current, self.expected = Dump(int(m.group(2))), int(m.group(1))
+            return
+        if self.current is None:
+            return
+        m = RUNS_LINE.search(line)
+        if m:
+            self.current.probe(m.group(1))[:2] = [int(m.group(2)), int(m.group(3))]
+            return
+        m = HIST_LINE.search(line)
+        if m:
+            first, counts = int(m.group(2)), [int(c) for c in m.group(3).split()]
+            self.current.probe(m.group(1))[2][first:first + len(counts)] = counts
+            if first + len(counts) >= self.current.buckets and len(self.current.probes) == self.expected:
+                self.complete, self.current = self.current, None
+
+
+def render(dump):
+    print("%d probes over %s" % (len(dump.probes), fmt_us(dump.elapsed_ms * 1000)))
+    for label, (runs, max_us, counts) in dump.probes.items():
+        total = sum(counts)
+        if not total:
+            print("\n%-14s no samples" % label)
+            continue
+        # Busy probes have their buckets halved on the board; scale them to
+        # the run count. Time spent counts each run at its bucket's floor,
+        # so it is a lower bound.
+        scale = runs / total if runs > total else 1.0
+        spent = sum(n * bucket_range(b, dump.buckets)[0] for b, n in enumerate(counts))
+        share = 100.0 * scale * spent / (dump.elapsed_ms * 1000) if dump.elapsed_ms else 0
+        print("\n%-14s %d runs  p50 <%s  p99 <%s  max %s%s" % (
+            label, max(runs, total), fmt_us(percentile(counts, 0.5, dump.buckets)),
+            fmt_us(percentile(counts, 0.99, dump.buckets)), fmt_us(max_us),
+            "" if label in NOT_LOOP_TIME else "  >=%.1f%% of the time" % share))
+        peak = max(counts)
+        for b, n in enumerate(counts):
+            if not n:
+                continue
+            lo, hi = bucket_range(b, dump.buckets)
+            span = ">=%s" % fmt_us(lo) if hi is None else "%s-%s" % (fmt_us(lo), fmt_us(hi))
+            print("  %-14s %7d %6.2f%% %s" % (span, round(n * scale), 100.0 * n / total, "#" * max(1, BAR * n // peak)))
+
+
+def percentile(counts, p, buckets):
+    """Upper bound of the bucket holding the p-th sample."""
+    want, seen = p * sum(counts), 0
+    for b, n in enumerate(counts):
+        seen += n
+        if seen >= want:
+            lo, hi = bucket_range(b, buckets)
+            return hi if hi is not None else lo
+    return 0
+
+
+def from_udp(target, labels, timeout):
+    host, _, port = target.partition(":")
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(timeout)
+    sock.sendto(b"STATS", (host, int(port or DEFAULT_PORT)))
+    data, _ = sock.recvfrom(2048)
+    return parse_stats(data, labels)
+
+
+def from_stream(read, catalog, deadline=None):
+    decoder, parser = logdecode.Decoder(logdecode.load_catalog(catalog)), LogParser()
+    while deadline is None or time.time() < deadline:
+        chunk = read()
+        if not chunk:
+            if deadline is None:
+                break
+            continue
+        for line in decoder.feed(chunk):
+            parser.line(line)
+        if deadline is not None and parser.complete:
+            break
+    for line in decoder.flush():
+        parser.line(line)
+    return parser.complete
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("file", nargs="?", help="captured serial log (default: stdin)")
+    ap.add_argument("--udp", metavar="HOST[:PORT]", help="query a board over UDP")
+    ap.add_argument("--port", help="serial port to request a dump on; needs pyserial")
+    ap.add_argument("--baud", type=int, default=9600)
+    ap.add_argument("--timeout", type=float, default=10.0, help="seconds to wait for a reply")
+    ap.add_argument("--catalog", default=logdecode.DEFAULT_CATALOG, help="log_catalog.h of the build")
+    ap.add_argument("--header", default=DEFAULT_HEADER, help="profile.h of the build (probe names)")
+    args = ap.parse_args()
+
+    if args.udp:
+        dump = from_udp(args.udp, load_labels(args.header), args.timeout)
+    elif args.port:
+        import serial  # pyserial
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            port.write(b"p")
+            dump = from_stream(lambda: port.read(256), args.catalog, time.time() + args.timeout)
+    else:
+        stream = open(args.file, "rb") if args.file else sys.stdin.buffer
+        with stream:
+            dump = from_stream(lambda: stream.read(4096), args.catalog)
+    if not dump:
+        sys.exit("no complete profile dump found")
+    render(dump)
+
+
+if __name__ == "__main__":
+    main()